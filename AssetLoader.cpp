@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "AssetLoader.h"
+
+namespace dae
+{
+	AssetLoader::AssetLoader(TextureRegistry* pTextureRegistry) :
+		m_pTextureRegistry{ pTextureRegistry }
+	{
+	}
+
+	AssetLoader::~AssetLoader()
+	{
+		Flush();
+	}
+
+	concurrency::task<TextureHandle> AssetLoader::LoadTexture(const std::string& path, TexelFormat format, bool isSoftwareCopyKept, const std::function<void(TextureHandle)>& onReady)
+	{
+		//the registry hands back the load that's already running or done, only the first request decodes
+		return Track(m_pTextureRegistry->LoadAsync(path, format, isSoftwareCopyKept), onReady);
+	}
+
+	concurrency::task<MeshGeometry*> AssetLoader::LoadMesh(const std::string& path, bool isCacheMapped, const std::function<void(MeshGeometry*)>& onReady)
+	{
+		return Run<MeshGeometry*>(
+			[path, isCacheMapped] {
+				//maps the mesh cache when there is a valid one, parses the OBJ and writes the cache otherwise
+				MeshGeometry* pGeometry{ MeshGeometry::LoadFromFile(path, true, isCacheMapped) };
+				if (!pGeometry)
+					std::cout << "AssetLoader: could not load " << path << '\n';
+				return pGeometry;
+			},
+			onReady);
+	}
+
+	void AssetLoader::Update()
+	{
+		for (size_t i{}; i < m_PendingLoads.size();)
+		{
+			if (!m_PendingLoads[i].done.is_done())
+			{
+				++i;
+				continue;
+			}
+
+			//out of the list first, the callback may start new loads
+			const std::function<void()> deliver{ std::move(m_PendingLoads[i].deliver) };
+			m_PendingLoads.erase(m_PendingLoads.begin() + i);
+			deliver();
+		}
+	}
+
+	void AssetLoader::Flush()
+	{
+		while (!m_PendingLoads.empty())
+		{
+			m_PendingLoads.front().done.wait();
+			Update();
+		}
+	}
+}
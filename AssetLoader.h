@@ -0,0 +1,70 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <ppltasks.h>
+#include "Datatypes.h"
+#include "MeshGeometry.h"
+#include "TextureRegistry.h"
+
+namespace dae
+{
+	//Decodes meshes and textures on the concurrency runtime's thread pool, all of them at the same time.
+	//Every load hands back its task right away. Its callback runs on the thread calling Update once the asset is ready,
+	//so the renderer state that depends on it is only ever touched from there.
+	class AssetLoader final
+	{
+	public:
+		//textures are requested through the registry, so every path is only ever loaded once
+		explicit AssetLoader(TextureRegistry* pTextureRegistry);
+		//delivers whatever is still loading, so no decoded asset is lost
+		~AssetLoader();
+
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader(AssetLoader&&) noexcept = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+		AssetLoader& operator=(AssetLoader&&) noexcept = delete;
+
+		//The callback gets a handle shared with every other user of the texture, nullptr when the file couldn't be loaded.
+		//Without isSoftwareCopyKept the texture is only there for the hardware path, see Texture::LoadFromFile.
+		concurrency::task<TextureHandle> LoadTexture(const std::string& path, TexelFormat format, bool isSoftwareCopyKept, const std::function<void(TextureHandle)>& onReady);
+		//The callback takes ownership of the geometry, nullptr when the file couldn't be loaded.
+		//With isCacheMapped the geometry is always read from its mapped cache, see MeshGeometry::LoadFromFile.
+		concurrency::task<MeshGeometry*> LoadMesh(const std::string& path, bool isCacheMapped, const std::function<void(MeshGeometry*)>& onReady);
+		//Any other work that should run on the pool and hand its result back the same way
+		template<typename Result>
+		concurrency::task<Result> Run(const std::function<Result()>& work, const std::function<void(Result)>& onReady);
+		//Hands the result of a task that is already running back the same way
+		template<typename Result>
+		concurrency::task<Result> Track(const concurrency::task<Result>& load, const std::function<void(Result)>& onReady);
+
+		//Runs the callbacks of every load that finished, loads started from a callback are picked up in the same call
+		void Update();
+		//Blocks until everything, including loads started from callbacks, is delivered
+		void Flush();
+		bool IsLoading() const { return !m_PendingLoads.empty(); };
+
+	private:
+		struct PendingLoad
+		{
+			concurrency::task<void> done;
+			std::function<void()> deliver;
+		};
+
+		TextureRegistry* m_pTextureRegistry{ nullptr };
+		std::vector<PendingLoad> m_PendingLoads{};
+	};
+
+	template<typename Result>
+	concurrency::task<Result> AssetLoader::Run(const std::function<Result()>& work, const std::function<void(Result)>& onReady)
+	{
+		return Track(concurrency::create_task(work), onReady);
+	}
+
+	template<typename Result>
+	concurrency::task<Result> AssetLoader::Track(const concurrency::task<Result>& load, const std::function<void(Result)>& onReady)
+	{
+		m_PendingLoads.push_back({ load.then([](Result) {}), [load, onReady] { onReady(load.get()); } });
+		return load;
+	}
+}
@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "BandedImageWriter.h"
+
+namespace dae
+{
+	bool BandedImageWriter::Open(const std::string& path, int width, int height)
+	{
+		m_File.open(path, std::ios::binary);
+		if (!m_File)
+			return false;
+
+		m_Width = width;
+		m_Height = height;
+		m_RowsWritten = 0;
+
+		//rows are padded to 4 bytes
+		const uint64_t rowSize{ (static_cast<uint64_t>(width) * 3 + 3) & ~uint64_t{ 3 } };
+		m_Row.resize(static_cast<size_t>(rowSize));
+
+		//the size fields are 32 bit, readers accept 0 for uncompressed images that don't fit
+		const uint64_t imageSize{ rowSize * height };
+		const uint32_t storedImageSize{ imageSize + 54 > UINT32_MAX ? 0 : static_cast<uint32_t>(imageSize) };
+		const uint32_t storedFileSize{ imageSize + 54 > UINT32_MAX ? 0 : static_cast<uint32_t>(imageSize + 54) };
+		if (storedFileSize == 0)
+		{
+			std::cout << "BandedImageWriter: " << path << " is larger than 4GB, some viewers won't open it\n";
+		}
+
+		uint8_t header[54]{};
+		const auto write16 = [&header](int offset, uint16_t value) { memcpy(header + offset, &value, 2); };
+		const auto write32 = [&header](int offset, uint32_t value) { memcpy(header + offset, &value, 4); };
+
+		header[0] = 'B';
+		header[1] = 'M';
+		write32(2, storedFileSize);
+		write32(10, 54); //pixel data offset
+		write32(14, 40); //BITMAPINFOHEADER
+		write32(18, static_cast<uint32_t>(width));
+		write32(22, static_cast<uint32_t>(-height)); //negative height = top-down rows, matches the band order
+		write16(26, 1);
+		write16(28, 24);
+		write32(34, storedImageSize);
+		write32(38, 2835); //72 DPI
+		write32(42, 2835);
+
+		m_File.write(reinterpret_cast<const char*>(header), sizeof(header));
+		return m_File.good();
+	}
+
+	bool BandedImageWriter::WriteRows(const uint32_t* pPixels, int rowCount)
+	{
+		for (int y{}; y < rowCount && m_RowsWritten < m_Height; ++y, ++m_RowsWritten)
+		{
+			const uint32_t* pSource{ pPixels + static_cast<size_t>(y) * m_Width };
+			for (int x{}; x < m_Width; ++x)
+			{
+				m_Row[x * 3] = static_cast<uint8_t>(pSource[x]);
+				m_Row[x * 3 + 1] = static_cast<uint8_t>(pSource[x] >> 8);
+				m_Row[x * 3 + 2] = static_cast<uint8_t>(pSource[x] >> 16);
+			}
+			m_File.write(reinterpret_cast<const char*>(m_Row.data()), m_Row.size());
+		}
+		return m_File.good();
+	}
+
+	bool BandedImageWriter::Close()
+	{
+		const bool isComplete{ m_RowsWritten == m_Height && m_File.good() };
+		m_File.close();
+		return isComplete;
+	}
+}
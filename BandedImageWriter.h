@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//Writes a 24 bit top-down BMP a band of rows at a time, so the full image never has to exist in memory
+	class BandedImageWriter final
+	{
+	public:
+		BandedImageWriter() = default;
+		~BandedImageWriter() = default;
+
+		BandedImageWriter(const BandedImageWriter&) = delete;
+		BandedImageWriter(BandedImageWriter&&) noexcept = delete;
+		BandedImageWriter& operator=(const BandedImageWriter&) = delete;
+		BandedImageWriter& operator=(BandedImageWriter&&) noexcept = delete;
+
+		bool Open(const std::string& path, int width, int height);
+		//pPixels holds rowCount rows of width XRGB8888 pixels, rows arrive top to bottom
+		bool WriteRows(const uint32_t* pPixels, int rowCount);
+		bool Close();
+
+	private:
+		std::ofstream m_File{};
+		int m_Width{};
+		int m_Height{};
+		int m_RowsWritten{};
+		std::vector<uint8_t> m_Row{};
+	};
+}
@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include <emmintrin.h>
+#include <cfloat>
+#include <climits>
+
+namespace dae
+{
+	namespace
+	{
+		uint32_t GetChannel(uint32_t texel, int channel)
+		{
+			return (texel >> (channel * 8)) & 0xFF;
+		}
+
+		uint16_t ToRGB565(uint32_t texel)
+		{
+			const uint32_t red{ (GetChannel(texel, 0) * 31 + 127) / 255 };
+			const uint32_t green{ (GetChannel(texel, 1) * 63 + 127) / 255 };
+			const uint32_t blue{ (GetChannel(texel, 2) * 31 + 127) / 255 };
+			return static_cast<uint16_t>(red << 11 | green << 5 | blue);
+		}
+
+		uint16_t ReadUInt16(const uint8_t* pData)
+		{
+			return static_cast<uint16_t>(pData[0] | pData[1] << 8);
+		}
+
+		//the 48 bits of 3 bit indices of a BC4 block
+		uint64_t ReadIndices48(const uint8_t* pData)
+		{
+			uint64_t indices{};
+			for (int i{}; i < 6; ++i)
+				indices |= static_cast<uint64_t>(pData[i]) << (i * 8);
+			return indices;
+		}
+
+		/**
+		 * \brief The 4 colors a BC1 block picks from, interpolated for all channels at once in 16 bit lanes
+		 * \param isFourColor false is the 3 color + transparent black mode BC1 uses when color0 <= color1
+		 */
+		void GetColorPalette(uint16_t color0, uint16_t color1, bool isFourColor, uint32_t* pOutPalette)
+		{
+			//565 to 888 by replicating the top bits, shifted per lane
+			const __m128i colors{ _mm_setr_epi16(color0 >> 11, (color0 >> 5) & 0x3F, color0 & 0x1F, 0, color1 >> 11, (color1 >> 5) & 0x3F, color1 & 0x1F, 0) };
+			const __m128i high{ _mm_mullo_epi16(colors, _mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0)) };
+			const __m128i low{ _mm_mulhi_epu16(colors, _mm_setr_epi16(1 << 14, 1 << 12, 1 << 14, 0, 1 << 14, 1 << 12, 1 << 14, 0)) };
+			const __m128i endpoints{ _mm_or_si128(_mm_or_si128(high, low), _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255)) };
+			const __m128i first{ _mm_unpacklo_epi64(endpoints, endpoints) };
+			const __m128i second{ _mm_unpackhi_epi64(endpoints, endpoints) };
+
+			__m128i interpolated{};
+			if (isFourColor)
+			{
+				//(2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3, rounded, the divide is a multiply by 65536 / 3
+				const __m128i sum{ _mm_add_epi16(
+					_mm_mullo_epi16(first, _mm_setr_epi16(2, 2, 2, 2, 1, 1, 1, 1)),
+					_mm_mullo_epi16(second, _mm_setr_epi16(1, 1, 1, 1, 2, 2, 2, 2))) };
+				interpolated = _mm_mulhi_epu16(_mm_add_epi16(sum, _mm_set1_epi16(1)), _mm_set1_epi16(21846));
+			}
+			else
+			{
+				//(c0 + c1) / 2, then black with alpha 0
+				const __m128i half{ _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(first, second), _mm_set1_epi16(1)), 1) };
+				interpolated = _mm_and_si128(half, _mm_setr_epi16(-1, -1, -1, -1, 0, 0, 0, 0));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutPalette), _mm_packus_epi16(endpoints, interpolated));
+		}
+
+		//The 8 values a BC4 block picks from, all interpolated in one register
+		void GetChannelPalette(uint8_t value0, uint8_t value1, uint8_t* pOutPalette)
+		{
+			const __m128i first{ _mm_set1_epi16(value0) };
+			const __m128i second{ _mm_set1_epi16(value1) };
+
+			__m128i palette{};
+			if (value0 > value1)
+			{
+				//6 values in between, weights out of 7
+				const __m128i sum{ _mm_add_epi16(
+					_mm_mullo_epi16(first, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+					_mm_mullo_epi16(second, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6))) };
+				palette = _mm_mulhi_epu16(_mm_add_epi16(sum, _mm_set1_epi16(3)), _mm_set1_epi16(9363));
+			}
+			else
+			{
+				//4 values in between, weights out of 5, then 0 and 255
+				const __m128i sum{ _mm_add_epi16(
+					_mm_mullo_epi16(first, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+					_mm_mullo_epi16(second, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0))) };
+				palette = _mm_mulhi_epu16(_mm_add_epi16(sum, _mm_set1_epi16(2)), _mm_set1_epi16(13108));
+				palette = _mm_or_si128(palette, _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+			}
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(pOutPalette), _mm_packus_epi16(palette, palette));
+		}
+
+		//Endpoints are the two texels furthest apart along the colors' principal axis, indices pick the nearest palette color
+		void EncodeColor(const uint32_t* pTexels, uint8_t* pBlock)
+		{
+			float mean[3]{};
+			for (int i{}; i < BlockTexelCount; ++i)
+				for (int channel{}; channel < 3; ++channel)
+					mean[channel] += GetChannel(pTexels[i], channel) / static_cast<float>(BlockTexelCount);
+
+			//rr, rg, rb, gg, gb, bb
+			float covariance[6]{};
+			for (int i{}; i < BlockTexelCount; ++i)
+			{
+				const float r{ GetChannel(pTexels[i], 0) - mean[0] };
+				const float g{ GetChannel(pTexels[i], 1) - mean[1] };
+				const float b{ GetChannel(pTexels[i], 2) - mean[2] };
+				covariance[0] += r * r;
+				covariance[1] += r * g;
+				covariance[2] += r * b;
+				covariance[3] += g * g;
+				covariance[4] += g * b;
+				covariance[5] += b * b;
+			}
+
+			//a few power iterations are plenty for a 3x3 matrix
+			float axis[3]{ 1.f, 1.f, 1.f };
+			for (int iteration{}; iteration < 4; ++iteration)
+			{
+				const float x{ covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2] };
+				const float y{ covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2] };
+				const float z{ covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+				const float length{ std::max(std::max(std::abs(x), std::abs(y)), std::abs(z)) };
+				if (length <= 0.f)
+					break;
+				axis[0] = x / length;
+				axis[1] = y / length;
+				axis[2] = z / length;
+			}
+
+			int minIndex{}, maxIndex{};
+			float minProjection{ FLT_MAX }, maxProjection{ -FLT_MAX };
+			for (int i{}; i < BlockTexelCount; ++i)
+			{
+				const float projection{ GetChannel(pTexels[i], 0) * axis[0] + GetChannel(pTexels[i], 1) * axis[1] + GetChannel(pTexels[i], 2) * axis[2] };
+				if (projection < minProjection)
+				{
+					minProjection = projection;
+					minIndex = i;
+				}
+				if (projection > maxProjection)
+				{
+					maxProjection = projection;
+					maxIndex = i;
+				}
+			}
+
+			//color0 > color1 selects the 4 color mode
+			uint16_t color0{ ToRGB565(pTexels[maxIndex]) };
+			uint16_t color1{ ToRGB565(pTexels[minIndex]) };
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			uint32_t indices{};
+			if (color0 != color1)
+			{
+				uint32_t palette[4];
+				GetColorPalette(color0, color1, true, palette);
+				for (int i{}; i < BlockTexelCount; ++i)
+				{
+					int bestDistance{ INT_MAX };
+					uint32_t bestIndex{};
+					for (uint32_t index{}; index < 4; ++index)
+					{
+						int distance{};
+						for (int channel{}; channel < 3; ++channel)
+						{
+							const int difference{ static_cast<int>(GetChannel(pTexels[i], channel)) - static_cast<int>(GetChannel(palette[index], channel)) };
+							distance += difference * difference;
+						}
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex = index;
+						}
+					}
+					indices |= bestIndex << (i * 2);
+				}
+			}
+
+			pBlock[0] = static_cast<uint8_t>(color0);
+			pBlock[1] = static_cast<uint8_t>(color0 >> 8);
+			pBlock[2] = static_cast<uint8_t>(color1);
+			pBlock[3] = static_cast<uint8_t>(color1 >> 8);
+			for (int i{}; i < 4; ++i)
+				pBlock[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+
+		//BC4 of one channel, always in the 8 value mode unless the block is flat
+		void EncodeChannel(const uint32_t* pTexels, int channel, uint8_t* pBlock)
+		{
+			uint8_t minValue{ 255 }, maxValue{ 0 };
+			for (int i{}; i < BlockTexelCount; ++i)
+			{
+				const uint8_t value{ static_cast<uint8_t>(GetChannel(pTexels[i], channel)) };
+				minValue = std::min(minValue, value);
+				maxValue = std::max(maxValue, value);
+			}
+
+			uint64_t indices{};
+			if (maxValue != minValue)
+			{
+				uint8_t palette[8];
+				GetChannelPalette(maxValue, minValue, palette);
+				for (int i{}; i < BlockTexelCount; ++i)
+				{
+					const int value{ static_cast<int>(GetChannel(pTexels[i], channel)) };
+					int bestDistance{ INT_MAX };
+					uint64_t bestIndex{};
+					for (uint64_t index{}; index < 8; ++index)
+					{
+						const int distance{ std::abs(value - palette[index]) };
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex = index;
+						}
+					}
+					indices |= bestIndex << (i * 3);
+				}
+			}
+
+			pBlock[0] = maxValue;
+			pBlock[1] = minValue;
+			for (int i{}; i < 6; ++i)
+				pBlock[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+
+		void DecodeColor(const uint8_t* pBlock, bool isAlwaysFourColor, uint32_t* pOutTexels)
+		{
+			const uint16_t color0{ ReadUInt16(pBlock) };
+			const uint16_t color1{ ReadUInt16(pBlock + 2) };
+			const uint32_t indices{ static_cast<uint32_t>(pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16) | static_cast<uint32_t>(pBlock[7]) << 24 };
+
+			uint32_t palette[4];
+			GetColorPalette(color0, color1, isAlwaysFourColor || color0 > color1, palette);
+			for (int i{}; i < BlockTexelCount; ++i)
+				pOutTexels[i] = palette[(indices >> (i * 2)) & 0x3];
+		}
+
+		//overwrites one byte of every texel
+		void DecodeChannel(const uint8_t* pBlock, int channel, uint32_t* pTexels)
+		{
+			uint8_t palette[8];
+			GetChannelPalette(pBlock[0], pBlock[1], palette);
+
+			const uint64_t indices{ ReadIndices48(pBlock + 2) };
+			const uint32_t mask{ ~(0xFFu << (channel * 8)) };
+			for (int i{}; i < BlockTexelCount; ++i)
+				pTexels[i] = (pTexels[i] & mask) | static_cast<uint32_t>(palette[(indices >> (i * 3)) & 0x7]) << (channel * 8);
+		}
+	}
+
+	void BC1Block::Encode(const uint32_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeColor(pTexels, pBlock);
+	}
+
+	void BC1Block::Decode(const uint8_t* pBlock, BC1Block& outBlock)
+	{
+		DecodeColor(pBlock, false, outBlock.texels);
+	}
+
+	void BC3Block::Encode(const uint32_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeChannel(pTexels, 3, pBlock);
+		EncodeColor(pTexels, pBlock + 8);
+	}
+
+	void BC3Block::Decode(const uint8_t* pBlock, BC3Block& outBlock)
+	{
+		//the color half of BC3 has no 3 color mode
+		DecodeColor(pBlock + 8, true, outBlock.texels);
+		DecodeChannel(pBlock, 3, outBlock.texels);
+	}
+
+	void BC5Block::Encode(const uint32_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeChannel(pTexels, 0, pBlock);
+		EncodeChannel(pTexels, 1, pBlock + 8);
+	}
+
+	void BC5Block::Decode(const uint8_t* pBlock, BC5Block& outBlock)
+	{
+		std::fill(std::begin(outBlock.texels), std::end(outBlock.texels), 0xFF000000u);
+		DecodeChannel(pBlock, 0, outBlock.texels);
+		DecodeChannel(pBlock + 8, 1, outBlock.texels);
+	}
+}
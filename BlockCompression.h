@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "MipChain.h"
+
+namespace dae
+{
+	//BCn blocks cover 4x4 texels, the same blocks D3D samples from, so one copy of the data serves both renderers.
+	//Texels go in and come out as packed RGBA8 (r in the low byte), row by row inside the block.
+	constexpr int BlockTexelCount{ TexelBlockSize * TexelBlockSize };
+
+	//Color endpoints in 565 + 2 bit indices, 8 bytes. Always written in 4 color mode.
+	struct BC1Block
+	{
+		static constexpr size_t Size{ 8 };
+		uint32_t texels[BlockTexelCount];
+
+		static void Encode(const uint32_t* pTexels, uint8_t* pBlock);
+		static void Decode(const uint8_t* pBlock, BC1Block& outBlock);
+	};
+
+	//BC4 alpha block followed by a BC1 color block, 16 bytes
+	struct BC3Block
+	{
+		static constexpr size_t Size{ 16 };
+		uint32_t texels[BlockTexelCount];
+
+		static void Encode(const uint32_t* pTexels, uint8_t* pBlock);
+		static void Decode(const uint8_t* pBlock, BC3Block& outBlock);
+	};
+
+	//Two BC4 blocks for red and green, 16 bytes. Decodes to r, g, 0, 255 like D3D does.
+	struct BC5Block
+	{
+		static constexpr size_t Size{ 16 };
+		uint32_t texels[BlockTexelCount];
+
+		static void Encode(const uint32_t* pTexels, uint8_t* pBlock);
+		static void Decode(const uint8_t* pBlock, BC5Block& outBlock);
+	};
+
+	//Bumped whenever block data is freed, so a cached decode of a reused address is never returned
+	inline std::atomic<uint32_t> g_DecodedBlockGeneration{ 1 };
+
+	inline void InvalidateDecodedBlocks()
+	{
+		g_DecodedBlockGeneration.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Small per thread cache of decoded blocks, keyed by the block's address.
+	//Neighbouring pixels and the 4 taps of a bilinear footprint mostly hit the same block, so it's decoded once for all of them.
+	template<typename Block>
+	const Block& GetDecodedBlock(const uint8_t* pBlock)
+	{
+		constexpr size_t entryCount{ 256 };
+		struct Entry
+		{
+			const uint8_t* pBlock{ nullptr };
+			uint32_t generation{};
+			Block block{};
+		};
+		thread_local Entry entries[entryCount]{};
+
+		//hash the address, blocks a row apart would otherwise share a slot on power of two widths
+		const uint64_t hash{ (reinterpret_cast<uintptr_t>(pBlock) >> 3) * 0x9E3779B97F4A7C15ull };
+		Entry& entry{ entries[hash >> 56] };
+
+		const uint32_t generation{ g_DecodedBlockGeneration.load(std::memory_order_relaxed) };
+		if (entry.pBlock != pBlock || entry.generation != generation)
+		{
+			Block::Decode(pBlock, entry.block);
+			entry.pBlock = pBlock;
+			entry.generation = generation;
+		}
+		return entry.block;
+	}
+
+	//Offset of the block holding texel x, y in a level of width texels, blocks are stored row by row
+	inline size_t GetBlockOffset(int x, int y, int width, size_t blockSize)
+	{
+		const size_t blocksPerRow{ static_cast<size_t>(width + TexelBlockSize - 1) / TexelBlockSize };
+		return ((y / TexelBlockSize) * blocksPerRow + x / TexelBlockSize) * blockSize;
+	}
+}
@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "ClusterCache.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <fstream>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		//spreads the low 10 bits of value over every third bit
+		uint32_t SpreadBits(uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		//the positions are already unorm against the mesh bounds, their top 10 bits are the grid cell
+		uint32_t CalculateMortonCode(const PackedVertex& v0, const PackedVertex& v1, const PackedVertex& v2)
+		{
+			uint32_t code{};
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const uint32_t centroid{ (uint32_t{ v0.position[axis] } + v1.position[axis] + v2.position[axis]) / 3 };
+				code |= SpreadBits(centroid >> 6) << axis;
+			}
+			return code;
+		}
+
+		//triangles sorted along the Morton curve at a time, the order and the cluster table are all that grow with the mesh
+		constexpr size_t ChunkTriangles{ 1 << 16 };
+
+		//vertex of the mesh -> vertex of the cluster being built. A cluster never has more than MaxClusterVertices,
+		//so a fixed open addressing table does instead of an array as large as the mesh.
+		class LocalVertexMap final
+		{
+		public:
+			static constexpr uint32_t NoVertex{ UINT32_MAX };
+
+			LocalVertexMap() { Clear(); };
+
+			uint32_t Find(uint32_t vertex) const
+			{
+				for (uint32_t i{ Hash(vertex) };; i = (i + 1) & (Capacity - 1))
+				{
+					if (m_Keys[i] == vertex || m_Keys[i] == NoVertex)
+						return m_Keys[i] == vertex ? m_Values[i] : NoVertex;
+				}
+			}
+
+			void Insert(uint32_t vertex, uint32_t local)
+			{
+				uint32_t i{ Hash(vertex) };
+				while (m_Keys[i] != NoVertex)
+					i = (i + 1) & (Capacity - 1);
+				m_Keys[i] = vertex;
+				m_Values[i] = local;
+			}
+
+			void Clear() { std::fill(std::begin(m_Keys), std::end(m_Keys), NoVertex); };
+
+		private:
+			//twice the vertices of a cluster, probes stay short
+			static constexpr uint32_t Capacity{ MaxClusterVertices * 2 };
+			static uint32_t Hash(uint32_t vertex) { return (vertex * 2654435761u) >> 23 & (Capacity - 1); };
+
+			uint32_t m_Keys[Capacity]{};
+			uint32_t m_Values[Capacity]{};
+		};
+	}
+
+	std::string GetClusterCachePath(const std::string& path)
+	{
+		return path + ".clusters";
+	}
+
+	bool IsValidClusterCache(const ClusterCacheHeader& header, std::span<const ClusterInfo> clusters, uint64_t fileSize, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		const uint32_t flags{ flipAxisAndWinding ? MeshCacheHeader::FlipAxisAndWinding : 0u };
+		if (header.magic != ClusterCacheHeader::Magic || header.version != ClusterCacheHeader::Version || header.vertexSize != sizeof(PackedVertex)
+			|| header.flags != flags || header.sourceSize != sourceSize || header.sourceWriteTime != sourceWriteTime)
+			return false;
+
+		if (header.clusterCount != clusters.size() || header.clusterOffset > fileSize || header.clusterCount > (fileSize - header.clusterOffset) / sizeof(ClusterInfo))
+			return false;
+
+		for (const ClusterInfo& cluster : clusters)
+		{
+			if (cluster.vertexCount > MaxClusterVertices || cluster.triangleCount > MaxClusterTriangles || cluster.dataOffset % ClusterCacheAlignment != 0)
+				return false;
+			const uint64_t size{ cluster.vertexCount * sizeof(PackedVertex) + cluster.triangleCount * 3 };
+			if (cluster.dataOffset > fileSize || size > fileSize - cluster.dataOffset)
+				return false;
+		}
+		return true;
+	}
+
+	bool WriteClusterCache(const std::string& cachePath, std::span<const PackedVertex> vertices, std::span<const uint32_t> indices,
+		const Vector3& boundsMin, const Vector3& boundsMax, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		const PositionQuantization quantization{ PositionQuantization::FromBounds(boundsMin, boundsMax) };
+
+		ClusterCacheHeader header{};
+		header.flags = flipAxisAndWinding ? MeshCacheHeader::FlipAxisAndWinding : 0u;
+		header.sourceSize = sourceSize;
+		header.sourceWriteTime = sourceWriteTime;
+		header.boundsMin = boundsMin;
+		header.boundsMax = boundsMax;
+
+		bool isWritten{};
+		{
+			std::ofstream file{ GetTemporaryCachePath(cachePath), std::ios::binary };
+			const char padding[ClusterCacheAlignment]{};
+			const auto padTo = [&file, &padding](uint64_t offset) {
+				file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+			};
+
+			//the header is written again at the end, the cluster count and the table's offset come last
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::vector<ClusterInfo> clusters{};
+			std::vector<PackedVertex> packedVertices{};
+			std::vector<uint8_t> localIndices{};
+			LocalVertexMap localVertices{};
+			const auto writeCluster = [&] {
+				if (localIndices.empty())
+					return;
+
+				ClusterInfo cluster{};
+				cluster.dataOffset = AlignUp(static_cast<uint64_t>(file.tellp()), ClusterCacheAlignment);
+				cluster.vertexCount = static_cast<uint32_t>(packedVertices.size());
+				cluster.triangleCount = static_cast<uint32_t>(localIndices.size() / 3);
+
+				//the bounds of the quantized positions, what the renderer actually draws
+				cluster.boundsMin = cluster.boundsMax = UnpackVertex(packedVertices.front(), quantization).position;
+				for (const PackedVertex& packed : packedVertices)
+				{
+					const Vector3 position{ UnpackVertex(packed, quantization).position };
+					cluster.boundsMin = { std::min(cluster.boundsMin.x, position.x), std::min(cluster.boundsMin.y, position.y), std::min(cluster.boundsMin.z, position.z) };
+					cluster.boundsMax = { std::max(cluster.boundsMax.x, position.x), std::max(cluster.boundsMax.y, position.y), std::max(cluster.boundsMax.z, position.z) };
+				}
+
+				padTo(cluster.dataOffset);
+				file.write(reinterpret_cast<const char*>(packedVertices.data()), static_cast<std::streamsize>(packedVertices.size() * sizeof(PackedVertex)));
+				file.write(reinterpret_cast<const char*>(localIndices.data()), static_cast<std::streamsize>(localIndices.size()));
+				clusters.push_back(cluster);
+
+				packedVertices.clear();
+				localIndices.clear();
+				localVertices.Clear();
+			};
+
+			std::vector<std::pair<uint32_t, uint32_t>> order{};
+			for (size_t chunkBegin{}; chunkBegin < triangleCount && file; chunkBegin += ChunkTriangles)
+			{
+				//1. the chunk's triangles along the Morton curve, neighbours on the curve are close in space
+				order.resize(std::min(ChunkTriangles, triangleCount - chunkBegin));
+				concurrency::parallel_for(size_t{}, order.size(), [&](size_t i) {
+					const size_t triangle{ chunkBegin + i };
+					order[i] = { CalculateMortonCode(vertices[indices[triangle * 3]], vertices[indices[triangle * 3 + 1]], vertices[indices[triangle * 3 + 2]]), static_cast<uint32_t>(triangle) };
+				});
+				std::sort(order.begin(), order.end());
+
+				//2. cut the curve whenever a cluster would run out of triangles or local vertices, a cluster never spans two chunks
+				for (const auto& [code, triangle] : order)
+				{
+					const uint32_t* pTriangle{ &indices[static_cast<size_t>(triangle) * 3] };
+					uint32_t newVertices{};
+					for (int corner{}; corner < 3; ++corner)
+						newVertices += localVertices.Find(pTriangle[corner]) == LocalVertexMap::NoVertex ? 1 : 0;
+
+					if (localIndices.size() == MaxClusterTriangles * 3 || packedVertices.size() + newVertices > MaxClusterVertices)
+						writeCluster();
+					for (int corner{}; corner < 3; ++corner)
+					{
+						uint32_t local{ localVertices.Find(pTriangle[corner]) };
+						if (local == LocalVertexMap::NoVertex)
+						{
+							local = static_cast<uint32_t>(packedVertices.size());
+							localVertices.Insert(pTriangle[corner], local);
+							packedVertices.push_back(vertices[pTriangle[corner]]);
+						}
+						localIndices.push_back(static_cast<uint8_t>(local));
+					}
+				}
+				writeCluster();
+			}
+
+			//3. the table after the clusters, then the header that points at it
+			header.clusterCount = clusters.size();
+			header.clusterOffset = AlignUp(static_cast<uint64_t>(file.tellp()), ClusterCacheAlignment);
+			padTo(header.clusterOffset);
+			file.write(reinterpret_cast<const char*>(clusters.data()), static_cast<std::streamsize>(clusters.size() * sizeof(ClusterInfo)));
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			isWritten = file.good();
+		}
+		return CommitCacheFile(cachePath, isWritten);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include "Datatypes.h"
+#include "PackedVertex.h"
+
+namespace dae
+{
+	//A cluster holds at most this many triangles, its indices are local to it and fit in a byte
+	constexpr uint32_t MaxClusterTriangles{ 128 };
+	constexpr uint32_t MaxClusterVertices{ 256 };
+
+	//One entry of the cluster table, everything needed to cull a cluster and read it
+	struct ClusterInfo
+	{
+		Vector3 boundsMin{};
+		Vector3 boundsMax{};
+		uint64_t dataOffset{}; //from the start of the file: vertexCount PackedVertex, then triangleCount * 3 uint8_t indices
+		uint32_t vertexCount{};
+		uint32_t triangleCount{};
+	};
+
+	//[ClusterCacheHeader][the clusters, each starting on a multiple of ClusterCacheAlignment][cluster table]
+	//Written by StreamedMesh::Create the first time, out of the full level of detail of the mesh cache.
+	//The table goes last, its size is only known once every cluster is written.
+	//StreamedMesh keeps the table in memory and reads the clusters it needs.
+	struct ClusterCacheHeader
+	{
+		static constexpr uint32_t Magic{ 0x43534C43 }; //"CLSC"
+		static constexpr uint32_t Version{ 2 }; //2: table after the clusters, clusters cut chunk by chunk
+
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		uint32_t vertexSize{ sizeof(PackedVertex) };
+		uint32_t flags{}; //MeshCacheHeader::FlipAxisAndWinding
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		uint64_t clusterCount{};
+		uint64_t clusterOffset{};
+		//the positions of every cluster are quantized against these, see PositionQuantization::FromBounds
+		Vector3 boundsMin{};
+		Vector3 boundsMax{};
+	};
+
+	constexpr uint64_t ClusterCacheAlignment{ 64 };
+
+	//bytes of the largest cluster, what a slot of StreamedMesh holds
+	constexpr size_t GetMaxClusterSize() { return MaxClusterVertices * sizeof(PackedVertex) + MaxClusterTriangles * 3; };
+
+	std::string GetClusterCachePath(const std::string& path);
+	//the header and the table must already have been read, fileSize is the size of the whole cache file
+	bool IsValidClusterCache(const ClusterCacheHeader& header, std::span<const ClusterInfo> clusters, uint64_t fileSize, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime);
+
+	/**
+	 * \brief Cuts the triangles into spatially coherent clusters and writes them out, one cluster at a time.
+	 * The triangles are taken in chunks of their given order, every chunk is sorted along a Morton curve through the
+	 * triangle centroids and runs of that order become the clusters. Only one chunk and the cluster table are held in
+	 * memory, so vertices and indices can be a mapped mesh cache larger than memory that is paged in as the chunks go.
+	 * \param vertices, indices one level of detail, the vertices are quantized against boundsMin and boundsMax
+	 */
+	bool WriteClusterCache(const std::string& cachePath, std::span<const PackedVertex> vertices, std::span<const uint32_t> indices,
+		const Vector3& boundsMin, const Vector3& boundsMax, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime);
+}
@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "CompressedDepthBuffer.h"
+
+namespace dae
+{
+	bool DepthPlane::FromTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2, float originY, DepthPlane& outPlane)
+	{
+		//solve 1/z = a * x + b * y + c through the three vertices, in double so the plane itself adds no error
+		const double x0{ v0.x }, y0{ v0.y - originY }, f0{ 1.0 / v0.z };
+		const double x1{ v1.x }, y1{ v1.y - originY }, f1{ 1.0 / v1.z };
+		const double x2{ v2.x }, y2{ v2.y - originY }, f2{ 1.0 / v2.z };
+
+		const double determinant{ (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0) };
+		if (determinant == 0.0)
+			return false;
+
+		const double a{ ((f1 - f0) * (y2 - y0) - (f2 - f0) * (y1 - y0)) / determinant };
+		const double b{ ((f2 - f0) * (x1 - x0) - (f1 - f0) * (x2 - x0)) / determinant };
+		outPlane = { static_cast<float>(a), static_cast<float>(b), static_cast<float>(f0 - a * x0 - b * y0) };
+		return true;
+	}
+
+	CompressedDepthBuffer::CompressedDepthBuffer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height },
+		m_TileCountX{ (width + TileSize - 1) / TileSize },
+		m_TileCountY{ (height + TileSize - 1) / TileSize }
+	{
+		const int tileCount{ m_TileCountX * m_TileCountY };
+		m_pTiles = new Tile[tileCount];
+		m_pRawDepth = new float[static_cast<size_t>(tileCount) * TileSize * TileSize];
+
+		for (int tileY{}; tileY < m_TileCountY; ++tileY)
+		{
+			for (int tileX{}; tileX < m_TileCountX; ++tileX)
+			{
+				uint64_t validMask{};
+				for (int bit{}; bit < TileSize * TileSize; ++bit)
+				{
+					if (tileX * TileSize + bit % TileSize < width && tileY * TileSize + bit / TileSize < height)
+						validMask |= uint64_t{ 1 } << bit;
+				}
+				m_pTiles[tileX + tileY * m_TileCountX].validMask = validMask;
+			}
+		}
+		Clear();
+	}
+
+	CompressedDepthBuffer::~CompressedDepthBuffer()
+	{
+		delete[] m_pTiles;
+		m_pTiles = nullptr;
+		delete[] m_pRawDepth;
+		m_pRawDepth = nullptr;
+	}
+
+	void CompressedDepthBuffer::Clear()
+	{
+		const int tileCount{ m_TileCountX * m_TileCountY };
+		for (int i{}; i < tileCount; ++i)
+		{
+			Tile& tile{ m_pTiles[i] };
+			tile.planeCount = 0;
+			tile.isRaw = false;
+			tile.isMaxDirty = false;
+			tile.maxDepth = FLT_MAX;
+			tile.coverage = 0;
+			tile.planeSelect = 0;
+		}
+	}
+
+	bool CompressedDepthBuffer::TestAndWrite(int x, int y, const DepthPlane& plane, float depth)
+	{
+		const int tileIndex{ x / TileSize + (y / TileSize) * m_TileCountX };
+		const int bit{ x % TileSize + (y % TileSize) * TileSize };
+		const uint64_t pixelMask{ uint64_t{ 1 } << bit };
+		Tile& tile{ m_pTiles[tileIndex] };
+
+		Lock(tile);
+		if (depth > DecodePixel(tile, tileIndex, bit))
+		{
+			Unlock(tile);
+			return false;
+		}
+
+		if (!tile.isRaw)
+		{
+			int slot{ -1 };
+			if (tile.planeCount > 0 && tile.planes[0] == plane)
+				slot = 0;
+			else if (tile.planeCount > 1 && tile.planes[1] == plane)
+				slot = 1;
+			else if (tile.planeCount < 2)
+				slot = tile.planeCount++;
+			else if (((tile.coverage & ~tile.planeSelect) & ~pixelMask) == 0)
+				slot = 0; //every pixel of plane 0 got overwritten, reuse it
+			else if ((tile.coverage & tile.planeSelect & ~pixelMask) == 0)
+				slot = 1;
+
+			if (slot >= 0)
+			{
+				tile.planes[slot] = plane;
+				tile.planeSelect = slot == 1 ? tile.planeSelect | pixelMask : tile.planeSelect & ~pixelMask;
+			}
+			else
+			{
+				//third triangle in the tile, store it per pixel from now on
+				Decompress(tile, tileIndex);
+			}
+		}
+
+		if (tile.isRaw)
+		{
+			m_pRawDepth[static_cast<size_t>(tileIndex) * TileSize * TileSize + bit] = depth;
+		}
+		tile.coverage |= pixelMask;
+		tile.isMaxDirty = true;
+		Unlock(tile);
+		return true;
+	}
+
+	float CompressedDepthBuffer::GetTileMaxDepth(int tileX, int tileY)
+	{
+		const int tileIndex{ tileX + tileY * m_TileCountX };
+		Tile& tile{ m_pTiles[tileIndex] };
+
+		Lock(tile);
+		if (tile.coverage != tile.validMask)
+		{
+			Unlock(tile);
+			return FLT_MAX;
+		}
+
+		if (tile.isMaxDirty)
+		{
+			float maxDepth{ 0.f };
+			for (int bit{}; bit < TileSize * TileSize; ++bit)
+			{
+				if (tile.validMask & (uint64_t{ 1 } << bit))
+					maxDepth = std::max(maxDepth, DecodePixel(tile, tileIndex, bit));
+			}
+			tile.maxDepth = maxDepth;
+			tile.isMaxDirty = false;
+		}
+		const float maxDepth{ tile.maxDepth };
+		Unlock(tile);
+		return maxDepth;
+	}
+
+	DepthBufferStats CompressedDepthBuffer::GetStats() const
+	{
+		DepthBufferStats stats{};
+		const int tileCount{ m_TileCountX * m_TileCountY };
+		for (int i{}; i < tileCount; ++i)
+		{
+			const Tile& tile{ m_pTiles[i] };
+			if (tile.isRaw)
+				++stats.rawTiles;
+			else if (tile.coverage == 0)
+				++stats.clearTiles;
+			else if (tile.planeCount == 1)
+				++stats.onePlaneTiles;
+			else
+				++stats.twoPlaneTiles;
+		}
+		return stats;
+	}
+
+	float CompressedDepthBuffer::DecodePixel(const Tile& tile, int tileIndex, int bit) const
+	{
+		if (!(tile.coverage & (uint64_t{ 1 } << bit)))
+			return FLT_MAX;
+
+		if (tile.isRaw)
+			return m_pRawDepth[static_cast<size_t>(tileIndex) * TileSize * TileSize + bit];
+
+		//same pixel center the rasterizer evaluated the plane at
+		const float x{ static_cast<float>((tileIndex % m_TileCountX) * TileSize + bit % TileSize) + 0.5f };
+		const float y{ static_cast<float>((tileIndex / m_TileCountX) * TileSize + bit / TileSize) + 0.5f };
+		return tile.planes[(tile.planeSelect >> bit) & 1].Evaluate(x, y);
+	}
+
+	void CompressedDepthBuffer::Decompress(Tile& tile, int tileIndex)
+	{
+		float* pRaw{ m_pRawDepth + static_cast<size_t>(tileIndex) * TileSize * TileSize };
+		for (int bit{}; bit < TileSize * TileSize; ++bit)
+		{
+			pRaw[bit] = DecodePixel(tile, tileIndex, bit);
+		}
+		tile.isRaw = true;
+	}
+
+	void CompressedDepthBuffer::Lock(Tile& tile) const
+	{
+		while (tile.lock.test_and_set(std::memory_order_acquire))
+		{
+		}
+	}
+
+	void CompressedDepthBuffer::Unlock(Tile& tile) const
+	{
+		tile.lock.clear(std::memory_order_release);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+
+namespace dae
+{
+	struct Vector4;
+
+	//1/depth is linear in screen space, so one triangle's depth over a tile is fully described by 3 floats.
+	//The rasterizer evaluates its depth through the same function, which keeps the encoding lossless.
+	struct DepthPlane
+	{
+		float a{};
+		float b{};
+		float c{};
+
+		//pixel centers in the buffer's own coordinates
+		float Evaluate(float x, float y) const { return 1.f / (a * x + b * y + c); };
+		bool operator==(const DepthPlane& other) const { return a == other.a && b == other.b && c == other.c; };
+
+		//positions are screen space xy + ndc z, originY shifts them into the buffer's coordinates
+		static bool FromTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2, float originY, DepthPlane& outPlane);
+	};
+
+	struct DepthBufferStats
+	{
+		uint32_t clearTiles{};
+		uint32_t onePlaneTiles{};
+		uint32_t twoPlaneTiles{};
+		uint32_t rawTiles{};
+
+		uint32_t GetCompressedTiles() const { return clearTiles + onePlaneTiles + twoPlaneTiles; };
+	};
+
+	//Depth buffer split in 8x8 tiles. A tile is clear, holds up to two planes with a per pixel selector,
+	//or falls back to 64 raw floats once a third triangle writes into it.
+	//Test-and-write is atomic per tile, so triangles rasterized in parallel no longer race on depth.
+	class CompressedDepthBuffer final
+	{
+	public:
+		static constexpr int TileSize{ 8 };
+
+		CompressedDepthBuffer(int width, int height);
+		~CompressedDepthBuffer();
+
+		CompressedDepthBuffer(const CompressedDepthBuffer&) = delete;
+		CompressedDepthBuffer(CompressedDepthBuffer&&) noexcept = delete;
+		CompressedDepthBuffer& operator=(const CompressedDepthBuffer&) = delete;
+		CompressedDepthBuffer& operator=(CompressedDepthBuffer&&) noexcept = delete;
+
+		//Only touches the tile headers, not a float per pixel
+		void Clear();
+
+		//Writes plane's depth at (x, y) if it is closer than what is stored, depth must be plane.Evaluate at the pixel center
+		bool TestAndWrite(int x, int y, const DepthPlane& plane, float depth);
+
+		//Farthest depth stored in the tile, FLT_MAX while any pixel is still clear. Used for coarse rejection.
+		float GetTileMaxDepth(int tileX, int tileY);
+
+		DepthBufferStats GetStats() const;
+
+		int GetTileCountX() const { return m_TileCountX; };
+		int GetTileCountY() const { return m_TileCountY; };
+
+	private:
+		struct Tile
+		{
+			std::atomic_flag lock{};
+			uint8_t planeCount{};
+			bool isRaw{ false };
+			bool isMaxDirty{ false };
+			float maxDepth{ FLT_MAX };
+			uint64_t validMask{}; //pixels that lie inside the buffer, edge tiles can be partial
+			uint64_t coverage{}; //bit set = pixel written
+			uint64_t planeSelect{}; //bit set = pixel uses planes[1]
+			DepthPlane planes[2]{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+		int m_TileCountX{};
+		int m_TileCountY{};
+		Tile* m_pTiles{ nullptr };
+		//64 floats per tile, tile after tile, only read or written for raw tiles
+		float* m_pRawDepth{ nullptr };
+
+		float DecodePixel(const Tile& tile, int tileIndex, int bit) const;
+		void Decompress(Tile& tile, int tileIndex);
+		void Lock(Tile& tile) const;
+		void Unlock(Tile& tile) const;
+	};
+}
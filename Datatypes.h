@@ -12,6 +12,7 @@ namespace dae
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		float handedness{ 1.f }; //bitangent = cross(normal, tangent) * handedness
 	};
 
 	struct Vertex_Out
@@ -22,6 +23,7 @@ namespace dae
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		float handedness{ 1.f };
 	};
 
 	enum class LightingMode {
@@ -37,9 +39,20 @@ namespace dae
 		Back
 	};
 
+	enum class PrimitiveTopology {
+		TriangleList,
+		TriangleStrip
+	};
+
 	enum class SampleMode {
 		Point,
 		Linear,
 		Anisotropic
 	};
+
+	enum class AddressMode {
+		Wrap,
+		Clamp,
+		Mirror
+	};
 }
\ No newline at end of file
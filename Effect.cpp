@@ -49,6 +49,16 @@ Effect::Effect(ID3D11Device* device, const std::wstring& assetFile)
     if (!m_pSamplerVariable->IsValid()) {
         std::wcout << L"m_pSamplerVariable is not valid! \n";
     }
+
+    //position dequantization
+    m_pPositionOffsetVariable = m_pEffect->GetVariableByName("gPositionOffset")->AsVector();
+    if (!m_pPositionOffsetVariable->IsValid()) {
+        std::wcout << L"m_pPositionOffsetVariable is not valid! \n";
+    }
+    m_pPositionScaleVariable = m_pEffect->GetVariableByName("gPositionScale")->AsVector();
+    if (!m_pPositionScaleVariable->IsValid()) {
+        std::wcout << L"m_pPositionScaleVariable is not valid! \n";
+    }
 }
 
 Effect::~Effect()
@@ -77,6 +87,12 @@ Effect::~Effect()
     
     m_pSamplerVariable->Release();
     m_pSamplerVariable = nullptr;
+
+    m_pPositionOffsetVariable->Release();
+    m_pPositionOffsetVariable = nullptr;
+
+    m_pPositionScaleVariable->Release();
+    m_pPositionScaleVariable = nullptr;
    
     m_pEffect->GetVariableByName("gWorldViewProj")->Release();
     m_pEffect->GetVariableByName("gDiffuseMap")->Release();
@@ -86,6 +102,8 @@ Effect::~Effect()
     m_pEffect->GetVariableByName("gWorldMatrix")->Release();
     m_pEffect->GetVariableByName("gOnb")->Release();
     m_pEffect->GetVariableByName("gSampler")->Release();
+    m_pEffect->GetVariableByName("gPositionOffset")->Release();
+    m_pEffect->GetVariableByName("gPositionScale")->Release();
 
     m_pEffect->GetTechniqueByName("DefaultTechnique")->Release();
     m_pEffect->GetTechniqueByName("LinearTechnique")->Release();
@@ -166,6 +184,12 @@ void Effect::SetMatrix(const Matrix& matrix, const Matrix& worldMatrix, const Ve
     m_pOnbMatrixVariable->SetFloatVector(reinterpret_cast<const float*>(&cameraPos));
 }
 
+void Effect::SetPositionQuantization(const Vector3& offset, const Vector3& scale)
+{
+    m_pPositionOffsetVariable->SetFloatVector(reinterpret_cast<const float*>(&offset));
+    m_pPositionScaleVariable->SetFloatVector(reinterpret_cast<const float*>(&scale));
+}
+
 void Effect::SetMaps(Texture* pDiffuseTexture, Texture* pSpecularMap, Texture* pNormalMap, Texture* pGlossMap)
 {
     if (m_pDiffuseMapVariable) {
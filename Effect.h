@@ -14,6 +14,8 @@ public:
 
     ID3DX11EffectTechnique* GetTechnique();
     void SetMatrix(const Matrix& matrix, const Matrix& worldMatrix, const Vector3& cameraPos);
+    //turns the unorm positions of a PackedVertex back into object space
+    void SetPositionQuantization(const Vector3& offset, const Vector3& scale);
     void SetMaps(Texture* pDiffuseTexture, Texture* pSpecularMap, Texture* pNormalMap, Texture* pGlossMap);
     void SetMaps(Texture* pDiffuseTexture);
     void ChangeEffect(LPCSTR name);
@@ -31,5 +33,7 @@ private:
     ID3DX11EffectMatrixVariable* m_pWorldMatrixVariable{ nullptr };
     ID3DX11EffectVectorVariable* m_pOnbMatrixVariable{ nullptr };
     ID3DX11EffectSamplerVariable* m_pSamplerVariable{ nullptr };
+    ID3DX11EffectVectorVariable* m_pPositionOffsetVariable{ nullptr };
+    ID3DX11EffectVectorVariable* m_pPositionScaleVariable{ nullptr };
 };
 
@@ -0,0 +1,271 @@
+#include "pch.h"
+#include "FrameCapture.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+
+namespace dae
+{
+	FrameCapture::FrameCapture(int width, int height, int poolSize, int workerCount) :
+		m_Width{ width },
+		m_Height{ height }
+	{
+		//Allocate every buffer up front, capturing never allocates on the render thread
+		m_Pool.resize(poolSize);
+		for (std::vector<uint32_t>& buffer : m_Pool)
+		{
+			buffer.resize(static_cast<size_t>(m_Width) * m_Height);
+			m_FreeBuffers.push_back(buffer.data());
+		}
+
+		for (int i{}; i < workerCount; ++i)
+		{
+			m_Workers.emplace_back(&FrameCapture::WorkerLoop, this);
+		}
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		//Finish writing everything that was already captured before shutting down
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_JobAvailable.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void FrameCapture::RequestScreenshot(CaptureFormat format)
+	{
+		m_HasScreenshotRequest = true;
+		m_ScreenshotFormat = format;
+	}
+
+	void FrameCapture::StartSequence(int frameCount, CaptureFormat format)
+	{
+		m_SequenceFramesLeft = frameCount;
+		m_SequenceFrame = 0;
+		m_SequenceFormat = format;
+		++m_SequenceCount;
+		std::cout << "-----Capturing " << frameCount << " frames-----\n";
+	}
+
+	void FrameCapture::StopSequence()
+	{
+		if (m_SequenceFramesLeft > 0)
+		{
+			std::cout << "-----Capture stopped after " << m_SequenceFrame << " frames-----\n";
+		}
+		m_SequenceFramesLeft = 0;
+	}
+
+	bool FrameCapture::IsSequenceRunning() const
+	{
+		return m_SequenceFramesLeft > 0;
+	}
+
+	bool FrameCapture::IsCapturePending() const
+	{
+		return m_HasScreenshotRequest || m_SequenceFramesLeft > 0;
+	}
+
+	uint32_t* FrameCapture::AcquireFrame()
+	{
+		if (!IsCapturePending())
+			return nullptr;
+
+		//Sequence frames take priority so a screenshot never leaves a gap in the sequence
+		if (m_SequenceFramesLeft > 0)
+		{
+			m_PendingJob.path = MakePath(true, m_SequenceFrame, m_SequenceFormat);
+			m_PendingJob.format = m_SequenceFormat;
+			++m_SequenceFrame;
+			if (--m_SequenceFramesLeft == 0)
+			{
+				std::cout << "-----Capture finished, " << m_SequenceFrame << " frames queued-----\n";
+			}
+		}
+		else
+		{
+			m_PendingJob.path = MakePath(false, m_ScreenshotCount++, m_ScreenshotFormat);
+			m_PendingJob.format = m_ScreenshotFormat;
+			m_HasScreenshotRequest = false;
+		}
+
+		std::unique_lock lock{ m_Mutex };
+		m_BufferAvailable.wait(lock, [this]() { return !m_FreeBuffers.empty(); });
+		m_PendingJob.pPixels = m_FreeBuffers.back();
+		m_FreeBuffers.pop_back();
+		return m_PendingJob.pPixels;
+	}
+
+	void FrameCapture::SubmitFrame(uint32_t* pPixels)
+	{
+		assert(pPixels == m_PendingJob.pPixels && "SubmitFrame expects the buffer returned by AcquireFrame");
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Jobs.push_back(m_PendingJob);
+		}
+		m_PendingJob = {};
+		m_JobAvailable.notify_one();
+	}
+
+	void FrameCapture::WorkerLoop()
+	{
+		while (true)
+		{
+			CaptureJob job{};
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_JobAvailable.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+
+				job = m_Jobs.front();
+				m_Jobs.pop_front();
+			}
+
+			const bool succeeded{ job.format == CaptureFormat::PNG ? EncodePNG(job) : EncodeQOI(job) };
+			if (!succeeded)
+			{
+				std::cout << "FrameCapture: failed to write " << job.path << '\n';
+			}
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_FreeBuffers.push_back(job.pPixels);
+			}
+			m_BufferAvailable.notify_one();
+		}
+	}
+
+	std::string FrameCapture::MakePath(bool isSequence, int index, CaptureFormat format) const
+	{
+		const char* extension{ format == CaptureFormat::PNG ? "png" : "qoi" };
+
+		char path[128]{};
+		if (isSequence)
+		{
+			snprintf(path, sizeof(path), "Rasterizer_Sequence%02d_%05d.%s", m_SequenceCount, index, extension);
+		}
+		else
+		{
+			snprintf(path, sizeof(path), "Rasterizer_ColorBuffer_%03d.%s", index, extension);
+		}
+		return path;
+	}
+
+	bool FrameCapture::EncodePNG(const CaptureJob& job) const
+	{
+		//Wrap the pooled buffer without copying, SDL_image does the deflate work on this thread
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormatFrom(job.pPixels, m_Width, m_Height, 32, m_Width * 4, SDL_PIXELFORMAT_RGB888) };
+		if (!pSurface)
+			return false;
+
+		const bool succeeded{ IMG_SavePNG(pSurface, job.path.c_str()) == 0 };
+		SDL_FreeSurface(pSurface);
+		return succeeded;
+	}
+
+	bool FrameCapture::EncodeQOI(const CaptureJob& job) const
+	{
+		//"Quite OK Image" format, see https://qoiformat.org/qoi-specification.pdf
+		//Lossless like PNG but an order of magnitude faster to encode, which keeps up with long sequences.
+		constexpr uint8_t opIndex{ 0x00 };
+		constexpr uint8_t opDiff{ 0x40 };
+		constexpr uint8_t opLuma{ 0x80 };
+		constexpr uint8_t opRun{ 0xc0 };
+		constexpr uint8_t opRGB{ 0xfe };
+
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		std::vector<uint8_t> bytes{};
+		bytes.reserve(14 + pixelCount * 4 + 8);
+
+		const auto writeBigEndian = [&bytes](uint32_t value)
+		{
+			bytes.push_back(static_cast<uint8_t>(value >> 24));
+			bytes.push_back(static_cast<uint8_t>(value >> 16));
+			bytes.push_back(static_cast<uint8_t>(value >> 8));
+			bytes.push_back(static_cast<uint8_t>(value));
+		};
+
+		bytes.insert(bytes.end(), { 'q', 'o', 'i', 'f' });
+		writeBigEndian(static_cast<uint32_t>(m_Width));
+		writeBigEndian(static_cast<uint32_t>(m_Height));
+		bytes.push_back(3); //channels, the frame has no alpha
+		bytes.push_back(0); //sRGB
+
+		uint32_t seen[64]{};
+		uint32_t previous{ 0xff000000 }; //spec starts from opaque black, stored as ARGB
+		int run{ 0 };
+
+		for (size_t i{}; i < pixelCount; ++i)
+		{
+			const uint32_t pixel{ job.pPixels[i] | 0xff000000 };
+
+			if (pixel == previous)
+			{
+				++run;
+				if (run == 62 || i == pixelCount - 1)
+				{
+					bytes.push_back(opRun | static_cast<uint8_t>(run - 1));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				bytes.push_back(opRun | static_cast<uint8_t>(run - 1));
+				run = 0;
+			}
+
+			const uint8_t r{ static_cast<uint8_t>(pixel >> 16) };
+			const uint8_t g{ static_cast<uint8_t>(pixel >> 8) };
+			const uint8_t b{ static_cast<uint8_t>(pixel) };
+			const uint8_t hash{ static_cast<uint8_t>((r * 3 + g * 5 + b * 7 + 255 * 11) % 64) };
+
+			if (seen[hash] == pixel)
+			{
+				bytes.push_back(opIndex | hash);
+			}
+			else
+			{
+				seen[hash] = pixel;
+
+				const int8_t dr{ static_cast<int8_t>(r - static_cast<uint8_t>(previous >> 16)) };
+				const int8_t dg{ static_cast<int8_t>(g - static_cast<uint8_t>(previous >> 8)) };
+				const int8_t db{ static_cast<int8_t>(b - static_cast<uint8_t>(previous)) };
+				const int8_t drdg{ static_cast<int8_t>(dr - dg) };
+				const int8_t dbdg{ static_cast<int8_t>(db - dg) };
+
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+				{
+					bytes.push_back(opDiff | static_cast<uint8_t>((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+				}
+				else if (drdg > -9 && drdg < 8 && dg > -33 && dg < 32 && dbdg > -9 && dbdg < 8)
+				{
+					bytes.push_back(opLuma | static_cast<uint8_t>(dg + 32));
+					bytes.push_back(static_cast<uint8_t>((drdg + 8) << 4 | (dbdg + 8)));
+				}
+				else
+				{
+					bytes.insert(bytes.end(), { opRGB, r, g, b });
+				}
+			}
+			previous = pixel;
+		}
+
+		bytes.insert(bytes.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+
+		std::ofstream file{ job.path, std::ios::binary };
+		if (!file)
+			return false;
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return file.good();
+	}
+}
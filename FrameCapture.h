@@ -0,0 +1,90 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class CaptureFormat
+	{
+		PNG,
+		QOI
+	};
+
+	//Copies resolved frames (XRGB8888, same layout as the software back buffer) into pooled buffers
+	//and hands them to background encoder threads, so writing images never stalls the render thread.
+	class FrameCapture final
+	{
+	public:
+		FrameCapture(int width, int height, int poolSize = 4, int workerCount = 2);
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture(FrameCapture&&) noexcept = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+		FrameCapture& operator=(FrameCapture&&) noexcept = delete;
+
+		void RequestScreenshot(CaptureFormat format);
+		void StartSequence(int frameCount, CaptureFormat format);
+		void StopSequence();
+		bool IsSequenceRunning() const;
+
+		//True when the current frame should be handed to AcquireFrame/SubmitFrame
+		bool IsCapturePending() const;
+
+		/**
+		 * \brief Takes a free buffer from the pool for the pending capture.
+		 * Blocks while every buffer is still queued for encoding (backpressure), so a long sequence
+		 * never drops frames or grows memory beyond the pool.
+		 * \return buffer of width * height pixels to resolve the frame into, nullptr when nothing is pending
+		 */
+		uint32_t* AcquireFrame();
+		void SubmitFrame(uint32_t* pPixels);
+
+		int GetWidth() const { return m_Width; };
+		int GetHeight() const { return m_Height; };
+
+	private:
+		struct CaptureJob
+		{
+			uint32_t* pPixels{ nullptr };
+			std::string path{};
+			CaptureFormat format{ CaptureFormat::PNG };
+		};
+
+		void WorkerLoop();
+		std::string MakePath(bool isSequence, int index, CaptureFormat format) const;
+
+		bool EncodePNG(const CaptureJob& job) const;
+		bool EncodeQOI(const CaptureJob& job) const;
+
+		int m_Width{};
+		int m_Height{};
+
+		std::vector<std::vector<uint32_t>> m_Pool{};
+		std::vector<uint32_t*> m_FreeBuffers{};
+		std::deque<CaptureJob> m_Jobs{};
+		std::vector<std::thread> m_Workers{};
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_JobAvailable{};
+		std::condition_variable m_BufferAvailable{};
+		bool m_IsStopping{ false };
+
+		//Requests, only touched by the render thread
+		bool m_HasScreenshotRequest{ false };
+		CaptureFormat m_ScreenshotFormat{ CaptureFormat::PNG };
+		int m_ScreenshotCount{ 0 };
+
+		int m_SequenceFramesLeft{ 0 };
+		int m_SequenceFrame{ 0 };
+		int m_SequenceCount{ 0 };
+		CaptureFormat m_SequenceFormat{ CaptureFormat::QOI };
+
+		CaptureJob m_PendingJob{};
+	};
+}
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+namespace dae
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+		//the Win32 equivalent of open + mmap(PROT_READ)
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_Mapping)
+		{
+			Close();
+			return false;
+		}
+
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_pData)
+		{
+			Close();
+			return false;
+		}
+		m_Size = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_pData)
+		{
+			UnmapViewOfFile(m_pData);
+			m_pData = nullptr;
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+		if (m_File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_File);
+			m_File = INVALID_HANDLE_VALUE;
+		}
+		m_Size = 0;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Read only view of a whole file. The OS pages it in as it's touched, nothing is copied up front.
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//false when the file doesn't exist or is empty
+		bool Open(const std::string& path);
+		void Close();
+		bool IsOpen() const { return m_pData != nullptr; };
+
+		//page aligned
+		const uint8_t* GetData() const { return m_pData; };
+		size_t GetSize() const { return m_Size; };
+
+	private:
+		HANDLE m_File{ INVALID_HANDLE_VALUE };
+		HANDLE m_Mapping{ nullptr };
+		const uint8_t* m_pData{ nullptr };
+		size_t m_Size{};
+	};
+}
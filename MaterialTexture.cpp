@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "MaterialTexture.h"
+#include "Texture.h"
+#include "TextureCache.h"
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		uint32_t ToByte(float value)
+		{
+			return static_cast<uint32_t>(Clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+		}
+
+		//the map isn't unit length, only the direction matters to the shading
+		uint32_t PackNormal(uint32_t normalMap)
+		{
+			Vector3 normal{ (normalMap & 0xFF) / 255.f * 2.f - 1.f, ((normalMap >> 8) & 0xFF) / 255.f * 2.f - 1.f, ((normalMap >> 16) & 0xFF) / 255.f * 2.f - 1.f };
+			normal = normal.SqrMagnitude() > 0.f ? normal.Normalized() : Vector3{ 0.f, 0.f, 1.f };
+			return ToByte(normal.x * 0.5f + 0.5f) | ToByte(normal.y * 0.5f + 0.5f) << 8;
+		}
+
+		//the png's texels without the surface's row padding
+		bool LoadLevel(const std::string& path, std::vector<uint32_t>& outTexels, int& outWidth, int& outHeight)
+		{
+			SDL_Surface* pSurface{ LoadRGBASurface(path) };
+			if (!pSurface)
+				return false;
+
+			outWidth = pSurface->w;
+			outHeight = pSurface->h;
+			outTexels.resize(static_cast<size_t>(outWidth) * outHeight);
+			for (int y{}; y < outHeight; ++y)
+			{
+				memcpy(outTexels.data() + static_cast<size_t>(y) * outWidth, static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch, static_cast<size_t>(outWidth) * 4);
+			}
+			SDL_FreeSurface(pSurface);
+			return true;
+		}
+	}
+
+	MaterialTexture::MaterialTexture(MappedFile* pCacheFile) :
+		m_pCacheFile{ pCacheFile }
+	{
+		//the cache was validated before, its blocks are used in place
+		const MaterialCacheHeader& header{ *reinterpret_cast<const MaterialCacheHeader*>(m_pCacheFile->GetData()) };
+		m_MemorySize = LayoutMipChain(header.width, header.height, BlockSize, m_MipLevels);
+		m_pTexels = m_pCacheFile->GetData() + header.dataOffset;
+	}
+
+	MaterialTexture::~MaterialTexture()
+	{
+		InvalidateDecodedBlocks();
+		FreeTexels(m_pOwnedTexels);
+		m_pOwnedTexels = nullptr;
+		delete m_pCacheFile;
+		m_pCacheFile = nullptr;
+		m_pTexels = nullptr;
+	}
+
+	MaterialTexture* MaterialTexture::LoadFromFiles(const std::string& diffusePath, const std::string& glossPath, const std::string& normalPath, const std::string& specularPath)
+	{
+		const std::string* pPaths[]{ &diffusePath, &glossPath, &normalPath, &specularPath };
+		uint64_t sourceSizes[4]{};
+		int64_t sourceWriteTimes[4]{};
+		for (int i{}; i < 4; ++i)
+		{
+			if (!GetSourceStamp(*pPaths[i], sourceSizes[i], sourceWriteTimes[i]))
+			{
+				std::cout << "MaterialTexture: could not load " << *pPaths[i] << '\n';
+				return nullptr;
+			}
+		}
+
+		//a cache from an earlier run is mapped and sampled in place, nothing gets decoded
+		const std::string cachePath{ GetMaterialCachePath(diffusePath) };
+		MappedFile* pCacheFile{ new MappedFile{} };
+		if (pCacheFile->Open(cachePath) && pCacheFile->GetSize() >= sizeof(MaterialCacheHeader)
+			&& IsValidMaterialCache(*reinterpret_cast<const MaterialCacheHeader*>(pCacheFile->GetData()), pCacheFile->GetSize(), sourceSizes, sourceWriteTimes))
+			return new MaterialTexture{ pCacheFile };
+		delete pCacheFile;
+
+		//diffuse, gloss, normal, specular, only the level being packed and the next one are decoded at the same time
+		std::vector<uint32_t> levels[4]{};
+		int width{};
+		int height{};
+		for (int i{}; i < 4; ++i)
+		{
+			int mapWidth{}, mapHeight{};
+			if (!LoadLevel(*pPaths[i], levels[i], mapWidth, mapHeight))
+				return nullptr;
+			if (i > 0 && (mapWidth != width || mapHeight != height))
+			{
+				std::cout << "MaterialTexture: the maps differ in size, sampling them separately\n";
+				return nullptr;
+			}
+			width = mapWidth;
+			height = mapHeight;
+		}
+
+		MaterialTexture* pMaterial{ new MaterialTexture{} };
+		pMaterial->m_MemorySize = LayoutMipChain(width, height, BlockSize, pMaterial->m_MipLevels);
+		pMaterial->m_pOwnedTexels = AllocateTexels(pMaterial->m_MemorySize);
+		pMaterial->m_pTexels = pMaterial->m_pOwnedTexels;
+
+		std::vector<uint32_t> nextLevel{};
+		for (int level{}; level < pMaterial->GetMipCount(); ++level)
+		{
+			const int levelWidth{ pMaterial->GetWidth(level) };
+			const int levelHeight{ pMaterial->GetHeight(level) };
+			const int blocksPerRow{ (levelWidth + TexelBlockSize - 1) / TexelBlockSize };
+			uint8_t* pLevel{ pMaterial->m_pOwnedTexels + pMaterial->m_MipLevels[level].offset };
+
+			concurrency::parallel_for(0, (levelHeight + TexelBlockSize - 1) / TexelBlockSize, [&](int blockY) {
+				uint32_t diffuseGlossTexels[BlockTexelCount];
+				uint32_t normalTexels[BlockTexelCount];
+				uint32_t specularTexels[BlockTexelCount];
+				for (int blockX{}; blockX < blocksPerRow; ++blockX)
+				{
+					//levels smaller than a block repeat their edge texels
+					for (int i{}; i < BlockTexelCount; ++i)
+					{
+						const int x{ std::min(blockX * TexelBlockSize + i % TexelBlockSize, levelWidth - 1) };
+						const int y{ std::min(blockY * TexelBlockSize + i / TexelBlockSize, levelHeight - 1) };
+						const size_t texel{ x + static_cast<size_t>(y) * levelWidth };
+						diffuseGlossTexels[i] = (levels[0][texel] & 0x00FFFFFF) | (levels[1][texel] & 0xFF) << 24;
+						normalTexels[i] = PackNormal(levels[2][texel]);
+						specularTexels[i] = levels[3][texel] | 0xFF000000;
+					}
+
+					uint8_t* pBlock{ pLevel + (static_cast<size_t>(blockY) * blocksPerRow + blockX) * BlockSize };
+					BC3Block::Encode(diffuseGlossTexels, pBlock + DiffuseGlossOffset);
+					BC5Block::Encode(normalTexels, pBlock + NormalOffset);
+					BC1Block::Encode(specularTexels, pBlock + SpecularOffset);
+				}
+			});
+
+			//every map filters its next level from its own RGBA8 texels, like Texture does
+			if (level + 1 == pMaterial->GetMipCount())
+				break;
+			for (std::vector<uint32_t>& texels : levels)
+			{
+				nextLevel.resize(static_cast<size_t>(pMaterial->GetWidth(level + 1)) * pMaterial->GetHeight(level + 1));
+				CreateNextMipLevel(reinterpret_cast<const uint8_t*>(texels.data()), levelWidth, levelHeight,
+					reinterpret_cast<uint8_t*>(nextLevel.data()), pMaterial->GetWidth(level + 1), pMaterial->GetHeight(level + 1));
+				texels.swap(nextLevel);
+			}
+		}
+
+		pMaterial->WriteCache(cachePath, sourceSizes, sourceWriteTimes);
+		return pMaterial;
+	}
+
+	void MaterialTexture::WriteCache(const std::string& cachePath, const uint64_t (&sourceSizes)[4], const int64_t (&sourceWriteTimes)[4]) const
+	{
+		MaterialCacheHeader header{};
+		header.width = GetWidth(0);
+		header.height = GetHeight(0);
+		std::copy(std::begin(sourceSizes), std::end(sourceSizes), header.sourceSizes);
+		std::copy(std::begin(sourceWriteTimes), std::end(sourceWriteTimes), header.sourceWriteTimes);
+		header.dataOffset = AlignUp(sizeof(MaterialCacheHeader), CacheDataOffset);
+		header.dataSize = m_MemorySize;
+
+		bool isWritten{};
+		{
+			std::ofstream file{ GetTemporaryCachePath(cachePath), std::ios::binary };
+			const char padding[CacheDataOffset]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(padding, static_cast<std::streamsize>(header.dataOffset - sizeof(header)));
+			file.write(reinterpret_cast<const char*>(m_pTexels), static_cast<std::streamsize>(m_MemorySize));
+			isWritten = file.good();
+		}
+		CommitCacheFile(cachePath, isWritten);
+	}
+}
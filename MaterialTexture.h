@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ColorRGB.h"
+#include "MipChain.h"
+
+namespace dae
+{
+	class MappedFile;
+
+	//Everything the software shading reads from the four vehicle maps at one uv
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		float gloss{};
+		ColorRGB specular{};
+		Vector3 normal{}; //tangent space, unit length
+	};
+
+	//Software only copy of diffuse, gloss, normal and specular interleaved per 4x4 block,
+	//so shading a pixel touches one block stream instead of four images. The blocks are encoded from the decoded pngs,
+	//never from the block compressed maps, so every map goes through compression once. A 40 byte block holds:
+	//	BC3: diffuse rgb, gloss in alpha
+	//	BC5: normal x, y (z is rebuilt)
+	//	BC1: specular rgb
+	class MaterialTexture final
+	{
+	public:
+		static constexpr size_t DiffuseGlossOffset{ 0 };
+		static constexpr size_t NormalOffset{ 16 };
+		static constexpr size_t SpecularOffset{ 32 };
+		static constexpr size_t BlockSize{ 40 };
+
+		~MaterialTexture();
+
+		MaterialTexture(const MaterialTexture&) = delete;
+		MaterialTexture(MaterialTexture&&) noexcept = delete;
+		MaterialTexture& operator=(const MaterialTexture&) = delete;
+		MaterialTexture& operator=(MaterialTexture&&) noexcept = delete;
+
+		//Packs every mip level of the four pngs while they are decoded, the chain is filtered from the RGBA8 levels.
+		//Cached next to the diffuse map (diffusePath + ".material") and validated against all four pngs,
+		//later loads map that cache instead. nullptr when a png can't be loaded or their sizes differ.
+		static MaterialTexture* LoadFromFiles(const std::string& diffusePath, const std::string& glossPath, const std::string& normalPath, const std::string& specularPath);
+
+		int GetMipCount() const { return static_cast<int>(m_MipLevels.size()); };
+		int GetWidth(int level) const { return m_MipLevels[level].width; };
+		int GetHeight(int level) const { return m_MipLevels[level].height; };
+		//the level's blocks, row by row
+		const uint8_t* GetLevelData(int level) const { return m_pTexels + m_MipLevels[level].offset; };
+		size_t GetMemorySize() const { return m_MemorySize; };
+
+	private:
+		MaterialTexture() = default;
+		//takes ownership of an already validated cache file
+		explicit MaterialTexture(MappedFile* pCacheFile);
+
+		void WriteCache(const std::string& cachePath, const uint64_t (&sourceSizes)[4], const int64_t (&sourceWriteTimes)[4]) const;
+
+		std::vector<MipLevel> m_MipLevels{};
+		//points into either m_pOwnedTexels or the mapped cache file
+		const uint8_t* m_pTexels{ nullptr };
+		uint8_t* m_pOwnedTexels{ nullptr };
+		MappedFile* m_pCacheFile{ nullptr };
+		size_t m_MemorySize{};
+	};
+}
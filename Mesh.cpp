@@ -3,40 +3,35 @@
 #include <cassert>
 #include "Mesh.h"
 
-Mesh::Mesh(ID3D11Device* pDevice, std::vector<Vertex> verts, std::vector<uint32_t> ind)
+Mesh::Mesh(ID3D11Device* pDevice, MeshGeometry* pGeometry)
 {
     m_pEffect = new Effect(pDevice, L"./Resources/PosCol3D.fx");
     m_pTechnique = m_pEffect->GetTechnique();
 
-    //create Vertex Layout
-    static constexpr uint32_t numElements{ 5 };
+    //create Vertex Layout, see PackedVertex
+    static constexpr uint32_t numElements{ 4 };
     D3D11_INPUT_ELEMENT_DESC vertexDesc[numElements]{};
 
     vertexDesc[0].SemanticName = "POSITION";
-    vertexDesc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    vertexDesc[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
     vertexDesc[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
     vertexDesc[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-    vertexDesc[1].SemanticName = "COLOR";
-    vertexDesc[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    vertexDesc[1].SemanticName = "TEXCOORD";
+    vertexDesc[1].Format = DXGI_FORMAT_R16G16_FLOAT;
     vertexDesc[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
     vertexDesc[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-    vertexDesc[2].SemanticName = "TEXCOORD";
-    vertexDesc[2].Format = DXGI_FORMAT_R32G32_FLOAT;
+    vertexDesc[2].SemanticName = "NORMAL";
+    vertexDesc[2].Format = DXGI_FORMAT_R16G16_SNORM;
     vertexDesc[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
     vertexDesc[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-    vertexDesc[3].SemanticName = "NORMAL";
-    vertexDesc[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    vertexDesc[3].SemanticName = "TANGENT";
+    vertexDesc[3].Format = DXGI_FORMAT_R16G16_SNORM;
     vertexDesc[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
     vertexDesc[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-    vertexDesc[4].SemanticName = "TANGENT";
-    vertexDesc[4].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    vertexDesc[4].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-    vertexDesc[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
 
     //create input layout
     D3DX11_PASS_DESC passDesc{};
@@ -53,11 +48,20 @@ Mesh::Mesh(ID3D11Device* pDevice, std::vector<Vertex> verts, std::vector<uint32_
     if (FAILED(result))
         assert(false); // or return
 
+    SetGeometry(pDevice, pGeometry);
+}
+
+bool Mesh::SetGeometry(ID3D11Device* pDevice, MeshGeometry* pGeometry)
+{
+    //straight from the geometry's storage, a mapped cache is uploaded without a copy in between
+    const std::span<const PackedVertex> verts{ pGeometry->GetVertices() };
+    const std::span<const uint32_t> ind{ pGeometry->GetIndices() };
+    const std::span<const uint32_t> stripInd{ pGeometry->GetStripIndices() };
 
     //create vertex buffer
     D3D11_BUFFER_DESC bd = {};
     bd.Usage = D3D11_USAGE_IMMUTABLE;
-    bd.ByteWidth = sizeof(Vertex) * static_cast<uint32_t>(verts.size());
+    bd.ByteWidth = sizeof(PackedVertex) * static_cast<uint32_t>(verts.size());
     bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     bd.CPUAccessFlags = 0;
     bd.MiscFlags = 0;
@@ -65,42 +69,94 @@ Mesh::Mesh(ID3D11Device* pDevice, std::vector<Vertex> verts, std::vector<uint32_
     D3D11_SUBRESOURCE_DATA initData = {};
     initData.pSysMem = verts.data();
 
-    /*HRESULT result = pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);*/
-    result = pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
-    if (FAILED(result))
-        return;
+    ID3D11Buffer* pVertexBuffer{ nullptr };
+    HRESULT result = pDevice->CreateBuffer(&bd, &initData, &pVertexBuffer);
+    if (FAILED(result)) {
+        delete pGeometry;
+        return false;
+    }
 
     //create indexBuffer
-    m_NumIndices = static_cast<uint32_t>(ind.size());
     bd.Usage = D3D11_USAGE_IMMUTABLE;
-    bd.ByteWidth = sizeof(uint32_t) * m_NumIndices;
+    bd.ByteWidth = sizeof(uint32_t) * static_cast<uint32_t>(ind.size());
     bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     bd.CPUAccessFlags = 0;
     bd.MiscFlags = 0;
     initData.pSysMem = ind.data();
-    result = pDevice->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
-    if (FAILED(result))
-        return;
 
-    vertices = verts;
-    indices = ind;
+    ID3D11Buffer* pIndexBuffer{ nullptr };
+    result = pDevice->CreateBuffer(&bd, &initData, &pIndexBuffer);
+    if (FAILED(result)) {
+        pVertexBuffer->Release();
+        delete pGeometry;
+        return false;
+    }
+
+    //create stripIndexBuffer
+    bd.ByteWidth = sizeof(uint32_t) * static_cast<uint32_t>(stripInd.size());
+    initData.pSysMem = stripInd.data();
+
+    ID3D11Buffer* pStripIndexBuffer{ nullptr };
+    result = pDevice->CreateBuffer(&bd, &initData, &pStripIndexBuffer);
+    if (FAILED(result)) {
+        pIndexBuffer->Release();
+        pVertexBuffer->Release();
+        delete pGeometry;
+        return false;
+    }
+
+    //only replace the old geometry once the new one fully exists
+    if (m_pVertexBuffer)
+        m_pVertexBuffer->Release();
+    if (m_pIndexBuffer)
+        m_pIndexBuffer->Release();
+    if (m_pStripIndexBuffer)
+        m_pStripIndexBuffer->Release();
+    m_pVertexBuffer = pVertexBuffer;
+    m_pIndexBuffer = pIndexBuffer;
+    m_pStripIndexBuffer = pStripIndexBuffer;
+
+    delete m_pGeometry;
+    m_pGeometry = pGeometry;
+    m_Lod = 0;
+    m_VisibleMeshlets.clear();
+    m_MeshletDraws.clear();
+    vertices = pGeometry->GetLodVertices(m_Lod);
+    indices = pGeometry->GetLodIndices(m_Lod);
+    stripIndices = pGeometry->GetLodStripIndices(m_Lod);
+    quantization = pGeometry->GetQuantization();
+    m_pEffect->SetPositionQuantization(quantization.offset, quantization.scale);
+    return true;
 }
 
 Mesh::~Mesh()
 {
     //correct order, gives me no memory leaks according to VLD
     m_pTechnique = nullptr;
-    m_pVertexBuffer->Release();
+    //the buffers are missing when the first geometry couldn't be uploaded
+    if (m_pVertexBuffer)
+        m_pVertexBuffer->Release();
     m_pVertexBuffer = nullptr;
-    m_pIndexBuffer->Release();
+    if (m_pIndexBuffer)
+        m_pIndexBuffer->Release();
     m_pIndexBuffer = nullptr;
-    m_pInputLayout->Release();
+    if (m_pStripIndexBuffer)
+        m_pStripIndexBuffer->Release();
+    m_pStripIndexBuffer = nullptr;
+    if (m_pInputLayout)
+        m_pInputLayout->Release();
     m_pInputLayout = nullptr;
 
     if (m_pEffect) {
         delete m_pEffect;
         m_pEffect = nullptr;
     }
+
+    vertices = {};
+    indices = {};
+    stripIndices = {};
+    delete m_pGeometry;
+    m_pGeometry = nullptr;
 }
 
 void Mesh::SetMatrix(const Matrix& matrix, const Matrix& worldMatrix, const Vector3& cameraPos)
@@ -110,19 +166,20 @@ void Mesh::SetMatrix(const Matrix& matrix, const Matrix& worldMatrix, const Vect
 
 void Mesh::Render(ID3D11DeviceContext* pDeviceContext) const
 {
-    //1. set primitive topology
-    pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    //1. set primitive topology, the strips are cut by 0xFFFFFFFF indices (StripRestartIndex)
+    const bool isStrip{ m_Topology == PrimitiveTopology::TriangleStrip };
+    pDeviceContext->IASetPrimitiveTopology(isStrip ? D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     //2. set input layout
     pDeviceContext->IASetInputLayout(m_pInputLayout); //Different than slides
 
     //3. set vertex buffer
-    constexpr UINT stride = sizeof(Vertex);
+    constexpr UINT stride = sizeof(PackedVertex);
     constexpr UINT offset = 0;
     pDeviceContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &stride, &offset);
 
     //4. set indexBuffer
-    pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+    pDeviceContext->IASetIndexBuffer(isStrip ? m_pStripIndexBuffer : m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
     //5. Draw
     D3DX11_TECHNIQUE_DESC techDesc{};
@@ -132,10 +189,67 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext) const
         //m_pEffect->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
         ID3DX11EffectPass* pass{ m_pEffect->GetTechnique()->GetPassByIndex(p) };
         pass->Apply(0, pDeviceContext);
-        pDeviceContext->DrawIndexed(m_NumIndices, 0, 0);
+        if (IsDrawingMeshlets())
+        {
+            for (const auto& [indexOffset, indexCount] : m_MeshletDraws)
+                pDeviceContext->DrawIndexed(indexCount, indexOffset, 0);
+            continue;
+        }
+        const MeshLod& lod{ m_pGeometry->GetLods()[m_Lod] };
+        if (isStrip)
+            pDeviceContext->DrawIndexed(lod.stripCount, lod.stripOffset, 0);
+        else
+            pDeviceContext->DrawIndexed(lod.indexCount, lod.indexOffset, 0);
     }
 }
 
+void Mesh::CullMeshlets(const Matrix& viewProjectionMatrix, const Vector3& cameraOrigin, CullMode cullMode)
+{
+    m_VisibleMeshlets.clear();
+    m_MeshletDraws.clear();
+    if (!IsDrawingMeshlets())
+        return;
+
+    const MeshletCuller culler{ m_WorldMatrix, viewProjectionMatrix, cameraOrigin, cullMode };
+    const std::span<const Meshlet> meshlets{ m_pGeometry->GetMeshlets() };
+    const uint32_t firstIndex{ m_pGeometry->GetLods()[0].indexOffset };
+    for (uint32_t i{}; i < meshlets.size(); ++i)
+    {
+        if (!culler.IsVisible(meshlets[i]))
+            continue;
+
+        //the meshlets are consecutive runs of the index buffer, neighbours go in one draw
+        const uint32_t indexOffset{ firstIndex + meshlets[i].triangleOffset * 3 };
+        const uint32_t indexCount{ meshlets[i].triangleCount * 3 };
+        if (!m_MeshletDraws.empty() && m_MeshletDraws.back().first + m_MeshletDraws.back().second == indexOffset)
+            m_MeshletDraws.back().second += indexCount;
+        else
+            m_MeshletDraws.push_back({ indexOffset, indexCount });
+        m_VisibleMeshlets.push_back(i);
+    }
+}
+
+void Mesh::SelectLod(const Vector3& cameraOrigin, float pixelsPerUnit, float maxPixelError)
+{
+    //the bounding sphere in world space, a camera inside it gets the full mesh
+    const Vector3 boundsMin{ m_pGeometry->GetBoundsMin() };
+    const Vector3 boundsMax{ m_pGeometry->GetBoundsMax() };
+    const float scale{ std::max(m_WorldMatrix.GetAxisX().Magnitude(), std::max(m_WorldMatrix.GetAxisY().Magnitude(), m_WorldMatrix.GetAxisZ().Magnitude())) };
+    const Vector3 center{ m_WorldMatrix.TransformPoint((boundsMin + boundsMax) * 0.5f) };
+    const float radius{ (boundsMax - boundsMin).Magnitude() * 0.5f * scale };
+    const float distance{ (center - cameraOrigin).Magnitude() - radius };
+
+    //the errors are in object space, so is the distance they're compared at
+    const size_t lod{ dae::SelectLod(m_pGeometry->GetLods(), scale > 0.f ? distance / scale : 0.f, pixelsPerUnit, maxPixelError) };
+    if (lod == m_Lod)
+        return;
+
+    m_Lod = lod;
+    vertices = m_pGeometry->GetLodVertices(m_Lod);
+    indices = m_pGeometry->GetLodIndices(m_Lod);
+    stripIndices = m_pGeometry->GetLodStripIndices(m_Lod);
+}
+
 void Mesh::CycleTechnique()
 {
     m_Technique == Technique::Anisotropic ?
@@ -2,6 +2,9 @@
 #include "Vector3.h"
 #include "Matrix.h"
 #include "Datatypes.h"
+#include "MeshGeometry.h"
+#include <span>
+#include <vector>
 
 
 enum class Technique {
@@ -27,24 +30,51 @@ class Mesh
 {
 public:
 
-    Mesh(ID3D11Device* pDevice, std::vector<Vertex> vertices, std::vector<uint32_t> indices);
+    //takes ownership of the geometry
+    Mesh(ID3D11Device* pDevice, MeshGeometry* pGeometry);
     ~Mesh();
 
+    //Swaps in new vertex and index buffers, the effect and its state stay as they are. Takes ownership of the geometry,
+    //false when the buffers can't be created: the geometry is deleted then and the old one stays.
+    bool SetGeometry(ID3D11Device* pDevice, MeshGeometry* pGeometry);
     void SetMatrix(const Matrix& matrix, const Matrix& worldMatrix, const Vector3& cameraPos);
     void SetWorldMatrix(Matrix matrix) { m_WorldMatrix = matrix; };
     void Render(ID3D11DeviceContext* pDeviceContext) const;
     void CycleTechnique();
+    //Picks the coarsest level of detail that is off by at most maxPixelError pixels on screen, from the bounds as seen
+    //from cameraOrigin. pixelsPerUnit is how big one unit at distance 1 is on screen.
+    void SelectLod(const Vector3& cameraOrigin, float pixelsPerUnit, float maxPixelError = 1.f);
+    size_t GetLod() const { return m_Lod; };
+    //Culls the meshlets of level 0 against the camera (see MeshletCuller), Render and the software path only draw the ones left.
+    //Coarser levels are drawn whole.
+    void CullMeshlets(const Matrix& viewProjectionMatrix, const Vector3& cameraOrigin, CullMode cullMode);
+    //true when the current level is drawn meshlet by meshlet, strips are always drawn whole
+    bool IsDrawingMeshlets() const { return m_Topology == PrimitiveTopology::TriangleList && m_Lod == 0 && !m_pGeometry->GetMeshlets().empty(); };
+    //Draws the current level from its triangle list or from its strips, see MeshGeometry::GetStripIndices
+    void SetTopology(PrimitiveTopology topology) { m_Topology = topology; };
+    PrimitiveTopology GetTopology() const { return m_Topology; };
+    std::span<const uint32_t> GetVisibleMeshlets() const { return m_VisibleMeshlets; };
+    const MeshGeometry* GetGeometry() const { return m_pGeometry; };
 
     Effect* m_pEffect{ nullptr };
     Matrix m_WorldMatrix{};
-    std::vector<Vertex> vertices{};
-    std::vector<uint32_t> indices{};
+    //views of m_pGeometry's current level of detail, vectors or a mapped mesh cache
+    std::span<const PackedVertex> vertices{};
+    std::span<const uint32_t> indices{};
+    std::span<const uint32_t> stripIndices{};
+    PositionQuantization quantization{};
 
 private:
+    MeshGeometry* m_pGeometry{ nullptr };
     ID3DX11EffectTechnique* m_pTechnique{ nullptr };
     ID3D11InputLayout* m_pInputLayout{ nullptr };
     ID3D11Buffer* m_pVertexBuffer{ nullptr };
     ID3D11Buffer* m_pIndexBuffer{ nullptr };
-    int m_NumIndices{ 0 };
+    ID3D11Buffer* m_pStripIndexBuffer{ nullptr };
+    size_t m_Lod{ 0 };
+    std::vector<uint32_t> m_VisibleMeshlets{};
+    //index ranges of visible meshlets that follow each other, one draw call each
+    std::vector<std::pair<uint32_t, uint32_t>> m_MeshletDraws{};
     Technique m_Technique{ Technique::Point };
+    PrimitiveTopology m_Topology{ PrimitiveTopology::TriangleList };
 };
\ No newline at end of file
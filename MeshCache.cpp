@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include "MeshStripifier.h"
+#include <atomic>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint64_t IndexCheckChunkSize{ 64 * 1024 };
+
+		//every index below limit, StripRestartIndex allowed as well when the range is strips.
+		//Chunks take their maximum in parallel, a corrupt cache would otherwise read past the vertices when it's drawn.
+		bool AreIndicesBelow(const uint32_t* pIndices, uint64_t count, uint64_t limit, bool isStrip)
+		{
+			std::vector<uint32_t> chunkMaxima((count + IndexCheckChunkSize - 1) / IndexCheckChunkSize);
+			concurrency::parallel_for(size_t{}, chunkMaxima.size(), [&](size_t i) {
+				const uint64_t end{ std::min(count, (i + 1) * IndexCheckChunkSize) };
+				uint32_t maxIndex{};
+				for (uint64_t j{ i * IndexCheckChunkSize }; j < end; ++j)
+				{
+					const uint32_t index{ pIndices[j] };
+					maxIndex = std::max(maxIndex, isStrip && index == StripRestartIndex ? 0u : index);
+				}
+				chunkMaxima[i] = maxIndex;
+			});
+			return count == 0 || *std::max_element(chunkMaxima.begin(), chunkMaxima.end()) < limit;
+		}
+	}
+
+	std::string GetMeshCachePath(const std::string& path)
+	{
+		return path + ".meshcache";
+	}
+
+	bool IsValidMeshCache(const uint8_t* pData, uint64_t fileSize, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		if (fileSize < sizeof(MeshCacheHeader))
+			return false;
+
+		const MeshCacheHeader& header{ *reinterpret_cast<const MeshCacheHeader*>(pData) };
+		const uint32_t flags{ flipAxisAndWinding ? MeshCacheHeader::FlipAxisAndWinding : 0u };
+		if (header.magic != MeshCacheHeader::Magic || header.version != MeshCacheHeader::Version || header.vertexSize != sizeof(PackedVertex)
+			|| header.flags != flags || header.sourceSize != sourceSize || header.sourceWriteTime != sourceWriteTime)
+			return false;
+
+		if (header.vertexOffset % MeshCacheAlignment != 0 || header.indexOffset % MeshCacheAlignment != 0 || header.lodOffset % MeshCacheAlignment != 0
+			|| header.meshletOffset % MeshCacheAlignment != 0 || header.meshletVertexOffset % MeshCacheAlignment != 0 || header.stripIndexOffset % MeshCacheAlignment != 0)
+			return false;
+
+		//every stream inside the file, sizes checked before they're added up so nothing can wrap around
+		if (header.vertexOffset > fileSize || header.vertexCount > (fileSize - header.vertexOffset) / sizeof(PackedVertex))
+			return false;
+		if (header.indexOffset > fileSize || header.indexCount > (fileSize - header.indexOffset) / sizeof(uint32_t))
+			return false;
+		if (header.stripIndexOffset > fileSize || header.stripIndexCount > (fileSize - header.stripIndexOffset) / sizeof(uint32_t))
+			return false;
+		if (header.lodCount == 0 || header.lodCount > MaxLodCount || header.lodOffset > fileSize || header.lodCount > (fileSize - header.lodOffset) / sizeof(MeshLod))
+			return false;
+
+		//and every level inside those streams
+		const MeshLod* pLods{ reinterpret_cast<const MeshLod*>(pData + header.lodOffset) };
+		for (uint64_t i{}; i < header.lodCount; ++i)
+		{
+			const MeshLod& lod{ pLods[i] };
+			if (lod.indexCount % 3 != 0 || lod.indexOffset > header.indexCount || lod.indexCount > header.indexCount - lod.indexOffset
+				|| lod.vertexCount > header.vertexCount || lod.stripOffset > header.stripIndexCount || lod.stripCount > header.stripIndexCount - lod.stripOffset)
+				return false;
+		}
+
+		//a level only indexes its own vertices
+		const uint32_t* pIndices{ reinterpret_cast<const uint32_t*>(pData + header.indexOffset) };
+		const uint32_t* pStripIndices{ reinterpret_cast<const uint32_t*>(pData + header.stripIndexOffset) };
+		for (uint64_t i{}; i < header.lodCount; ++i)
+		{
+			const MeshLod& lod{ pLods[i] };
+			if (!AreIndicesBelow(pIndices + lod.indexOffset, lod.indexCount, lod.vertexCount, false)
+				|| !AreIndicesBelow(pStripIndices + lod.stripOffset, lod.stripCount, lod.vertexCount, true))
+				return false;
+		}
+
+		//the meshlets cover level 0, triangle for triangle
+		const uint64_t fullTriangleCount{ pLods[0].indexCount / 3 };
+		if (header.meshletOffset > fileSize || header.meshletCount > (fileSize - header.meshletOffset) / sizeof(Meshlet))
+			return false;
+		if (header.meshletVertexOffset > fileSize || header.meshletVertexCount > (fileSize - header.meshletVertexOffset) / sizeof(uint32_t))
+			return false;
+		if (header.meshletTriangleOffset > fileSize || fullTriangleCount > (fileSize - header.meshletTriangleOffset) / 3)
+			return false;
+
+		const Meshlet* pMeshlets{ reinterpret_cast<const Meshlet*>(pData + header.meshletOffset) };
+		uint64_t triangleCount{};
+		for (uint64_t i{}; i < header.meshletCount; ++i)
+		{
+			const Meshlet& meshlet{ pMeshlets[i] };
+			if (meshlet.vertexCount > MaxMeshletVertices || meshlet.triangleCount > MaxMeshletTriangles || meshlet.triangleOffset != triangleCount
+				|| meshlet.vertexOffset > header.meshletVertexCount || meshlet.vertexCount > header.meshletVertexCount - meshlet.vertexOffset)
+				return false;
+			triangleCount += meshlet.triangleCount;
+		}
+		if (triangleCount != fullTriangleCount)
+			return false;
+
+		//the meshlet vertices are level 0 vertices, the triangles index the meshlet's own vertices
+		if (!AreIndicesBelow(reinterpret_cast<const uint32_t*>(pData + header.meshletVertexOffset), header.meshletVertexCount, pLods[0].vertexCount, false))
+			return false;
+		const uint8_t* pMeshletTriangles{ pData + header.meshletTriangleOffset };
+		std::atomic<bool> hasBadTriangle{ false };
+		concurrency::parallel_for(size_t{}, static_cast<size_t>(header.meshletCount), [&](size_t i) {
+			const Meshlet& meshlet{ pMeshlets[i] };
+			const uint8_t* pTriangles{ pMeshletTriangles + static_cast<size_t>(meshlet.triangleOffset) * 3 };
+			for (uint32_t j{}; j < meshlet.triangleCount * 3; ++j)
+			{
+				if (pTriangles[j] >= meshlet.vertexCount)
+				{
+					hasBadTriangle = true;
+					return;
+				}
+			}
+		});
+		return !hasBadTriangle;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Datatypes.h"
+#include "PackedVertex.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+
+namespace dae
+{
+	//[MeshCacheHeader][vertices][indices][lods][meshlets][meshlet vertices][meshlet triangles][strip indices],
+	//every stream starts on a multiple of MeshCacheAlignment.
+	//The index stream holds every level of detail one after the other, the lods stream says where each one is.
+	//The meshlet triangles are three bytes per triangle of level 0.
+	//The strip indices are every level again as triangle strips, the lods say where each one is.
+	//Written by MeshGeometry::LoadFromFile next to the OBJ, later loads map it and use the streams in place.
+	//The streams are already optimized (see OptimizeMesh), so that only happens when the cache is built.
+	struct MeshCacheHeader
+	{
+		static constexpr uint32_t Magic{ 0x4348534D }; //"MSHC"
+		static constexpr uint32_t Version{ 7 }; //2: streams in MeshOptimizer order, 3: PackedVertex, 4: levels of detail, 5: handedness, 6: meshlets, 7: triangle strips
+		static constexpr uint32_t FlipAxisAndWinding{ 1 << 0 };
+
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		uint32_t vertexSize{ sizeof(PackedVertex) }; //the streams are the in memory structs, a changed PackedVertex invalidates the cache
+		uint32_t flags{};
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		uint64_t vertexCount{};
+		uint64_t vertexOffset{};
+		uint64_t indexCount{};
+		uint64_t indexOffset{};
+		uint64_t lodCount{};
+		uint64_t lodOffset{};
+		uint64_t meshletCount{};
+		uint64_t meshletOffset{};
+		uint64_t meshletVertexCount{};
+		uint64_t meshletVertexOffset{};
+		uint64_t meshletTriangleOffset{};
+		uint64_t stripIndexCount{};
+		uint64_t stripIndexOffset{};
+		//the positions are quantized against these, see PositionQuantization::FromBounds
+		Vector3 boundsMin{};
+		Vector3 boundsMax{};
+	};
+
+	//each stream starts on a cache line, a mapped view itself is page aligned
+	constexpr uint64_t MeshCacheAlignment{ 64 };
+
+	std::string GetMeshCachePath(const std::string& path);
+	//pData is the whole cache file, fileSize bytes
+	bool IsValidMeshCache(const uint8_t* pData, uint64_t fileSize, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime);
+}
@@ -0,0 +1,200 @@
+#include "pch.h"
+#include "MeshGeometry.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "MeshStripifier.h"
+#include "Utils.h"
+#include <fstream>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		void CalculateBounds(std::span<const Vertex> vertices, Vector3& outMin, Vector3& outMax)
+		{
+			if (vertices.empty())
+			{
+				outMin = {};
+				outMax = {};
+				return;
+			}
+
+			outMin = outMax = vertices[0].position;
+			for (const Vertex& vertex : vertices)
+			{
+				outMin = { std::min(outMin.x, vertex.position.x), std::min(outMin.y, vertex.position.y), std::min(outMin.z, vertex.position.z) };
+				outMax = { std::max(outMax.x, vertex.position.x), std::max(outMax.y, vertex.position.y), std::max(outMax.z, vertex.position.z) };
+			}
+		}
+	}
+
+	MeshGeometry::MeshGeometry(const std::vector<Vertex>& vertices, std::vector<uint32_t> indices, std::vector<MeshLod> lods) :
+		m_OwnedVertices(vertices.size()),
+		m_OwnedIndices{ std::move(indices) },
+		m_OwnedLods{ std::move(lods) }
+	{
+		if (m_OwnedLods.empty())
+			m_OwnedLods.push_back({ 0, static_cast<uint32_t>(m_OwnedIndices.size() / 3 * 3), static_cast<uint32_t>(vertices.size()), 0.f });
+
+		CalculateBounds(vertices, m_BoundsMin, m_BoundsMax);
+		m_Quantization = PositionQuantization::FromBounds(m_BoundsMin, m_BoundsMax);
+		concurrency::parallel_for(size_t{}, vertices.size(), [&](size_t i) {
+			m_OwnedVertices[i] = PackVertex(vertices[i], m_Quantization);
+		});
+
+		const MeshLod& fullLod{ m_OwnedLods.front() };
+		BuildMeshlets(vertices, std::span<const uint32_t>{ m_OwnedIndices }.subspan(fullLod.indexOffset, fullLod.indexCount),
+			m_OwnedMeshlets, m_OwnedMeshletVertices, m_OwnedMeshletTriangles);
+
+		//every level also as strips, one after the other like the indices
+		std::vector<std::vector<uint32_t>> lodStrips(m_OwnedLods.size());
+		concurrency::parallel_for(size_t{}, m_OwnedLods.size(), [&](size_t i) {
+			lodStrips[i] = StripifyMesh(std::span<const uint32_t>{ m_OwnedIndices }.subspan(m_OwnedLods[i].indexOffset, m_OwnedLods[i].indexCount), vertices.size());
+		});
+		for (size_t i{}; i < m_OwnedLods.size(); ++i)
+		{
+			m_OwnedLods[i].stripOffset = static_cast<uint32_t>(m_OwnedStripIndices.size());
+			m_OwnedLods[i].stripCount = static_cast<uint32_t>(lodStrips[i].size());
+			m_OwnedStripIndices.insert(m_OwnedStripIndices.end(), lodStrips[i].begin(), lodStrips[i].end());
+		}
+
+		m_Vertices = m_OwnedVertices;
+		m_Indices = m_OwnedIndices;
+		m_Lods = m_OwnedLods;
+		m_Meshlets = m_OwnedMeshlets;
+		m_MeshletVertices = m_OwnedMeshletVertices;
+		m_MeshletTriangles = m_OwnedMeshletTriangles;
+		m_StripIndices = m_OwnedStripIndices;
+	}
+
+	MeshGeometry::MeshGeometry(MappedFile* pCacheFile) :
+		m_pCacheFile{ pCacheFile }
+	{
+		//the cache was validated before, its streams are used in place
+		const MeshCacheHeader& header{ *reinterpret_cast<const MeshCacheHeader*>(m_pCacheFile->GetData()) };
+		m_Vertices = { reinterpret_cast<const PackedVertex*>(m_pCacheFile->GetData() + header.vertexOffset), static_cast<size_t>(header.vertexCount) };
+		m_Indices = { reinterpret_cast<const uint32_t*>(m_pCacheFile->GetData() + header.indexOffset), static_cast<size_t>(header.indexCount) };
+		m_Lods = { reinterpret_cast<const MeshLod*>(m_pCacheFile->GetData() + header.lodOffset), static_cast<size_t>(header.lodCount) };
+		m_Meshlets = { reinterpret_cast<const Meshlet*>(m_pCacheFile->GetData() + header.meshletOffset), static_cast<size_t>(header.meshletCount) };
+		m_MeshletVertices = { reinterpret_cast<const uint32_t*>(m_pCacheFile->GetData() + header.meshletVertexOffset), static_cast<size_t>(header.meshletVertexCount) };
+		m_MeshletTriangles = { m_pCacheFile->GetData() + header.meshletTriangleOffset, static_cast<size_t>(m_Lods.front().indexCount) };
+		m_StripIndices = { reinterpret_cast<const uint32_t*>(m_pCacheFile->GetData() + header.stripIndexOffset), static_cast<size_t>(header.stripIndexCount) };
+		m_BoundsMin = header.boundsMin;
+		m_BoundsMax = header.boundsMax;
+		m_Quantization = PositionQuantization::FromBounds(m_BoundsMin, m_BoundsMax);
+	}
+
+	MeshGeometry::~MeshGeometry()
+	{
+		m_Vertices = {};
+		m_Indices = {};
+		m_Lods = {};
+		m_Meshlets = {};
+		m_MeshletVertices = {};
+		m_MeshletTriangles = {};
+		m_StripIndices = {};
+		delete m_pCacheFile;
+		m_pCacheFile = nullptr;
+	}
+
+	MeshGeometry* MeshGeometry::LoadFromFile(const std::string& path, bool flipAxisAndWinding, bool isCacheMapped)
+	{
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		if (!GetSourceStamp(path, sourceSize, sourceWriteTime))
+			return nullptr;
+
+		const auto mapCache = [&]() -> MeshGeometry* {
+			MappedFile* pCacheFile{ new MappedFile{} };
+			if (pCacheFile->Open(GetMeshCachePath(path))
+				&& IsValidMeshCache(pCacheFile->GetData(), pCacheFile->GetSize(), flipAxisAndWinding, sourceSize, sourceWriteTime))
+				return new MeshGeometry{ pCacheFile };
+			delete pCacheFile;
+			return nullptr;
+		};
+
+		//a cache from an earlier run is mapped and used in place, nothing gets parsed or copied
+		if (MeshGeometry* pMapped{ mapCache() })
+			return pMapped;
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		if (!Utils::ParseOBJ(path, vertices, indices, flipAxisAndWinding))
+			return nullptr;
+
+		//only paid once, the cache keeps the optimized order and the levels of detail
+		OptimizeMesh(vertices, indices, path);
+		std::vector<MeshLod> lods{ BuildLodChain(vertices, indices) };
+		std::cout << "MeshGeometry: " << path << " " << lods.size() << " levels of detail, " << lods.front().indexCount / 3
+			<< " to " << lods.back().indexCount / 3 << " triangles\n";
+
+		MeshGeometry* pGeometry{ new MeshGeometry{ vertices, std::move(indices), std::move(lods) } };
+		const MeshLod& fullLod{ pGeometry->GetLods().front() };
+		std::cout << "MeshGeometry: " << path << " " << fullLod.stripCount << " strip indices instead of " << fullLod.indexCount << '\n';
+		pGeometry->WriteCache(GetMeshCachePath(path), flipAxisAndWinding, sourceSize, sourceWriteTime);
+		if (!isCacheMapped)
+			return pGeometry;
+
+		//the parsed mesh only had to live long enough to be written, the cache replaces it
+		//when it can't be written the owned geometry is all there is
+		if (MeshGeometry* pMapped{ mapCache() })
+		{
+			delete pGeometry;
+			return pMapped;
+		}
+		return pGeometry;
+	}
+
+	void MeshGeometry::WriteCache(const std::string& cachePath, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime) const
+	{
+		MeshCacheHeader header{};
+		header.flags = flipAxisAndWinding ? MeshCacheHeader::FlipAxisAndWinding : 0u;
+		header.sourceSize = sourceSize;
+		header.sourceWriteTime = sourceWriteTime;
+		header.vertexCount = m_Vertices.size();
+		header.vertexOffset = AlignUp(sizeof(MeshCacheHeader), MeshCacheAlignment);
+		header.indexCount = m_Indices.size();
+		header.indexOffset = AlignUp(header.vertexOffset + m_Vertices.size_bytes(), MeshCacheAlignment);
+		header.lodCount = m_Lods.size();
+		header.lodOffset = AlignUp(header.indexOffset + m_Indices.size_bytes(), MeshCacheAlignment);
+		header.meshletCount = m_Meshlets.size();
+		header.meshletOffset = AlignUp(header.lodOffset + m_Lods.size_bytes(), MeshCacheAlignment);
+		header.meshletVertexCount = m_MeshletVertices.size();
+		header.meshletVertexOffset = AlignUp(header.meshletOffset + m_Meshlets.size_bytes(), MeshCacheAlignment);
+		header.meshletTriangleOffset = AlignUp(header.meshletVertexOffset + m_MeshletVertices.size_bytes(), MeshCacheAlignment);
+		header.stripIndexCount = m_StripIndices.size();
+		header.stripIndexOffset = AlignUp(header.meshletTriangleOffset + m_MeshletTriangles.size_bytes(), MeshCacheAlignment);
+		header.boundsMin = m_BoundsMin;
+		header.boundsMax = m_BoundsMax;
+
+		bool isWritten{};
+		{
+			std::ofstream file{ GetTemporaryCachePath(cachePath), std::ios::binary };
+			const char padding[MeshCacheAlignment]{};
+			const auto padTo = [&file, &padding](uint64_t offset) {
+				file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+			};
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			padTo(header.vertexOffset);
+			file.write(reinterpret_cast<const char*>(m_Vertices.data()), static_cast<std::streamsize>(m_Vertices.size_bytes()));
+			padTo(header.indexOffset);
+			file.write(reinterpret_cast<const char*>(m_Indices.data()), static_cast<std::streamsize>(m_Indices.size_bytes()));
+			padTo(header.lodOffset);
+			file.write(reinterpret_cast<const char*>(m_Lods.data()), static_cast<std::streamsize>(m_Lods.size_bytes()));
+			padTo(header.meshletOffset);
+			file.write(reinterpret_cast<const char*>(m_Meshlets.data()), static_cast<std::streamsize>(m_Meshlets.size_bytes()));
+			padTo(header.meshletVertexOffset);
+			file.write(reinterpret_cast<const char*>(m_MeshletVertices.data()), static_cast<std::streamsize>(m_MeshletVertices.size_bytes()));
+			padTo(header.meshletTriangleOffset);
+			file.write(reinterpret_cast<const char*>(m_MeshletTriangles.data()), static_cast<std::streamsize>(m_MeshletTriangles.size_bytes()));
+			padTo(header.stripIndexOffset);
+			file.write(reinterpret_cast<const char*>(m_StripIndices.data()), static_cast<std::streamsize>(m_StripIndices.size_bytes()));
+			isWritten = file.good();
+		}
+		CommitCacheFile(cachePath, isWritten);
+	}
+}
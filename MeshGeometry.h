@@ -0,0 +1,82 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include "Datatypes.h"
+#include "PackedVertex.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+
+namespace dae
+{
+	class MappedFile;
+
+	//The vertex and index streams of a mesh plus its bounds. They live either in vectors or straight in a mapped mesh cache,
+	//users only ever see the spans. Vertices are packed against the bounds, GetQuantization turns them back into positions.
+	//Level 0 is also cut into meshlets (see BuildMeshlets), the renderers cull those before drawing the full mesh.
+	//Every level is kept a second time as triangle strips (see StripifyMesh) for drawing with the strip topology.
+	class MeshGeometry final
+	{
+	public:
+		//Packs the vertices, builds the meshlets of level 0 and the strips of every level. Without lods all indices are a single level.
+		MeshGeometry(const std::vector<Vertex>& vertices, std::vector<uint32_t> indices, std::vector<MeshLod> lods = {});
+		~MeshGeometry();
+
+		MeshGeometry(const MeshGeometry&) = delete;
+		MeshGeometry(MeshGeometry&&) noexcept = delete;
+		MeshGeometry& operator=(const MeshGeometry&) = delete;
+		MeshGeometry& operator=(MeshGeometry&&) noexcept = delete;
+
+		//The parsed OBJ is cached next to the file (path + ".meshcache") and validated against its size and write time.
+		//Later loads map that cache and use its streams in place instead of parsing again. nullptr when the OBJ can't be loaded.
+		//The levels of detail are built together with the cache.
+		//With isCacheMapped a freshly parsed mesh is dropped once its cache is written and the cache is mapped instead,
+		//so the full geometry is only paged in where it's read.
+		static MeshGeometry* LoadFromFile(const std::string& path, bool flipAxisAndWinding = true, bool isCacheMapped = false);
+
+		std::span<const PackedVertex> GetVertices() const { return m_Vertices; };
+		//every level of detail, one after the other
+		std::span<const uint32_t> GetIndices() const { return m_Indices; };
+		std::span<const MeshLod> GetLods() const { return m_Lods; };
+		std::span<const PackedVertex> GetLodVertices(size_t lod) const { return m_Vertices.first(m_Lods[lod].vertexCount); };
+		std::span<const uint32_t> GetLodIndices(size_t lod) const { return m_Indices.subspan(m_Lods[lod].indexOffset, m_Lods[lod].indexCount); };
+		//every level of detail as strips separated by StripRestartIndex, one after the other
+		std::span<const uint32_t> GetStripIndices() const { return m_StripIndices; };
+		std::span<const uint32_t> GetLodStripIndices(size_t lod) const { return m_StripIndices.subspan(m_Lods[lod].stripOffset, m_Lods[lod].stripCount); };
+		std::span<const Meshlet> GetMeshlets() const { return m_Meshlets; };
+		//per meshlet, indices into the vertices
+		std::span<const uint32_t> GetMeshletVertices() const { return m_MeshletVertices; };
+		//per triangle of level 0, indices into its meshlet's vertices
+		std::span<const uint8_t> GetMeshletTriangles() const { return m_MeshletTriangles; };
+		const Vector3& GetBoundsMin() const { return m_BoundsMin; };
+		const Vector3& GetBoundsMax() const { return m_BoundsMax; };
+		const PositionQuantization& GetQuantization() const { return m_Quantization; };
+		bool IsMapped() const { return m_pCacheFile != nullptr; };
+
+	private:
+		//takes ownership of an already validated cache file
+		explicit MeshGeometry(MappedFile* pCacheFile);
+
+		void WriteCache(const std::string& cachePath, bool flipAxisAndWinding, uint64_t sourceSize, int64_t sourceWriteTime) const;
+
+		//point into either the owned vectors or the mapped cache file
+		std::span<const PackedVertex> m_Vertices{};
+		std::span<const uint32_t> m_Indices{};
+		std::span<const MeshLod> m_Lods{};
+		std::span<const Meshlet> m_Meshlets{};
+		std::span<const uint32_t> m_MeshletVertices{};
+		std::span<const uint8_t> m_MeshletTriangles{};
+		std::span<const uint32_t> m_StripIndices{};
+		std::vector<PackedVertex> m_OwnedVertices{};
+		std::vector<uint32_t> m_OwnedIndices{};
+		std::vector<MeshLod> m_OwnedLods{};
+		std::vector<Meshlet> m_OwnedMeshlets{};
+		std::vector<uint32_t> m_OwnedMeshletVertices{};
+		std::vector<uint8_t> m_OwnedMeshletTriangles{};
+		std::vector<uint32_t> m_OwnedStripIndices{};
+		MappedFile* m_pCacheFile{ nullptr };
+		Vector3 m_BoundsMin{};
+		Vector3 m_BoundsMax{};
+		PositionQuantization m_Quantization{};
+	};
+}
@@ -0,0 +1,263 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		//FIFO post transform cache, a hit doesn't move a vertex to the front
+		class VertexCacheSimulation final
+		{
+		public:
+			VertexCacheSimulation(size_t vertexCount, int cacheSize) :
+				m_InsertTimes(vertexCount, 0),
+				m_Time{ static_cast<uint32_t>(cacheSize) + 1 },
+				m_CacheSize{ static_cast<uint32_t>(cacheSize) }
+			{
+			}
+
+			//true when the vertex had to be transformed
+			bool Access(uint32_t vertex)
+			{
+				if (m_Time - m_InsertTimes[vertex] <= m_CacheSize)
+					return false;
+
+				m_InsertTimes[vertex] = m_Time++;
+				return true;
+			}
+
+		private:
+			std::vector<uint32_t> m_InsertTimes;
+			uint32_t m_Time;
+			uint32_t m_CacheSize;
+		};
+
+		//how much worse than the cache order the overdraw order's ACMR may get
+		constexpr float MaxOverdrawAcmrGrowth{ 1.05f };
+	}
+
+	float CalculateACMR(std::span<const uint32_t> indices, size_t vertexCount, int cacheSize)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0)
+			return 0.f;
+
+		VertexCacheSimulation cache{ vertexCount, cacheSize };
+		size_t missCount{};
+		for (size_t i{}; i < triangleCount * 3; ++i)
+		{
+			if (cache.Access(indices[i]))
+				++missCount;
+		}
+		return static_cast<float>(missCount) / triangleCount;
+	}
+
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0 || vertexCount == 0)
+			return;
+
+		//1. the triangles around every vertex, and how many of them still have to be emitted
+		std::vector<uint32_t> liveCounts(vertexCount, 0);
+		for (size_t i{}; i < triangleCount * 3; ++i)
+			++liveCounts[indices[i]];
+
+		std::vector<uint32_t> firstTriangles(vertexCount + 1, 0);
+		for (size_t i{}; i < vertexCount; ++i)
+			firstTriangles[i + 1] = firstTriangles[i] + liveCounts[i];
+
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> fillCursors(firstTriangles.begin(), firstTriangles.end() - 1);
+		for (size_t i{}; i < triangleCount * 3; ++i)
+			adjacency[fillCursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		//2. fan around the current vertex, then pick the next one among the vertices just used
+		std::vector<uint32_t> cacheTimes(vertexCount, 0);
+		std::vector<bool> isEmitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds{};
+		std::vector<uint32_t> candidates{};
+		std::vector<uint32_t> result{};
+		result.reserve(triangleCount * 3);
+
+		const uint32_t size{ static_cast<uint32_t>(cacheSize) };
+		uint32_t time{ size + 1 };
+		size_t cursor{};
+		int64_t fan{ 0 };
+		while (fan >= 0)
+		{
+			candidates.clear();
+			for (uint32_t i{ firstTriangles[fan] }; i < firstTriangles[fan + 1]; ++i)
+			{
+				const uint32_t triangle{ adjacency[i] };
+				if (isEmitted[triangle])
+					continue;
+
+				for (size_t corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertex{ indices[triangle * 3 + corner] };
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					--liveCounts[vertex];
+					if (time - cacheTimes[vertex] > size)
+						cacheTimes[vertex] = time++;
+				}
+				isEmitted[triangle] = true;
+			}
+
+			//the oldest vertex that will still be in the cache once its remaining triangles are done
+			fan = -1;
+			uint32_t bestPriority{};
+			for (const uint32_t vertex : candidates)
+			{
+				if (liveCounts[vertex] == 0)
+					continue;
+
+				uint32_t priority{ 0 };
+				if (time - cacheTimes[vertex] + 2 * liveCounts[vertex] <= size)
+					priority = time - cacheTimes[vertex];
+				if (fan < 0 || priority > bestPriority)
+				{
+					fan = vertex;
+					bestPriority = priority;
+				}
+			}
+
+			//dead end: the most recently used vertex with triangles left, otherwise the next one in input order
+			while (fan < 0 && !deadEnds.empty())
+			{
+				const uint32_t vertex{ deadEnds.back() };
+				deadEnds.pop_back();
+				if (liveCounts[vertex] > 0)
+					fan = vertex;
+			}
+			while (fan < 0 && cursor < vertexCount)
+			{
+				if (liveCounts[cursor] > 0)
+					fan = static_cast<int64_t>(cursor);
+				++cursor;
+			}
+		}
+
+		indices = std::move(result);
+	}
+
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices, int cacheSize)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount < 2)
+			return;
+
+		//1. clusters start where the cache order starts over. Like Tipsify's threshold, a cluster is only cut once its own ACMR
+		//is down to the whole order's, the small ones around a restart would lose the reuse they get from their neighbours.
+		const float acmr{ CalculateACMR(indices, vertices.size(), cacheSize) };
+		std::vector<size_t> clusterStarts{ 0 };
+		VertexCacheSimulation cache{ vertices.size(), cacheSize };
+		size_t clusterMissCount{};
+		for (size_t i{}; i < triangleCount; ++i)
+		{
+			int missCount{};
+			for (size_t corner{}; corner < 3; ++corner)
+				missCount += cache.Access(indices[i * 3 + corner]) ? 1 : 0;
+			const size_t clusterTriangleCount{ i - clusterStarts.back() };
+			if (missCount == 3 && clusterTriangleCount > 0 && clusterMissCount <= acmr * clusterTriangleCount)
+			{
+				clusterStarts.push_back(i);
+				clusterMissCount = 0;
+			}
+			clusterMissCount += missCount;
+		}
+		clusterStarts.push_back(triangleCount);
+		const size_t clusterCount{ clusterStarts.size() - 1 };
+		if (clusterCount < 2)
+			return;
+
+		//2. area weighted center and summed normal per cluster. Both grow with the area, so the cluster sums make up the mesh's.
+		struct Cluster
+		{
+			Vector3 center{};
+			Vector3 normal{};
+			float area{};
+			float sortKey{};
+		};
+		std::vector<Cluster> clusters(clusterCount);
+		Vector3 meshCenter{};
+		float meshArea{};
+		concurrency::parallel_for(size_t{}, clusterCount, [&](size_t i) {
+			Cluster& cluster{ clusters[i] };
+			for (size_t triangle{ clusterStarts[i] }; triangle < clusterStarts[i + 1]; ++triangle)
+			{
+				const Vector3& p0{ vertices[indices[triangle * 3]].position };
+				const Vector3& p1{ vertices[indices[triangle * 3 + 1]].position };
+				const Vector3& p2{ vertices[indices[triangle * 3 + 2]].position };
+				const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+				const float area{ normal.Magnitude() * 0.5f };
+
+				cluster.center += (p0 + p1 + p2) * (area / 3.f);
+				cluster.normal += normal;
+				cluster.area += area;
+			}
+		});
+		for (const Cluster& cluster : clusters)
+		{
+			meshCenter += cluster.center;
+			meshArea += cluster.area;
+		}
+		if (meshArea > 0.f)
+			meshCenter = meshCenter / meshArea;
+
+		//3. the further a cluster faces out from the center, the sooner it's drawn
+		for (Cluster& cluster : clusters)
+		{
+			const float normalLength{ cluster.normal.Magnitude() };
+			if (cluster.area > 0.f && normalLength > 0.f)
+				cluster.sortKey = Vector3::Dot(cluster.center / cluster.area - meshCenter, cluster.normal / normalLength);
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		for (size_t i{}; i < clusterCount; ++i)
+			order[i] = static_cast<uint32_t>(i);
+		std::stable_sort(order.begin(), order.end(), [&clusters](uint32_t a, uint32_t b) { return clusters[a].sortKey > clusters[b].sortKey; });
+
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+		for (const uint32_t cluster : order)
+			result.insert(result.end(), indices.begin() + clusterStarts[cluster] * 3, indices.begin() + clusterStarts[cluster + 1] * 3);
+
+		//4. the clusters can still share vertices across a cut, a reorder that gives away too much of that keeps the cache order
+		if (CalculateACMR(result, vertices.size(), cacheSize) <= acmr * MaxOverdrawAcmrGrowth)
+			indices = std::move(result);
+	}
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t Unused{ UINT32_MAX };
+		std::vector<uint32_t> remap(vertices.size(), Unused);
+		std::vector<Vertex> result{};
+		result.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == Unused)
+			{
+				remap[index] = static_cast<uint32_t>(result.size());
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices = std::move(result);
+	}
+
+	void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::string& name)
+	{
+		const float acmrBefore{ CalculateACMR(indices, vertices.size()) };
+
+		OptimizeVertexCache(indices, vertices.size());
+		OptimizeOverdraw(indices, vertices);
+		OptimizeVertexFetch(vertices, indices);
+
+		const float acmrAfter{ CalculateACMR(indices, vertices.size()) };
+		std::cout << "MeshOptimizer: " << name << " ACMR " << acmrBefore << " -> " << acmrAfter << " (" << VertexCacheSize << " entry FIFO)\n";
+	}
+}
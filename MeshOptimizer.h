@@ -0,0 +1,27 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include "Datatypes.h"
+
+namespace dae
+{
+	//Post transform cache the passes optimize for and the ACMR is measured with, FIFO like most GPUs
+	constexpr int VertexCacheSize{ 16 };
+
+	//Average cache miss ratio: vertices transformed per triangle. 3 means no reuse at all, a big regular grid gets close to 0.5.
+	float CalculateACMR(std::span<const uint32_t> indices, size_t vertexCount, int cacheSize = VertexCacheSize);
+
+	//Tipsify (Sander et al. 2007): fans around vertices that are still in the cache, linear in the triangle count.
+	//Only the order of the triangles changes, every triangle keeps its winding.
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = VertexCacheSize);
+	//Tipsify's overdraw pass: cuts the cache order where it starts over (a triangle missing all three vertices) once the
+	//cluster's own ACMR is down to the whole order's, and draws the clusters facing away from the mesh's center first,
+	//they tend to cover the ones further in. The ACMR stays about the same, the cache order is kept when it would grow more than 5%.
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices, int cacheSize = VertexCacheSize);
+	//Vertices in the order the indices first use them, unused ones are dropped
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	//All three in that order, prints the ACMR before and after
+	void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::string& name);
+}
@@ -0,0 +1,444 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <ppl.h>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		//Sum of squared distances to planes, x^T A x with x = (p, 1). Only the upper half of the symmetric A is kept.
+		struct Quadric
+		{
+			double a00{}, a01{}, a02{}, a03{};
+			double a11{}, a12{}, a13{};
+			double a22{}, a23{};
+			double a33{};
+			double weight{};
+
+			void AddPlane(const Vector3& normal, float distance, float planeWeight)
+			{
+				const double x{ normal.x }, y{ normal.y }, z{ normal.z }, d{ distance };
+				a00 += planeWeight * x * x; a01 += planeWeight * x * y; a02 += planeWeight * x * z; a03 += planeWeight * x * d;
+				a11 += planeWeight * y * y; a12 += planeWeight * y * z; a13 += planeWeight * y * d;
+				a22 += planeWeight * z * z; a23 += planeWeight * z * d;
+				a33 += planeWeight * d * d;
+				weight += planeWeight;
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+				a11 += other.a11; a12 += other.a12; a13 += other.a13;
+				a22 += other.a22; a23 += other.a23;
+				a33 += other.a33;
+				weight += other.weight;
+				return *this;
+			}
+
+			//weighted mean of the squared distances
+			double Evaluate(const Vector3& p) const
+			{
+				const double x{ p.x }, y{ p.y }, z{ p.z };
+				const double error{ x * (a00 * x + 2 * (a01 * y + a02 * z + a03))
+					+ y * (a11 * y + 2 * (a12 * z + a13))
+					+ z * (a22 * z + 2 * a23)
+					+ a33 };
+				return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+			}
+		};
+
+		//every vertex to the lowest vertex with bitwise the same position
+		std::vector<uint32_t> GroupByPosition(std::span<const Vertex> vertices)
+		{
+			const auto key = [&vertices](uint32_t i) {
+				const Vector3& p{ vertices[i].position };
+				return std::make_tuple(std::bit_cast<uint32_t>(p.x), std::bit_cast<uint32_t>(p.y), std::bit_cast<uint32_t>(p.z));
+			};
+
+			std::vector<uint32_t> order(vertices.size());
+			for (size_t i{}; i < order.size(); ++i)
+				order[i] = static_cast<uint32_t>(i);
+			std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+			std::vector<uint32_t> groups(vertices.size());
+			for (size_t i{}; i < order.size(); ++i)
+				groups[order[i]] = i > 0 && key(order[i]) == key(order[i - 1]) ? groups[order[i - 1]] : order[i];
+			return groups;
+		}
+
+		//first[v]..first[v + 1] in adjacent are the triangles using vertex v
+		void BuildTriangleAdjacency(std::span<const uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& first, std::vector<uint32_t>& adjacent)
+		{
+			first.assign(vertexCount + 1, 0);
+			for (const uint32_t index : indices)
+				++first[index + 1];
+			for (size_t i{}; i < vertexCount; ++i)
+				first[i + 1] += first[i];
+
+			adjacent.resize(indices.size());
+			std::vector<uint32_t> cursors(first.begin(), first.end() - 1);
+			for (size_t i{}; i < indices.size(); ++i)
+				adjacent[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		//Groups on an edge only one triangle (or more than two) uses. Every edge a->b of a closed manifold has exactly one b->a.
+		std::vector<bool> FindBorderGroups(std::span<const uint32_t> indices, const std::vector<uint32_t>& groups)
+		{
+			std::vector<uint32_t> groupIndices(indices.size());
+			for (size_t i{}; i < indices.size(); ++i)
+				groupIndices[i] = groups[indices[i]];
+
+			std::vector<uint32_t> first{};
+			std::vector<uint32_t> adjacent{};
+			BuildTriangleAdjacency(groupIndices, groups.size(), first, adjacent);
+
+			//how often the directed edge a->b shows up among the triangles around a
+			const auto countEdges = [&](uint32_t a, uint32_t b) {
+				int count{};
+				for (uint32_t i{ first[a] }; i < first[a + 1]; ++i)
+				{
+					const uint32_t triangle{ adjacent[i] };
+					for (size_t corner{}; corner < 3; ++corner)
+					{
+						if (groupIndices[triangle * 3 + corner] == a && groupIndices[triangle * 3 + (corner + 1) % 3] == b)
+							++count;
+					}
+				}
+				return count;
+			};
+
+			std::vector<bool> isBorder(groups.size(), false);
+			for (size_t i{}; i < groupIndices.size(); ++i)
+			{
+				const uint32_t a{ groupIndices[i] };
+				const uint32_t b{ groupIndices[i - i % 3 + (i + 1) % 3] };
+				if (countEdges(a, b) != 1 || countEdges(b, a) != 1)
+				{
+					isBorder[a] = true;
+					isBorder[b] = true;
+				}
+			}
+			return isBorder;
+		}
+
+		Vector3 TriangleNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			return Vector3::Cross(p1 - p0, p2 - p0);
+		}
+
+		//Which vertices may move and the quadrics collected so far, both carry over from one level of detail to the next
+		class Simplifier final
+		{
+		public:
+			Simplifier(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+			//collapses until at most targetIndexCount indices are left, or nothing can collapse anymore
+			void Simplify(std::vector<uint32_t>& indices, size_t targetIndexCount);
+			//the largest collapse error so far, a distance in object space
+			float GetError() const { return std::sqrt(m_MaxCost); };
+
+		private:
+			static constexpr uint32_t NoTarget{ UINT32_MAX };
+
+			float GetCost(uint32_t from, uint32_t to) const;
+			bool IsFolding(std::span<const uint32_t> indices, uint32_t from, uint32_t to, size_t& outRemovedCount) const;
+
+			std::span<const Vertex> m_Vertices;
+			std::vector<uint32_t> m_Groups;
+			std::vector<uint8_t> m_CanMove;
+			std::vector<Quadric> m_Quadrics;
+			float m_MaxCost{};
+
+			//per pass, kept around so the passes don't allocate
+			std::vector<uint32_t> m_FirstTriangles{};
+			std::vector<uint32_t> m_Triangles{};
+			std::vector<uint32_t> m_Targets{};
+			std::vector<float> m_Costs{};
+			std::vector<uint32_t> m_Order{};
+			std::vector<uint8_t> m_IsTouched{};
+			std::vector<uint32_t> m_Remap{};
+		};
+
+		Simplifier::Simplifier(std::span<const Vertex> vertices, std::span<const uint32_t> indices) :
+			m_Vertices{ vertices },
+			m_Groups{ GroupByPosition(vertices) },
+			m_CanMove(vertices.size(), 0),
+			m_Quadrics(vertices.size())
+		{
+			//1. a vertex sharing its position with others sits on a seam, those and the borders stay where they are
+			std::vector<uint32_t> wedgeCounts(vertices.size(), 0);
+			for (const uint32_t group : m_Groups)
+				++wedgeCounts[group];
+
+			const std::vector<bool> isBorder{ FindBorderGroups(indices, m_Groups) };
+			for (size_t i{}; i < vertices.size(); ++i)
+				m_CanMove[i] = wedgeCounts[m_Groups[i]] == 1 && !isBorder[m_Groups[i]];
+
+			//2. area weighted planes of the triangles around every position
+			for (size_t i{}; i + 2 < indices.size(); i += 3)
+			{
+				const Vector3& p0{ vertices[indices[i]].position };
+				Vector3 normal{ TriangleNormal(p0, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position) };
+				const float doubleArea{ normal.Magnitude() };
+				if (!(doubleArea > 0.f) || !std::isfinite(doubleArea))
+					continue;
+
+				normal = normal / doubleArea;
+				const float distance{ -Vector3::Dot(normal, p0) };
+				for (size_t corner{}; corner < 3; ++corner)
+					m_Quadrics[m_Groups[indices[i + corner]]].AddPlane(normal, distance, doubleArea * 0.5f);
+			}
+		}
+
+		float Simplifier::GetCost(uint32_t from, uint32_t to) const
+		{
+			Quadric merged{ m_Quadrics[m_Groups[from]] };
+			merged += m_Quadrics[m_Groups[to]];
+			return static_cast<float>(merged.Evaluate(m_Vertices[to].position));
+		}
+
+		//The triangles around from that stay must not flip or turn too far, the ones on the edge disappear
+		bool Simplifier::IsFolding(std::span<const uint32_t> indices, uint32_t from, uint32_t to, size_t& outRemovedCount) const
+		{
+			outRemovedCount = 0;
+			for (uint32_t i{ m_FirstTriangles[from] }; i < m_FirstTriangles[from + 1]; ++i)
+			{
+				const uint32_t* pTriangle{ &indices[m_Triangles[i] * 3] };
+				if (m_Groups[pTriangle[0]] == m_Groups[to] || m_Groups[pTriangle[1]] == m_Groups[to] || m_Groups[pTriangle[2]] == m_Groups[to])
+				{
+					++outRemovedCount;
+					continue;
+				}
+
+				Vector3 moved[3]{ m_Vertices[pTriangle[0]].position, m_Vertices[pTriangle[1]].position, m_Vertices[pTriangle[2]].position };
+				const Vector3 before{ TriangleNormal(moved[0], moved[1], moved[2]) };
+				for (size_t corner{}; corner < 3; ++corner)
+				{
+					if (pTriangle[corner] == from)
+						moved[corner] = m_Vertices[to].position;
+				}
+				const Vector3 after{ TriangleNormal(moved[0], moved[1], moved[2]) };
+				if (!(Vector3::Dot(before, after) > 0.25f * before.Magnitude() * after.Magnitude()))
+					return true;
+			}
+			return false;
+		}
+
+		void Simplifier::Simplify(std::vector<uint32_t>& indices, size_t targetIndexCount)
+		{
+			const size_t vertexCount{ m_Vertices.size() };
+			m_Targets.resize(vertexCount);
+			m_Costs.resize(vertexCount);
+			m_IsTouched.resize(vertexCount);
+			m_Remap.resize(vertexCount);
+
+			//passes of the cheapest collapses that don't touch each other's triangles
+			while (indices.size() > targetIndexCount)
+			{
+				BuildTriangleAdjacency(indices, vertexCount, m_FirstTriangles, m_Triangles);
+
+				//1. every vertex that can move towards its cheapest neighbour
+				concurrency::parallel_for(size_t{}, vertexCount, [&](size_t vertex) {
+					m_Targets[vertex] = NoTarget;
+					m_Costs[vertex] = FLT_MAX;
+					if (!m_CanMove[vertex])
+						return;
+
+					for (uint32_t i{ m_FirstTriangles[vertex] }; i < m_FirstTriangles[vertex + 1]; ++i)
+					{
+						for (size_t corner{}; corner < 3; ++corner)
+						{
+							const uint32_t to{ indices[m_Triangles[i] * 3 + corner] };
+							if (m_Groups[to] == m_Groups[vertex])
+								continue;
+
+							const float cost{ GetCost(static_cast<uint32_t>(vertex), to) };
+							if (cost < m_Costs[vertex])
+							{
+								m_Costs[vertex] = cost;
+								m_Targets[vertex] = to;
+							}
+						}
+					}
+				});
+
+				m_Order.clear();
+				for (size_t i{}; i < vertexCount; ++i)
+				{
+					if (m_Targets[i] != NoTarget)
+						m_Order.push_back(static_cast<uint32_t>(i));
+				}
+				std::sort(m_Order.begin(), m_Order.end(), [this](uint32_t a, uint32_t b) {
+					return m_Costs[a] < m_Costs[b] || (m_Costs[a] == m_Costs[b] && a < b);
+				});
+
+				//2. cheapest first, as long as nothing around them changed yet in this pass
+				std::fill(m_IsTouched.begin(), m_IsTouched.end(), uint8_t{ 0 });
+				for (size_t i{}; i < vertexCount; ++i)
+					m_Remap[i] = static_cast<uint32_t>(i);
+
+				size_t trianglesLeft{ indices.size() / 3 };
+				size_t collapseCount{};
+				for (const uint32_t from : m_Order)
+				{
+					if (trianglesLeft * 3 <= targetIndexCount)
+						break;
+
+					const uint32_t to{ m_Targets[from] };
+					size_t removedCount{};
+					if (m_IsTouched[from] || m_IsTouched[m_Groups[to]] || IsFolding(indices, from, to, removedCount))
+						continue;
+
+					//the checks above would be stale for anything around the moved vertex
+					for (uint32_t i{ m_FirstTriangles[from] }; i < m_FirstTriangles[from + 1]; ++i)
+					{
+						for (size_t corner{}; corner < 3; ++corner)
+							m_IsTouched[m_Groups[indices[m_Triangles[i] * 3 + corner]]] = 1;
+					}
+					m_IsTouched[m_Groups[to]] = 1;
+
+					m_Remap[from] = to;
+					m_Quadrics[m_Groups[to]] += m_Quadrics[from];
+					m_MaxCost = std::max(m_MaxCost, m_Costs[from]);
+					trianglesLeft -= removedCount;
+					++collapseCount;
+				}
+
+				if (collapseCount == 0)
+					return;
+
+				//3. apply the pass, triangles that lost an edge are gone
+				size_t writeIndex{};
+				for (size_t i{}; i + 2 < indices.size(); i += 3)
+				{
+					const uint32_t a{ m_Remap[indices[i]] };
+					const uint32_t b{ m_Remap[indices[i + 1]] };
+					const uint32_t c{ m_Remap[indices[i + 2]] };
+					if (m_Groups[a] == m_Groups[b] || m_Groups[b] == m_Groups[c] || m_Groups[a] == m_Groups[c])
+						continue;
+
+					indices[writeIndex++] = a;
+					indices[writeIndex++] = b;
+					indices[writeIndex++] = c;
+				}
+				indices.resize(writeIndex);
+			}
+		}
+	}
+
+	std::vector<uint32_t> SimplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& outError)
+	{
+		std::vector<uint32_t> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+		outError = 0.f;
+		if (result.size() <= targetIndexCount || vertices.empty())
+			return result;
+
+		Simplifier simplifier{ vertices, result };
+		simplifier.Simplify(result, targetIndexCount);
+		outError = simplifier.GetError();
+		return result;
+	}
+
+	std::vector<MeshLod> BuildLodChain(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		std::vector<MeshLod> lods{ { 0, static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(vertices.size()), 0.f } };
+		if (triangleCount / 2 < MinLodTriangleCount)
+			return lods;
+
+		//1. every level goes on from the one before, with the quadrics that one left behind
+		Simplifier simplifier{ vertices, indices };
+		std::vector<std::vector<uint32_t>> levels{ indices };
+		std::vector<float> errors{ 0.f };
+		for (size_t level{ 1 }; level < MaxLodCount && (triangleCount >> level) >= MinLodTriangleCount; ++level)
+		{
+			std::vector<uint32_t> simplified{ levels.back() };
+			simplifier.Simplify(simplified, (triangleCount >> level) * 3);
+
+			//a level that barely got smaller than the one before isn't worth keeping, the next won't get much further either
+			if (simplified.size() * 10 > levels.back().size() * 9)
+				break;
+
+			levels.push_back(std::move(simplified));
+			errors.push_back(simplifier.GetError());
+		}
+
+		//2. the coarse levels are reordered for the cache, in parallel
+		concurrency::parallel_for(size_t{ 1 }, levels.size(), [&](size_t level) {
+			OptimizeVertexCache(levels[level], vertices.size());
+		});
+
+		//3. vertices the coarsest levels use first, so each level uses a prefix. Within its band every vertex goes where
+		//the coarsest level using it first reads it, that level then reads its band front to back like level 0 does after OptimizeVertexFetch
+		std::vector<uint32_t> coarsestUse(vertices.size(), 0);
+		for (size_t level{ 1 }; level < levels.size(); ++level)
+		{
+			for (const uint32_t index : levels[level])
+				coarsestUse[index] = static_cast<uint32_t>(level);
+		}
+
+		std::vector<uint32_t> order{};
+		order.reserve(vertices.size());
+		std::vector<bool> isPlaced(vertices.size(), false);
+		for (size_t level{ levels.size() }; level-- > 0;)
+		{
+			for (const uint32_t index : levels[level])
+			{
+				if (coarsestUse[index] == level && !isPlaced[index])
+				{
+					isPlaced[index] = true;
+					order.push_back(index);
+				}
+			}
+		}
+		//vertices no level uses stay at the end
+		for (uint32_t i{}; i < vertices.size(); ++i)
+		{
+			if (!isPlaced[i])
+				order.push_back(i);
+		}
+
+		std::vector<uint32_t> remap(vertices.size());
+		std::vector<Vertex> reordered(vertices.size());
+		for (size_t i{}; i < order.size(); ++i)
+		{
+			remap[order[i]] = static_cast<uint32_t>(i);
+			reordered[i] = vertices[order[i]];
+		}
+		vertices = std::move(reordered);
+
+		//4. all levels in one index stream
+		lods.clear();
+		indices.clear();
+		for (size_t level{}; level < levels.size(); ++level)
+		{
+			MeshLod lod{};
+			lod.indexOffset = static_cast<uint32_t>(indices.size());
+			lod.indexCount = static_cast<uint32_t>(levels[level].size());
+			lod.vertexCount = static_cast<uint32_t>(std::count_if(coarsestUse.begin(), coarsestUse.end(), [level](uint32_t use) { return use >= level; }));
+			lod.error = errors[level];
+			lods.push_back(lod);
+
+			for (const uint32_t index : levels[level])
+				indices.push_back(remap[index]);
+		}
+		return lods;
+	}
+
+	size_t SelectLod(std::span<const MeshLod> lods, float distance, float pixelsPerUnit, float maxPixelError)
+	{
+		if (lods.empty() || !(distance > 0.f))
+			return 0;
+
+		for (size_t i{ lods.size() - 1 }; i > 0; --i)
+		{
+			if (lods[i].error * pixelsPerUnit / distance <= maxPixelError)
+				return i;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "Datatypes.h"
+
+namespace dae
+{
+	//One level of detail, a range of the mesh's index stream. All levels share the vertex stream,
+	//a level only uses its first vertexCount vertices.
+	struct MeshLod
+	{
+		uint32_t indexOffset{};
+		uint32_t indexCount{};
+		uint32_t vertexCount{};
+		float error{}; //how far the level may be off from the full mesh in object space, 0 for the full mesh
+		uint32_t stripOffset{}; //the same triangles as strips, see StripifyMesh. Filled in by MeshGeometry.
+		uint32_t stripCount{};
+	};
+
+	//Levels stop once they would have fewer triangles than this
+	constexpr size_t MinLodTriangleCount{ 128 };
+	constexpr size_t MaxLodCount{ 8 };
+
+	//Quadric error metric edge collapses (Garland & Heckbert 1997) until at most targetIndexCount indices are left.
+	//A vertex only ever collapses onto a neighbour, so the result indexes the same vertices. Vertices on uv/normal seams
+	//and open borders are never moved, the outline and the texture layout stay where they are.
+	//outError is the largest collapse error, a distance in object space. Stops early when nothing can collapse anymore.
+	std::vector<uint32_t> SimplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& outError);
+
+	//Level 0 is the mesh itself, every next level aims for half the triangles of the one before and is simplified from it.
+	//All levels end up in indices, one after the other. The vertices are reordered so that every level uses a prefix.
+	std::vector<MeshLod> BuildLodChain(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	//The coarsest level whose error, projected at distance, stays within maxPixelError.
+	//pixelsPerUnit is the size on screen of one unit at distance 1.
+	size_t SelectLod(std::span<const MeshLod> lods, float distance, float pixelsPerUnit, float maxPixelError);
+}
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "MeshStripifier.h"
+
+namespace dae
+{
+	std::vector<uint32_t> StripifyMesh(std::span<const uint32_t> indices, size_t vertexCount)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		std::vector<uint32_t> strips{};
+		if (triangleCount == 0 || vertexCount == 0)
+			return strips;
+
+		//1. the triangles around every vertex
+		std::vector<uint32_t> firstTriangles(vertexCount + 1, 0);
+		for (size_t i{}; i < triangleCount * 3; ++i)
+			++firstTriangles[indices[i] + 1];
+		for (size_t i{}; i < vertexCount; ++i)
+			firstTriangles[i + 1] += firstTriangles[i];
+
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> fillCursors(firstTriangles.begin(), firstTriangles.end() - 1);
+		for (size_t i{}; i < triangleCount * 3; ++i)
+			adjacency[fillCursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		//an unused triangle that has the directed edge from -> to, what comes after to is its third vertex
+		constexpr uint32_t NoTriangle{ UINT32_MAX };
+		std::vector<bool> isUsed(triangleCount, false);
+		const auto findTriangle = [&](uint32_t from, uint32_t to, uint32_t& outThird) {
+			for (uint32_t i{ firstTriangles[from] }; i < firstTriangles[from + 1]; ++i)
+			{
+				const uint32_t triangle{ adjacency[i] };
+				if (isUsed[triangle])
+					continue;
+
+				const uint32_t* pCorners{ &indices[triangle * 3] };
+				for (int corner{}; corner < 3; ++corner)
+				{
+					if (pCorners[corner] == from && pCorners[(corner + 1) % 3] == to)
+					{
+						outThird = pCorners[(corner + 2) % 3];
+						return triangle;
+					}
+				}
+			}
+			return NoTriangle;
+		};
+
+		//2. start with the triangles that have the fewest neighbours, in their current order otherwise
+		std::vector<uint32_t> startOrder{};
+		startOrder.reserve(triangleCount);
+		{
+			std::vector<uint8_t> neighbourCounts(triangleCount);
+			uint32_t third{};
+			for (size_t i{}; i < triangleCount; ++i)
+			{
+				const uint32_t* pCorners{ &indices[i * 3] };
+				for (int corner{}; corner < 3; ++corner)
+					neighbourCounts[i] += findTriangle(pCorners[(corner + 1) % 3], pCorners[corner], third) != NoTriangle ? 1 : 0;
+			}
+			for (uint8_t count{}; count <= 3; ++count)
+			{
+				for (size_t i{}; i < triangleCount; ++i)
+				{
+					if (neighbourCounts[i] == count)
+						startOrder.push_back(static_cast<uint32_t>(i));
+				}
+			}
+		}
+
+		//3. grow every strip for as long as the next triangle has the winding its place in the strip needs
+		strips.reserve(triangleCount * 2);
+		for (const uint32_t start : startOrder)
+		{
+			if (isUsed[start])
+				continue;
+			isUsed[start] = true;
+
+			//the second triangle is drawn as (c, b, x), rotate the first one so that it has a neighbour there if it can
+			const uint32_t* pCorners{ &indices[start * 3] };
+			int rotation{};
+			uint32_t third{};
+			for (int i{}; i < 3; ++i)
+			{
+				if (findTriangle(pCorners[(i + 2) % 3], pCorners[(i + 1) % 3], third) != NoTriangle)
+				{
+					rotation = i;
+					break;
+				}
+			}
+
+			if (!strips.empty())
+				strips.push_back(StripRestartIndex);
+			for (int i{}; i < 3; ++i)
+				strips.push_back(pCorners[(rotation + i) % 3]);
+
+			for (size_t triangleIndex{ 1 };; ++triangleIndex)
+			{
+				const uint32_t previous{ strips[strips.size() - 2] };
+				const uint32_t last{ strips.back() };
+				const bool isOdd{ triangleIndex % 2 == 1 };
+				const uint32_t next{ isOdd ? findTriangle(last, previous, third) : findTriangle(previous, last, third) };
+				if (next == NoTriangle)
+					break;
+
+				isUsed[next] = true;
+				strips.push_back(third);
+			}
+		}
+		return strips;
+	}
+
+	size_t CountStripTriangles(std::span<const uint32_t> stripIndices)
+	{
+		size_t triangleCount{};
+		size_t stripLength{};
+		for (const uint32_t index : stripIndices)
+		{
+			stripLength = index == StripRestartIndex ? 0 : stripLength + 1;
+			triangleCount += stripLength >= 3 ? 1 : 0;
+		}
+		return triangleCount;
+	}
+}
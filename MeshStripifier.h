@@ -0,0 +1,21 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "Datatypes.h"
+
+namespace dae
+{
+	//Ends a strip and starts the next one, the strip cut value of R32_UINT indices on D3D11
+	constexpr uint32_t StripRestartIndex{ UINT32_MAX };
+
+	/**
+	 * \brief Turns a triangle list into triangle strips separated by StripRestartIndex.
+	 * A strip is grown greedily across shared edges as long as the next triangle keeps the winding the strip alternates to,
+	 * so every triangle keeps its winding. Strips start at the triangles with the fewest neighbours, those would end up alone otherwise.
+	 * Triangle i of a strip s is (s[i], s[i + 1], s[i + 2]) for even i and (s[i + 1], s[i], s[i + 2]) for odd i.
+	 */
+	std::vector<uint32_t> StripifyMesh(std::span<const uint32_t> indices, size_t vertexCount);
+
+	//Triangles in a strip index stream, restarts left out
+	size_t CountStripTriangles(std::span<const uint32_t> stripIndices);
+}
@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "MeshTangents.h"
+#include <ppl.h>
+#include <cmath>
+#include <thread>
+
+namespace dae
+{
+	namespace
+	{
+		//fewer vertices than this per thread aren't worth another pass over the corners
+		constexpr size_t MinRangeVertexCount{ 64 * 1024 };
+
+		//the directions u and v grow in along a triangle, handedness 0 when its uvs have no area
+		struct TriangleFrame
+		{
+			Vector3 tangent{};
+			Vector3 bitangent{};
+			int handedness{};
+			float angles[3]{}; //per corner, what the corner's vertex weighs the frame with
+		};
+
+		float CornerAngle(const Vector3& corner, const Vector3& next, const Vector3& previous)
+		{
+			const Vector3 edge0{ next - corner };
+			const Vector3 edge1{ previous - corner };
+			const float lengths{ edge0.Magnitude() * edge1.Magnitude() };
+			if (!(lengths > 0.f))
+				return 0.f;
+			return std::acos(Clamp(Vector3::Dot(edge0, edge1) / lengths, -1.f, 1.f));
+		}
+
+		TriangleFrame CalculateTriangleFrame(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+		{
+			const Vector3 edge0{ v1.position - v0.position };
+			const Vector3 edge1{ v2.position - v0.position };
+			const Vector2 diffX{ v1.uv.x - v0.uv.x, v2.uv.x - v0.uv.x };
+			const Vector2 diffY{ v1.uv.y - v0.uv.y, v2.uv.y - v0.uv.y };
+			const float determinant{ Vector2::Cross(diffX, diffY) };
+			const float r{ 1.f / determinant };
+			if (determinant == 0.f || !std::isfinite(r))
+				return {};
+
+			const Vector3 tangent{ (edge0 * diffY.y - edge1 * diffY.x) * r };
+			const Vector3 bitangent{ (edge1 * diffX.x - edge0 * diffX.y) * r };
+			const float tangentLength{ tangent.Magnitude() };
+			const float bitangentLength{ bitangent.Magnitude() };
+			if (!(tangentLength > 0.f) || !(bitangentLength > 0.f) || !std::isfinite(tangentLength) || !std::isfinite(bitangentLength))
+				return {};
+
+			//only the direction counts, a triangle with a small uv area would outweigh its neighbours otherwise
+			const Vector3 normal{ Vector3::Cross(edge0, edge1) };
+			return { tangent / tangentLength, bitangent / bitangentLength, Vector3::Dot(Vector3::Cross(normal, tangent), bitangent) < 0.f ? -1 : 1,
+				{ CornerAngle(v0.position, v1.position, v2.position), CornerAngle(v1.position, v2.position, v0.position), CornerAngle(v2.position, v0.position, v1.position) } };
+		}
+
+		//Any unit vector orthogonal to the normal (Duff et al. 2017, no branch on the axis)
+		Vector3 AnyTangent(const Vector3& normal)
+		{
+			const float sign{ std::copysign(1.f, normal.z) };
+			const float a{ -1.f / (sign + normal.z) };
+			const float b{ normal.x * normal.y * a };
+			return { 1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+		}
+	}
+
+	void GenerateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+
+		//1. the frame of every triangle, one without uv area stays all zero and adds nothing
+		//The handedness is also kept on its own, the split looks it up per vertex and the frames don't fit in the cache.
+		std::vector<TriangleFrame> frames(triangleCount);
+		std::vector<int8_t> triangleHandedness(triangleCount);
+		concurrency::parallel_for(size_t{}, triangleCount, [&](size_t i) {
+			frames[i] = CalculateTriangleFrame(vertices[indices[i * 3]], vertices[indices[i * 3 + 1]], vertices[indices[i * 3 + 2]]);
+			triangleHandedness[i] = static_cast<int8_t>(frames[i].handedness);
+		});
+
+		//2. the corners around every vertex. Every thread takes a range of the vertices and goes through all corners for the
+		//ones of its range: reading the indices once per range is cheaper than sharing counters, and the corners stay in order.
+		const size_t vertexCount{ vertices.size() };
+		const size_t rangeCount{ std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(vertexCount / MinRangeVertexCount, 1)) };
+		const size_t rangeSize{ (vertexCount + rangeCount - 1) / rangeCount };
+		std::vector<uint32_t> firstCorners(vertexCount + 1, 0);
+		concurrency::parallel_for(size_t{}, rangeCount, [&](size_t range) {
+			const size_t firstVertex{ range * rangeSize };
+			for (size_t i{}; i < triangleCount * 3; ++i)
+			{
+				if (indices[i] - firstVertex < rangeSize)
+					++firstCorners[indices[i] + 1];
+			}
+		});
+		for (size_t i{}; i < vertexCount; ++i)
+			firstCorners[i + 1] += firstCorners[i];
+
+		std::vector<uint32_t> corners(triangleCount * 3);
+		std::vector<uint32_t> fillCursors(firstCorners.begin(), firstCorners.end() - 1);
+		concurrency::parallel_for(size_t{}, rangeCount, [&](size_t range) {
+			const size_t firstVertex{ range * rangeSize };
+			for (size_t i{}; i < triangleCount * 3; ++i)
+			{
+				if (indices[i] - firstVertex < rangeSize)
+					corners[fillCursors[indices[i]]++] = static_cast<uint32_t>(i);
+			}
+		});
+
+		//3. a vertex on the line a mirrored uv island was folded over gets a copy for the triangles
+		//that don't have the handedness it's first used with
+		constexpr uint32_t NoCopy{ UINT32_MAX };
+		std::vector<int> handedness(vertexCount, 0);
+		std::vector<uint32_t> firstCopiedCorners(vertexCount, NoCopy);
+		concurrency::parallel_for(size_t{}, vertexCount, [&](size_t i) {
+			bool isMixed{};
+			for (uint32_t j{ firstCorners[i] }; j < firstCorners[i + 1] && !isMixed; ++j)
+			{
+				const int cornerHandedness{ triangleHandedness[corners[j] / 3] };
+				if (handedness[i] == 0)
+					handedness[i] = cornerHandedness;
+				else if (cornerHandedness != 0)
+					isMixed = cornerHandedness != handedness[i];
+			}
+			if (!isMixed)
+				return;
+
+			//triangles without uv area go to the copy as well
+			for (uint32_t j{ firstCorners[i] }; j < firstCorners[i + 1] && firstCopiedCorners[i] == NoCopy; ++j)
+			{
+				if (triangleHandedness[corners[j] / 3] != handedness[i])
+					firstCopiedCorners[i] = corners[j];
+			}
+		});
+
+		//the copies are appended in the order their first corner comes in
+		std::vector<uint32_t> copiedVertices{};
+		for (uint32_t i{}; i < vertexCount; ++i)
+		{
+			if (firstCopiedCorners[i] != NoCopy)
+				copiedVertices.push_back(i);
+		}
+		std::sort(copiedVertices.begin(), copiedVertices.end(), [&firstCopiedCorners](uint32_t a, uint32_t b) { return firstCopiedCorners[a] < firstCopiedCorners[b]; });
+		vertices.resize(vertexCount + copiedVertices.size());
+		concurrency::parallel_for(size_t{}, copiedVertices.size(), [&](size_t i) {
+			const uint32_t original{ copiedVertices[i] };
+			const uint32_t copy{ static_cast<uint32_t>(vertexCount + i) };
+			vertices[copy] = vertices[original];
+			for (uint32_t j{ firstCorners[original] }; j < firstCorners[original + 1]; ++j)
+			{
+				if (triangleHandedness[corners[j] / 3] != handedness[original])
+					indices[corners[j]] = copy;
+			}
+		});
+
+		//4. every vertex gathers its own corners, nothing is written twice. A copy goes through its original's corners
+		//and both only take the ones that still refer to them.
+		concurrency::parallel_for(size_t{}, vertices.size(), [&](size_t i) {
+			Vertex& vertex{ vertices[i] };
+			const uint32_t source{ i < vertexCount ? static_cast<uint32_t>(i) : copiedVertices[i - vertexCount] };
+			const bool isSplit{ firstCopiedCorners[source] != NoCopy };
+			Vector3 tangent{};
+			Vector3 bitangent{};
+			for (uint32_t j{ firstCorners[source] }; j < firstCorners[source + 1]; ++j)
+			{
+				const uint32_t corner{ corners[j] };
+				if (isSplit && indices[corner] != i)
+					continue;
+				const TriangleFrame& frame{ frames[corner / 3] };
+				tangent += frame.tangent * frame.angles[corner % 3];
+				bitangent += frame.bitangent * frame.angles[corner % 3];
+			}
+
+			const Vector3 normal{ vertex.normal.Magnitude() > 0.f ? vertex.normal.Normalized() : Vector3::UnitZ };
+			tangent = Vector3::Reject(tangent, normal);
+			const float length{ tangent.Magnitude() };
+			vertex.tangent = length > 1e-6f && std::isfinite(length) ? tangent / length : AnyTangent(normal);
+			vertex.handedness = Vector3::Dot(Vector3::Cross(normal, vertex.tangent), bitangent) < 0.f ? -1.f : 1.f;
+		});
+	}
+}
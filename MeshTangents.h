@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+#include "Datatypes.h"
+
+namespace dae
+{
+	/**
+	 * \brief Per vertex tangents from the uv layout, orthogonal to the normals, with the handedness of the bitangent.
+	 * Every corner adds its triangle's tangent direction weighted by the corner's angle, gathered per vertex in parallel.
+	 * Triangles without uv area add nothing, a vertex that ends up without a tangent gets any one orthogonal to its normal.
+	 * A vertex shared by triangles with mirrored uvs is split, every copy gets the tangent of its own side.
+	 * \param vertices need position, uv and normal, get tangent and handedness. Split vertices are appended.
+	 */
+	void GenerateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "Meshlets.h"
+#include <ppl.h>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		//a triangle further off the meshlet's average normal than this starts a new meshlet, so the cones stay narrow enough to cull.
+		//Not before the meshlet has MinConeSplitTriangles, noisy normals would cut everything into single triangles otherwise.
+		constexpr float MinConeDot{ 0.7f };
+		constexpr uint32_t MinConeSplitTriangles{ MaxMeshletTriangles / 4 };
+		//below this the cone is too wide to ever cull anything (meshoptimizer uses the same)
+		constexpr float MinCullableConeDot{ 0.1f };
+
+		Vector3 CalculateTriangleNormal(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+		{
+			const Vector3 normal{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position) };
+			const float length{ normal.Magnitude() };
+			return length > 0.f && std::isfinite(length) ? normal / length : Vector3{};
+		}
+	}
+
+	void BuildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+		std::vector<Meshlet>& outMeshlets, std::vector<uint32_t>& outVertices, std::vector<uint8_t>& outTriangles)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		outMeshlets.clear();
+		outVertices.clear();
+		outTriangles.resize(triangleCount * 3);
+
+		//1. facing of every triangle, the winding the rasterizers cull by. Degenerate ones stay zero and face nowhere.
+		std::vector<Vector3> normals(triangleCount);
+		concurrency::parallel_for(size_t{}, triangleCount, [&](size_t i) {
+			normals[i] = CalculateTriangleNormal(vertices[indices[i * 3]], vertices[indices[i * 3 + 1]], vertices[indices[i * 3 + 2]]);
+		});
+
+		//2. runs of the triangles, in the order the vertex cache optimization left them
+		constexpr uint32_t NoVertex{ UINT32_MAX };
+		std::vector<uint32_t> localVertices(vertices.size(), NoVertex);
+		Meshlet meshlet{};
+		Vector3 normalSum{};
+		const auto closeMeshlet = [&] {
+			for (uint32_t i{ meshlet.vertexOffset }; i < outVertices.size(); ++i)
+				localVertices[outVertices[i]] = NoVertex;
+			meshlet.vertexCount = static_cast<uint32_t>(outVertices.size()) - meshlet.vertexOffset;
+			outMeshlets.push_back(meshlet);
+
+			meshlet = { {}, 0.f, {}, 1.f, meshlet.triangleOffset + meshlet.triangleCount, 0, static_cast<uint32_t>(outVertices.size()), 0 };
+			normalSum = {};
+		};
+
+		for (size_t i{}; i < triangleCount; ++i)
+		{
+			const uint32_t* pTriangle{ &indices[i * 3] };
+			uint32_t newVertices{};
+			for (int corner{}; corner < 3; ++corner)
+				newVertices += localVertices[pTriangle[corner]] == NoVertex ? 1 : 0;
+
+			const uint32_t vertexCount{ static_cast<uint32_t>(outVertices.size()) - meshlet.vertexOffset };
+			const bool isOffCone{ meshlet.triangleCount >= MinConeSplitTriangles && normalSum.Magnitude() > 0.f
+				&& Vector3::Dot(normals[i], normalSum.Normalized()) < MinConeDot };
+			if (meshlet.triangleCount > 0 && (meshlet.triangleCount == MaxMeshletTriangles || vertexCount + newVertices > MaxMeshletVertices || isOffCone))
+				closeMeshlet();
+
+			for (int corner{}; corner < 3; ++corner)
+			{
+				uint32_t& local{ localVertices[pTriangle[corner]] };
+				if (local == NoVertex)
+				{
+					local = static_cast<uint32_t>(outVertices.size()) - meshlet.vertexOffset;
+					outVertices.push_back(pTriangle[corner]);
+				}
+				outTriangles[i * 3 + corner] = static_cast<uint8_t>(local);
+			}
+			++meshlet.triangleCount;
+			normalSum += normals[i];
+		}
+		if (meshlet.triangleCount > 0)
+			closeMeshlet();
+
+		//3. bounding sphere and normal cone of every meshlet
+		concurrency::parallel_for(size_t{}, outMeshlets.size(), [&](size_t i) {
+			Meshlet& current{ outMeshlets[i] };
+			const std::span<const uint32_t> meshletVertices{ outVertices.data() + current.vertexOffset, current.vertexCount };
+
+			Vector3 boundsMin{ vertices[meshletVertices[0]].position };
+			Vector3 boundsMax{ boundsMin };
+			for (const uint32_t vertex : meshletVertices)
+			{
+				const Vector3& position{ vertices[vertex].position };
+				boundsMin = { std::min(boundsMin.x, position.x), std::min(boundsMin.y, position.y), std::min(boundsMin.z, position.z) };
+				boundsMax = { std::max(boundsMax.x, position.x), std::max(boundsMax.y, position.y), std::max(boundsMax.z, position.z) };
+			}
+			current.center = (boundsMin + boundsMax) * 0.5f;
+			for (const uint32_t vertex : meshletVertices)
+				current.radius = std::max(current.radius, (vertices[vertex].position - current.center).Magnitude());
+
+			Vector3 axis{};
+			for (uint32_t j{ current.triangleOffset }; j < current.triangleOffset + current.triangleCount; ++j)
+				axis += normals[j];
+			const float axisLength{ axis.Magnitude() };
+			if (!(axisLength > 0.f))
+				return;
+			current.coneAxis = axis / axisLength;
+
+			//a degenerate triangle faces nowhere, it can't keep the meshlet from being culled
+			float minDot{ 1.f };
+			for (uint32_t j{ current.triangleOffset }; j < current.triangleOffset + current.triangleCount; ++j)
+			{
+				if (normals[j].SqrMagnitude() > 0.f)
+					minDot = std::min(minDot, Vector3::Dot(normals[j], current.coneAxis));
+			}
+			current.coneCutoff = minDot <= MinCullableConeDot ? 1.f : std::sqrt(1.f - minDot * minDot);
+		});
+	}
+
+	MeshletCuller::MeshletCuller(const Matrix& worldMatrix, const Matrix& viewProjectionMatrix, const Vector3& cameraOrigin, CullMode cullMode) :
+		m_CameraOrigin{ Matrix::Inverse(worldMatrix).TransformPoint(cameraOrigin) },
+		m_CullMode{ cullMode }
+	{
+		//the clip planes of the whole transform are the frustum in object space (Gribb & Hartmann), z runs from 0 to w
+		const Matrix worldViewProjectionMatrix{ worldMatrix * viewProjectionMatrix };
+		Vector4 columns[4]{};
+		for (int i{}; i < 4; ++i)
+			columns[i] = { worldViewProjectionMatrix[0][i], worldViewProjectionMatrix[1][i], worldViewProjectionMatrix[2][i], worldViewProjectionMatrix[3][i] };
+
+		m_Planes[0] = columns[3] + columns[0];
+		m_Planes[1] = columns[3] - columns[0];
+		m_Planes[2] = columns[3] + columns[1];
+		m_Planes[3] = columns[3] - columns[1];
+		m_Planes[4] = columns[2];
+		m_Planes[5] = columns[3] - columns[2];
+		for (Vector4& plane : m_Planes)
+		{
+			const float length{ plane.GetXYZ().Magnitude() };
+			if (length > 0.f)
+				plane = plane * (1.f / length);
+		}
+	}
+
+	bool MeshletCuller::IsVisible(const Meshlet& meshlet) const
+	{
+		for (const Vector4& plane : m_Planes)
+		{
+			if (Vector3::Dot(plane.GetXYZ(), meshlet.center) + plane.w < -meshlet.radius)
+				return false;
+		}
+
+		if (m_CullMode == CullMode::None)
+			return true;
+
+		//every triangle faces away (or towards, for front culling) from anywhere in the bounding sphere
+		const Vector3 toMeshlet{ meshlet.center - m_CameraOrigin };
+		const Vector3 axis{ m_CullMode == CullMode::Back ? meshlet.coneAxis : -meshlet.coneAxis };
+		return Vector3::Dot(toMeshlet, axis) < meshlet.coneCutoff * toMeshlet.Magnitude() + meshlet.radius;
+	}
+}
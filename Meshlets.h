@@ -0,0 +1,51 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "Datatypes.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	//Sized like the meshlets of mesh shader hardware, the local indices of a meshlet fit in a byte
+	constexpr uint32_t MaxMeshletVertices{ 64 };
+	constexpr uint32_t MaxMeshletTriangles{ 124 };
+
+	//A run of consecutive triangles of level 0 with what culling it needs, all in object space
+	struct Meshlet
+	{
+		Vector3 center{};
+		float radius{};
+		//every triangle's normal is within the cone around axis, cutoff is the sine of its half angle. 1 when it can't be culled.
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+		uint32_t triangleOffset{}; //first triangle of level 0, the same one in the meshlet triangle stream
+		uint32_t triangleCount{};
+		uint32_t vertexOffset{}; //first entry of the meshlet vertex stream
+		uint32_t vertexCount{};
+	};
+
+	/**
+	 * \brief Cuts the triangles into meshlets in the order they're in, so the index stream stays as it is.
+	 * A meshlet ends when it runs out of vertices or triangles, or when the next triangle would widen its normal cone too much.
+	 * \param outVertices per meshlet, the mesh vertices it uses
+	 * \param outTriangles per triangle, three indices into its meshlet's vertices
+	 */
+	void BuildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+		std::vector<Meshlet>& outMeshlets, std::vector<uint32_t>& outVertices, std::vector<uint8_t>& outTriangles);
+
+	//The view frustum and the camera in a mesh's object space, what its meshlets are culled against
+	class MeshletCuller final
+	{
+	public:
+		//cullMode decides which facing the normal cones cull, None only culls against the frustum
+		MeshletCuller(const Matrix& worldMatrix, const Matrix& viewProjectionMatrix, const Vector3& cameraOrigin, CullMode cullMode);
+
+		//false when the meshlet is outside the frustum or all of its triangles face the culled way
+		bool IsVisible(const Meshlet& meshlet) const;
+
+	private:
+		Vector4 m_Planes[6]{}; //normalized, inside is positive
+		Vector3 m_CameraOrigin{};
+		CullMode m_CullMode{ CullMode::Back };
+	};
+}
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "MipChain.h"
+#include <new>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr size_t LevelAlignment{ 64 };
+	}
+
+	size_t LayoutMipChain(int width, int height, size_t blockSize, std::vector<MipLevel>& outLevels)
+	{
+		outLevels.clear();
+		size_t offset{};
+		while (true)
+		{
+			outLevels.push_back({ width, height, offset });
+			const size_t blocksPerRow{ static_cast<size_t>(width + TexelBlockSize - 1) / TexelBlockSize };
+			const size_t blocksPerColumn{ static_cast<size_t>(height + TexelBlockSize - 1) / TexelBlockSize };
+			offset += (blocksPerRow * blocksPerColumn * blockSize + LevelAlignment - 1) / LevelAlignment * LevelAlignment;
+			if (width == 1 && height == 1)
+				return offset;
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+	}
+
+	uint8_t* AllocateTexels(size_t size)
+	{
+		return static_cast<uint8_t*>(::operator new[](size, std::align_val_t{ LevelAlignment }));
+	}
+
+	void FreeTexels(uint8_t* pTexels)
+	{
+		if (pTexels)
+			::operator delete[](pTexels, std::align_val_t{ LevelAlignment });
+	}
+
+	void CreateNextMipLevel(const uint8_t* pSource, int sourceWidth, int sourceHeight, uint8_t* pDestination, int width, int height)
+	{
+		concurrency::parallel_for(0, height, [&](int y) {
+			//clamp so odd or 1 pixel wide sources still work
+			const int y0{ std::min(y * 2, sourceHeight - 1) };
+			const int y1{ std::min(y * 2 + 1, sourceHeight - 1) };
+			const uint8_t* pRow0{ pSource + static_cast<size_t>(y0) * sourceWidth * 4 };
+			const uint8_t* pRow1{ pSource + static_cast<size_t>(y1) * sourceWidth * 4 };
+			uint8_t* pRow{ pDestination + static_cast<size_t>(y) * width * 4 };
+
+			for (int x{}; x < width; ++x)
+			{
+				const int x0{ std::min(x * 2, sourceWidth - 1) * 4 };
+				const int x1{ std::min(x * 2 + 1, sourceWidth - 1) * 4 };
+				for (int channel{}; channel < 4; ++channel)
+				{
+					const int sum{ pRow0[x0 + channel] + pRow0[x1 + channel] + pRow1[x0 + channel] + pRow1[x1 + channel] };
+					pRow[x * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	//Software texels are stored in 4x4 blocks, block after block in rows, texels row by row inside a block.
+	//A bilinear footprint or a 2x2 quad mostly stays inside one block, an RGBA8 block is exactly one cache line.
+	constexpr int TexelBlockSize{ 4 };
+
+	inline size_t GetTiledIndex(int x, int y, int width)
+	{
+		const size_t blocksPerRow{ static_cast<size_t>(width + TexelBlockSize - 1) / TexelBlockSize };
+		const size_t block{ (y / TexelBlockSize) * blocksPerRow + x / TexelBlockSize };
+		return block * TexelBlockSize * TexelBlockSize + (y % TexelBlockSize) * TexelBlockSize + x % TexelBlockSize;
+	}
+
+	//One level of a mip chain stored in a single texel allocation
+	struct MipLevel
+	{
+		int width{};
+		int height{};
+		size_t offset{}; //bytes from the start of the allocation
+	};
+
+	//Fills outLevels with the sizes down to 1x1 and returns the bytes they need, every level starts on a cache line.
+	//Levels are padded to whole 4x4 blocks, blockSize is the bytes of one block (16 texels, or one compressed block).
+	size_t LayoutMipChain(int width, int height, size_t blockSize, std::vector<MipLevel>& outLevels);
+
+	//2x2 box filter of linear RGBA8 texels into the next level, rows are filtered in parallel
+	void CreateNextMipLevel(const uint8_t* pSource, int sourceWidth, int sourceHeight, uint8_t* pDestination, int width, int height);
+
+	//Cache line aligned, so SSE loads of 16 byte texels are always aligned
+	uint8_t* AllocateTexels(size_t size);
+	void FreeTexels(uint8_t* pTexels);
+}
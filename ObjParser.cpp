@@ -0,0 +1,404 @@
+#include "pch.h"
+#include "ObjParser.h"
+#include "MeshTangents.h"
+#include "MappedFile.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <xmmintrin.h>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		//big enough that a chunk's bookkeeping doesn't matter, small enough to keep every core busy
+		constexpr size_t MinChunkSize{ 256 * 1024 };
+		//the weld splits the corners by the top bits of their hash, every shard is welded on its own
+		constexpr int WeldShardBits{ 6 };
+		constexpr size_t WeldShardCount{ size_t{ 1 } << WeldShardBits };
+		//corners per block when the corners are sorted into shards and the vertices are numbered
+		constexpr size_t WeldBlockSize{ 64 * 1024 };
+
+		//one corner of a face as written in the file, 1 based, 0 when left out
+		struct Corner
+		{
+			uint32_t position;
+			uint32_t uv;
+			uint32_t normal;
+		};
+
+		//what one chunk of lines holds, its faces still refer to the whole file's arrays
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+			std::vector<Vector3> positions{};
+			std::vector<Vector2> uvs{};
+			std::vector<Vector3> normals{};
+			std::vector<Corner> corners{}; //3 per face
+			bool isValid{ true };
+		};
+
+		//what a corner resolves to, corners with the same attributes become one vertex
+		struct WeldKey
+		{
+			Vector3 position;
+			Vector2 uv;
+			Vector3 normal;
+
+			bool operator==(const WeldKey& other) const
+			{
+				return memcmp(this, &other, sizeof(WeldKey)) == 0;
+			}
+		};
+
+		//FNV-1a over the bits, -0 and 0 count as different and stay apart
+		uint64_t HashWeldKey(const WeldKey& key)
+		{
+			uint64_t hash{ 14695981039346656037ull };
+			for (const uint32_t word : std::bit_cast<std::array<uint32_t, sizeof(WeldKey) / 4>>(key))
+				hash = (hash ^ word) * 1099511628211ull;
+			return hash ^ (hash >> 32);
+		}
+
+		bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		bool IsDigit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		void SkipSpaces(const char*& p, const char* pEnd)
+		{
+			while (p < pEnd && IsSpace(*p))
+				++p;
+		}
+
+		void SkipLine(const char*& p, const char* pEnd)
+		{
+			const void* pNewline{ memchr(p, '\n', pEnd - p) };
+			p = pNewline ? static_cast<const char*>(pNewline) + 1 : pEnd;
+		}
+
+		/**
+		 * \brief Decimal float, rounded exactly like strtof (and so operator>>) would.
+		 * Plain decimals of up to 53 bits of digits are one correctly rounded double division. Going on to float only rounds
+		 * differently when the double lands right between two floats, those and anything with an exponent go through std::from_chars.
+		 */
+		bool ScanFloat(const char*& p, const char* pEnd, float& outValue)
+		{
+			SkipSpaces(p, pEnd);
+			//from_chars doesn't take a leading plus, operator>> does
+			if (p < pEnd && *p == '+')
+				++p;
+
+			const char* pStart{ p };
+			const bool isNegative{ p < pEnd && *p == '-' };
+			if (isNegative)
+				++p;
+
+			constexpr double powersOfTen[]{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			uint64_t mantissa{};
+			int digitCount{};
+			int fractionDigits{};
+			for (; p < pEnd && IsDigit(*p) && digitCount < 19; ++p, ++digitCount)
+				mantissa = mantissa * 10 + (*p - '0');
+			if (p < pEnd && *p == '.')
+			{
+				for (++p; p < pEnd && IsDigit(*p) && digitCount < 19; ++p, ++digitCount, ++fractionDigits)
+					mantissa = mantissa * 10 + (*p - '0');
+			}
+
+			const bool isDelimited{ p == pEnd || IsSpace(*p) || *p == '\n' };
+			if (digitCount > 0 && isDelimited && mantissa <= (1ull << 53) && fractionDigits <= 22)
+			{
+				const double value{ static_cast<double>(mantissa) / powersOfTen[fractionDigits] };
+				//the 29 bits a float drops, exactly half means a tie that may not be one
+				constexpr uint64_t droppedBits{ (1ull << 29) - 1 };
+				if ((std::bit_cast<uint64_t>(value) & droppedBits) != (1ull << 28))
+				{
+					outValue = static_cast<float>(isNegative ? -value : value);
+					return true;
+				}
+			}
+
+			const std::from_chars_result result{ std::from_chars(pStart, pEnd, outValue) };
+			p = result.ptr;
+			return result.ec == std::errc{};
+		}
+
+		bool ScanIndex(const char*& p, const char* pEnd, uint32_t& outIndex)
+		{
+			if (p == pEnd || !IsDigit(*p))
+				return false;
+
+			uint64_t index{};
+			for (; p < pEnd && IsDigit(*p); ++p)
+			{
+				index = index * 10 + (*p - '0');
+				if (index > UINT32_MAX)
+					return false;
+			}
+			outIndex = static_cast<uint32_t>(index);
+			return true;
+		}
+
+		//p, p/t, p//n or p/t/n
+		bool ScanCorner(const char*& p, const char* pEnd, Corner& outCorner)
+		{
+			SkipSpaces(p, pEnd);
+			outCorner = {};
+			if (!ScanIndex(p, pEnd, outCorner.position))
+				return false;
+			if (p == pEnd || *p != '/')
+				return true;
+
+			++p;
+			if (p < pEnd && *p != '/' && !ScanIndex(p, pEnd, outCorner.uv))
+				return false;
+			if (p == pEnd || *p != '/')
+				return true;
+
+			++p;
+			return ScanIndex(p, pEnd, outCorner.normal);
+		}
+
+		void ParseChunk(Chunk& chunk)
+		{
+			const char* p{ chunk.pBegin };
+			const char* pEnd{ chunk.pEnd };
+			while (p < pEnd && chunk.isValid)
+			{
+				SkipSpaces(p, pEnd);
+				const char* pCommand{ p };
+				while (p < pEnd && !IsSpace(*p) && *p != '\n')
+					++p;
+				const size_t commandLength{ static_cast<size_t>(p - pCommand) };
+
+				if (commandLength == 1 && pCommand[0] == 'v')
+				{
+					Vector3& position{ chunk.positions.emplace_back() };
+					chunk.isValid = ScanFloat(p, pEnd, position.x) && ScanFloat(p, pEnd, position.y) && ScanFloat(p, pEnd, position.z);
+				}
+				else if (commandLength == 2 && pCommand[0] == 'v' && pCommand[1] == 't')
+				{
+					float u{}, v{};
+					chunk.isValid = ScanFloat(p, pEnd, u) && ScanFloat(p, pEnd, v);
+					chunk.uvs.emplace_back(u, 1 - v);
+				}
+				else if (commandLength == 2 && pCommand[0] == 'v' && pCommand[1] == 'n')
+				{
+					Vector3& normal{ chunk.normals.emplace_back() };
+					chunk.isValid = ScanFloat(p, pEnd, normal.x) && ScanFloat(p, pEnd, normal.y) && ScanFloat(p, pEnd, normal.z);
+				}
+				else if (commandLength == 1 && pCommand[0] == 'f')
+				{
+					//triangles only, corners past the third are ignored
+					for (int i{}; i < 3 && chunk.isValid; ++i)
+						chunk.isValid = ScanCorner(p, pEnd, chunk.corners.emplace_back());
+				}
+
+				//the rest of the line, comments and unknown commands included
+				SkipLine(p, pEnd);
+			}
+		}
+
+		//splits at line starts, so no line is shared by two chunks
+		std::vector<Chunk> SplitIntoChunks(const char* pData, size_t size)
+		{
+			const size_t maxChunkCount{ std::max<size_t>(std::thread::hardware_concurrency(), 1) * 8 };
+			const size_t chunkCount{ std::clamp<size_t>(size / MinChunkSize, 1, maxChunkCount) };
+			const char* pEnd{ pData + size };
+
+			std::vector<Chunk> chunks(chunkCount);
+			const char* pBegin{ pData };
+			for (size_t i{}; i < chunkCount; ++i)
+			{
+				const char* pSplit{ i + 1 == chunkCount ? pEnd : std::max(pBegin, pData + size / chunkCount * (i + 1)) };
+				if (pSplit < pEnd)
+					SkipLine(pSplit, pEnd);
+				chunks[i].pBegin = pBegin;
+				chunks[i].pEnd = pSplit;
+				pBegin = pSplit;
+			}
+			return chunks;
+		}
+	}
+
+	bool ParseOBJFile(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding)
+	{
+		vertices.clear();
+		indices.clear();
+
+		MappedFile file{};
+		if (!file.Open(filename))
+		{
+			//an empty file can't be mapped, it's still a valid OBJ without anything in it
+			std::error_code error{};
+			return std::filesystem::is_regular_file(filename, error) && std::filesystem::file_size(filename, error) == 0 && !error;
+		}
+
+		//1. scan every chunk on its own
+		std::vector<Chunk> chunks{ SplitIntoChunks(reinterpret_cast<const char*>(file.GetData()), file.GetSize()) };
+		concurrency::parallel_for(size_t{}, chunks.size(), [&](size_t i) { ParseChunk(chunks[i]); });
+
+		//2. concatenate the attributes in file order. Face indices are absolute, so they don't change.
+		std::vector<Vector3> positions{};
+		std::vector<Vector2> UVs{};
+		std::vector<Vector3> normals{};
+		std::vector<size_t> firstCorners(chunks.size() + 1);
+		for (size_t i{}; i < chunks.size(); ++i)
+		{
+			if (!chunks[i].isValid)
+			{
+				std::cout << "ObjParser: malformed line in " << filename << '\n';
+				return false;
+			}
+			positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+			UVs.insert(UVs.end(), chunks[i].uvs.begin(), chunks[i].uvs.end());
+			normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+			firstCorners[i + 1] = firstCorners[i] + chunks[i].corners.size();
+		}
+
+		//3. resolve every corner, chunks fill their own range
+		std::vector<WeldKey> keys(firstCorners.back());
+		std::atomic<bool> hasBadIndex{ false };
+		concurrency::parallel_for(size_t{}, chunks.size(), [&](size_t i) {
+			const std::vector<Corner>& corners{ chunks[i].corners };
+			for (size_t j{}; j < corners.size(); ++j)
+			{
+				const Corner& corner{ corners[j] };
+				if (corner.position == 0 || corner.position > positions.size() || corner.uv > UVs.size() || corner.normal > normals.size())
+				{
+					hasBadIndex = true;
+					return;
+				}
+
+				//a corner without uv or normal keeps the previous corner's of the same face
+				const size_t index{ firstCorners[i] + j };
+				WeldKey& key{ keys[index] };
+				key = index % 3 != 0 ? keys[index - 1] : WeldKey{};
+				key.position = positions[corner.position - 1];
+				if (corner.uv)
+					key.uv = UVs[corner.uv - 1];
+				if (corner.normal)
+					key.normal = normals[corner.normal - 1];
+			}
+		});
+		if (hasBadIndex)
+		{
+			std::cout << "ObjParser: face index out of range in " << filename << '\n';
+			return false;
+		}
+
+		//4. weld corners with identical attributes, vertices keep the order they're first used in.
+		//Equal keys have equal hashes, so every shard finds the first corner of its keys without looking at the others.
+		//Nothing depends on the threads: the shards keep file order and the vertices are numbered in file order afterwards.
+		const size_t cornerCount{ keys.size() };
+		std::vector<uint64_t> hashes(cornerCount);
+		concurrency::parallel_for(size_t{}, cornerCount, [&](size_t i) { hashes[i] = HashWeldKey(keys[i]); });
+
+		//4a. sort the corners into shards, a counting sort per block of corners keeps them in file order
+		const size_t blockCount{ (cornerCount + WeldBlockSize - 1) / WeldBlockSize };
+		std::vector<uint32_t> shardCursors(blockCount * WeldShardCount, 0);
+		concurrency::parallel_for(size_t{}, blockCount, [&](size_t block) {
+			for (size_t i{ block * WeldBlockSize }; i < std::min(cornerCount, (block + 1) * WeldBlockSize); ++i)
+				++shardCursors[block * WeldShardCount + (hashes[i] >> (64 - WeldShardBits))];
+		});
+		std::vector<size_t> firstShardCorners(WeldShardCount + 1, 0);
+		for (size_t shard{}; shard < WeldShardCount; ++shard)
+		{
+			size_t cursor{ firstShardCorners[shard] };
+			for (size_t block{}; block < blockCount; ++block)
+			{
+				const uint32_t count{ shardCursors[block * WeldShardCount + shard] };
+				shardCursors[block * WeldShardCount + shard] = static_cast<uint32_t>(cursor);
+				cursor += count;
+			}
+			firstShardCorners[shard + 1] = cursor;
+		}
+		std::vector<uint32_t> shardCorners(cornerCount);
+		concurrency::parallel_for(size_t{}, blockCount, [&](size_t block) {
+			for (size_t i{ block * WeldBlockSize }; i < std::min(cornerCount, (block + 1) * WeldBlockSize); ++i)
+				shardCorners[shardCursors[block * WeldShardCount + (hashes[i] >> (64 - WeldShardBits))]++] = static_cast<uint32_t>(i);
+		});
+
+		//4b. every corner finds the first corner with its key, open addressing at most half full, a slot holds a corner
+		constexpr uint32_t EmptySlot{ UINT32_MAX };
+		std::vector<uint32_t> firstUses(cornerCount);
+		concurrency::parallel_for(size_t{}, WeldShardCount, [&](size_t shard) {
+			const uint32_t* pCorners{ shardCorners.data() + firstShardCorners[shard] };
+			const size_t shardSize{ firstShardCorners[shard + 1] - firstShardCorners[shard] };
+			std::vector<uint32_t> slots(std::bit_ceil(std::max(shardSize * 2, size_t{ 16 })), EmptySlot);
+			const size_t slotMask{ slots.size() - 1 };
+			constexpr size_t PrefetchDistance{ 16 };
+			for (size_t i{}; i < shardSize; ++i)
+			{
+				//the table is far bigger than the cache, start fetching the slot of a corner a few corners ahead
+				if (i + PrefetchDistance < shardSize)
+					_mm_prefetch(reinterpret_cast<const char*>(&slots[hashes[pCorners[i + PrefetchDistance]] & slotMask]), _MM_HINT_T0);
+
+				const uint32_t corner{ pCorners[i] };
+				size_t slot{ hashes[corner] & slotMask };
+				while (slots[slot] != EmptySlot && !(keys[slots[slot]] == keys[corner]))
+					slot = (slot + 1) & slotMask;
+				if (slots[slot] == EmptySlot)
+					slots[slot] = corner;
+				firstUses[corner] = slots[slot];
+			}
+		});
+
+		//4c. a corner that is its own first use starts a vertex, they're counted per block and numbered in file order
+		std::vector<uint32_t> firstBlockVertices(blockCount + 1, 0);
+		concurrency::parallel_for(size_t{}, blockCount, [&](size_t block) {
+			for (size_t i{ block * WeldBlockSize }; i < std::min(cornerCount, (block + 1) * WeldBlockSize); ++i)
+				firstBlockVertices[block + 1] += firstUses[i] == i ? 1 : 0;
+		});
+		for (size_t block{}; block < blockCount; ++block)
+			firstBlockVertices[block + 1] += firstBlockVertices[block];
+
+		std::vector<uint32_t> cornerVertices(cornerCount);
+		vertices.resize(firstBlockVertices.back());
+		concurrency::parallel_for(size_t{}, blockCount, [&](size_t block) {
+			uint32_t vertex{ firstBlockVertices[block] };
+			for (size_t i{ block * WeldBlockSize }; i < std::min(cornerCount, (block + 1) * WeldBlockSize); ++i)
+			{
+				if (firstUses[i] != i)
+					continue;
+				cornerVertices[i] = vertex;
+				Vertex& v{ vertices[vertex++] };
+				v.position = keys[i].position;
+				v.uv = keys[i].uv;
+				v.normal = keys[i].normal;
+				if (flipAxisAndWinding)
+				{
+					v.position.z *= -1.f;
+					v.normal.z *= -1.f;
+				}
+			}
+		});
+
+		//4d. every corner takes the vertex of its key's first use
+		indices.resize(cornerCount);
+		concurrency::parallel_for(size_t{}, cornerCount, [&](size_t i) {
+			//0, 2, 1 when flipping
+			const size_t faceCorner{ i % 3 };
+			indices[flipAxisAndWinding && faceCorner != 0 ? i - faceCorner + 3 - faceCorner : i] = cornerVertices[firstUses[i]];
+		});
+
+		//5. tangents of the mesh as it's going to be drawn, after the flip
+		GenerateTangents(vertices, indices);
+
+		return true;
+	}
+}
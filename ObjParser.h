@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	/**
+	 * \brief Reads the triangles of an OBJ file: v, vt, vn and the first three corners of every f line, the rest is skipped.
+	 * The file is mapped and cut into line aligned chunks that are scanned in parallel, then merged in file order.
+	 * Corners with the same position, uv and normal are welded into one vertex, then the tangents are generated
+	 * (see GenerateTangents). The weld splits the corners into shards by hash, every shard is welded on its own thread,
+	 * the result is the same as welding them one after the other.
+	 * \param flipAxisAndWinding mirrors z and reverses the winding, OBJ is right handed
+	 * \return false when the file can't be opened or holds a face that can't be resolved
+	 */
+	bool ParseOBJFile(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true);
+}
@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "PackedVertex.h"
+#include <bit>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr float UnormMax{ 65535.f };
+		constexpr float SnormMax{ 32767.f };
+
+		float SignNotZero(float value)
+		{
+			return value >= 0.f ? 1.f : -1.f;
+		}
+
+		//Projects the direction onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper one
+		void EncodeOctahedral(const Vector3& direction, int16_t outEncoded[2])
+		{
+			const float length{ std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z) };
+			//degenerate tangents end up as +z instead of NaN
+			float x{ 0.f };
+			float y{ 0.f };
+			if (length > 0.f && std::isfinite(length))
+			{
+				x = direction.x / length;
+				y = direction.y / length;
+				if (direction.z < 0.f)
+				{
+					const float foldedX{ (1.f - std::abs(y)) * SignNotZero(x) };
+					const float foldedY{ (1.f - std::abs(x)) * SignNotZero(y) };
+					x = foldedX;
+					y = foldedY;
+				}
+			}
+			outEncoded[0] = static_cast<int16_t>(std::lround(Clamp(x, -1.f, 1.f) * SnormMax));
+			outEncoded[1] = static_cast<int16_t>(std::lround(Clamp(y, -1.f, 1.f) * SnormMax));
+		}
+
+		//the same as DecodeOctahedral in PosCol3D.fx, after the input assembler's snorm conversion
+		Vector3 DecodeOctahedral(const int16_t encoded[2])
+		{
+			Vector3 direction{ std::max(encoded[0] / SnormMax, -1.f), std::max(encoded[1] / SnormMax, -1.f), 0.f };
+			direction.z = 1.f - std::abs(direction.x) - std::abs(direction.y);
+			const float fold{ std::max(-direction.z, 0.f) };
+			direction.x += direction.x >= 0.f ? -fold : fold;
+			direction.y += direction.y >= 0.f ? -fold : fold;
+			return direction.Normalized();
+		}
+
+		uint16_t QuantizeUnorm(float value, float offset, float scale)
+		{
+			const float normalized{ scale > 0.f ? (value - offset) / scale : 0.f };
+			return static_cast<uint16_t>(std::lround(Clamp(normalized, 0.f, UnormMax)));
+		}
+	}
+
+	PositionQuantization PositionQuantization::FromBounds(const Vector3& boundsMin, const Vector3& boundsMax)
+	{
+		return { boundsMin, (boundsMax - boundsMin) / UnormMax };
+	}
+
+	PackedVertex PackVertex(const Vertex& vertex, const PositionQuantization& quantization)
+	{
+		PackedVertex packed{};
+		packed.position[0] = QuantizeUnorm(vertex.position.x, quantization.offset.x, quantization.scale.x);
+		packed.position[1] = QuantizeUnorm(vertex.position.y, quantization.offset.y, quantization.scale.y);
+		packed.position[2] = QuantizeUnorm(vertex.position.z, quantization.offset.z, quantization.scale.z);
+		packed.position[3] = vertex.handedness < 0.f ? 0 : UINT16_MAX;
+		packed.uv[0] = FloatToHalf(vertex.uv.x);
+		packed.uv[1] = FloatToHalf(vertex.uv.y);
+		EncodeOctahedral(vertex.normal, packed.normal);
+		EncodeOctahedral(vertex.tangent, packed.tangent);
+		return packed;
+	}
+
+	Vertex UnpackVertex(const PackedVertex& vertex, const PositionQuantization& quantization)
+	{
+		Vertex unpacked{};
+		unpacked.position = {
+			quantization.offset.x + vertex.position[0] * quantization.scale.x,
+			quantization.offset.y + vertex.position[1] * quantization.scale.y,
+			quantization.offset.z + vertex.position[2] * quantization.scale.z };
+		unpacked.uv = { HalfToFloat(vertex.uv[0]), HalfToFloat(vertex.uv[1]) };
+		unpacked.normal = DecodeOctahedral(vertex.normal);
+		unpacked.tangent = DecodeOctahedral(vertex.tangent);
+		unpacked.handedness = vertex.position[3] == 0 ? -1.f : 1.f;
+		return unpacked;
+	}
+
+	uint16_t FloatToHalf(float value)
+	{
+		const uint32_t bits{ std::bit_cast<uint32_t>(value) };
+		const uint16_t sign{ static_cast<uint16_t>((bits >> 16) & 0x8000) };
+		uint32_t magnitude{ bits & 0x7FFFFFFF };
+
+		//infinity and NaN, NaN stays quiet
+		if (magnitude >= 0x7F800000)
+			return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 : 0);
+		//65520 and up round to infinity
+		if (magnitude >= 0x477FF000)
+			return sign | 0x7C00;
+		//below 2^-14 the half is subnormal, its step is 2^-24
+		if (magnitude < 0x38800000)
+			return sign | static_cast<uint16_t>(std::nearbyint(std::bit_cast<float>(magnitude) * 16777216.f));
+
+		//rebias the exponent from 127 to 15 and round the mantissa from 23 to 10 bits, ties to even
+		magnitude -= 0x38000000;
+		return sign | static_cast<uint16_t>((magnitude + 0x0FFF + ((magnitude >> 13) & 1)) >> 13);
+	}
+
+	float HalfToFloat(uint16_t value)
+	{
+		const uint32_t sign{ static_cast<uint32_t>(value & 0x8000) << 16 };
+		const uint32_t exponent{ (value >> 10) & 0x1Fu };
+		const uint32_t mantissa{ value & 0x03FFu };
+
+		if (exponent == 0)
+		{
+			const float magnitude{ mantissa / 16777216.f };
+			return sign ? -magnitude : magnitude;
+		}
+		if (exponent == 31)
+			return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+		return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "Datatypes.h"
+
+namespace dae
+{
+	//What both renderers read per vertex, 20 bytes instead of the 72 of a Vertex. Vertex stays the format meshes are built in.
+	//The color isn't stored, it's always white.
+	struct PackedVertex
+	{
+		uint16_t position[4]; //unorm, relative to the mesh bounds (see PositionQuantization), w is the handedness (0 or 1). R16G16B16A16_UNORM
+		uint16_t uv[2]; //half floats, R16G16_FLOAT
+		int16_t normal[2]; //octahedral, R16G16_SNORM
+		int16_t tangent[2]; //octahedral, R16G16_SNORM
+	};
+	static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the input layout");
+
+	//position = offset + unorm * scale, per component
+	struct PositionQuantization
+	{
+		Vector3 offset{};
+		Vector3 scale{};
+
+		static PositionQuantization FromBounds(const Vector3& boundsMin, const Vector3& boundsMax);
+	};
+
+	PackedVertex PackVertex(const Vertex& vertex, const PositionQuantization& quantization);
+	Vertex UnpackVertex(const PackedVertex& vertex, const PositionQuantization& quantization);
+
+	//round to nearest even, out of range values become infinity
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+}
@@ -1,8 +1,9 @@
 #include "pch.h"
 #include "Renderer.h"
 #include "Material.h"
-#include "Utils.h"
 #include "Effect.h"
+#include "BandedImageWriter.h"
+#include "MeshStripifier.h"
 #include <future>
 #include <ppl.h>
 #include <iterator>
@@ -10,8 +11,10 @@
 
 namespace dae {
 
-	Renderer::Renderer(SDL_Window* pWindow) :
-		m_pWindow(pWindow)
+	Renderer::Renderer(SDL_Window* pWindow, const AssetOptions& assetOptions) :
+		m_pWindow(pWindow),
+		m_IsVirtualTexturing{ assetOptions.isVirtualTexturing },
+		m_IsStreamingMesh{ assetOptions.isStreamingMesh }
 	{
 		//Initialize
 		SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
@@ -23,7 +26,11 @@ namespace dae {
 
 		int size{ m_Width * m_Height };
 		m_pColorBuffer = new ColorRGB[size];
-		m_pDepthBuffer = new float[size];
+		m_pDepthBuffer = new CompressedDepthBuffer{ m_Width, m_Height };
+
+		m_pFrameCapture = new FrameCapture{ m_Width, m_Height };
+		m_pVideoStream = new VideoStream{ m_Width, m_Height };
+		m_pFramePublisher = new SharedFramePublisher{};
 
 		m_TranslationTransform = Matrix::CreateTranslation(0, 0, 50);
 		m_RotationTransform = Matrix::CreateRotationZ(0);
@@ -44,29 +51,70 @@ namespace dae {
 			std::cout << "DirectX is initialized and ready!\n";
 			std::cout << "Extra Features:\n Multithreading for software.\n";
 
-			std::vector<std::string>names{ "Resources/vehicle.obj", "Resources/fireFX.obj" };
-			for (size_t i = 0; i < names.size(); i++)
+			//placeholders so the first frames render right away: a degenerate triangle per mesh and flat maps
+			for (size_t i = 0; i < 2; i++)
 			{
-				std::vector<Vertex>vertices{};
-				std::vector<uint32_t> indices{};
-				Utils::ParseOBJ(names[i], vertices, indices);
-				m_Meshes.push_back(new Mesh{ m_pDevice, vertices, indices });
+				m_Meshes.push_back(new Mesh{ m_pDevice, new MeshGeometry{ std::vector<Vertex>(3), { 0, 1, 2 } } });
 
 				m_Meshes[i]->SetWorldMatrix(m_ScaleTransform * m_RotationTransform * m_TranslationTransform);
 				m_Meshes[i]->SetMatrix(m_Camera.m_WorldViewProjectionMatrix, m_Meshes[0]->m_WorldMatrix, m_Camera.m_Origin);
 			}
 			m_Camera.m_WorldViewProjectionMatrix = m_Meshes[0]->m_WorldMatrix * m_Camera.m_ViewMatrix * m_Camera.GetProjectionMatrix();
 
+			m_pTexture.reset(Texture::CreateSolid({ 0.5f, 0.5f, 0.5f }, 1.f, m_pDevice));
+			m_pTextureGloss.reset(Texture::CreateSolid({}, 1.f, m_pDevice));
+			m_pTextureNormal.reset(Texture::CreateSolid({ 0.5f, 0.5f, 1.f }, 1.f, m_pDevice));
+			m_pTextureSpecular.reset(Texture::CreateSolid({}, 1.f, m_pDevice));
+			m_pCombustionTexture.reset(Texture::CreateSolid({}, 0.f, m_pDevice));
 
-			m_pTexture = Texture::LoadFromFile("Resources/vehicle_diffuse.png", m_pDevice);
-			m_pTextureGloss = Texture::LoadFromFile("Resources/vehicle_gloss.png", m_pDevice);
-			m_pTextureNormal = Texture::LoadFromFile("Resources/vehicle_normal.png", m_pDevice);
-			m_pTextureSpecular = Texture::LoadFromFile("Resources/vehicle_specular.png", m_pDevice);
-			m_pCombustionTexture = Texture::LoadFromFile("Resources/fireFX_diffuse.png", m_pDevice);
-
-			m_Meshes[0]->m_pEffect->SetMaps(m_pTexture, m_pTextureSpecular, m_pTextureNormal, m_pTextureGloss);
-			m_Meshes[1]->m_pEffect->SetMaps(m_pCombustionTexture);
+			m_Meshes[0]->m_pEffect->SetMaps(m_pTexture.get(), m_pTextureSpecular.get(), m_pTextureNormal.get(), m_pTextureGloss.get());
+			m_Meshes[1]->m_pEffect->SetMaps(m_pCombustionTexture.get());
 			m_Meshes[1]->m_pEffect->ChangeEffect("FlatTechnique");
+
+			//everything decodes at the same time on the thread pool, each asset is swapped in by Update as soon as it's ready
+			m_pTextureRegistry = new TextureRegistry{ m_pDevice };
+			m_pAssetLoader = new AssetLoader{ m_pTextureRegistry };
+
+			std::vector<std::string>names{ "Resources/vehicle.obj", "Resources/fireFX.obj" };
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				//a streamed vehicle keeps its geometry mapped, only the hardware upload and the cluster cache read all of it
+				m_pAssetLoader->LoadMesh(names[i], i == 0 && m_IsStreamingMesh, [this, i, path = names[i]](MeshGeometry* pGeometry) {
+					//a failed upload deletes the geometry, so nothing may read it afterwards
+					if (!pGeometry || !m_Meshes[i]->SetGeometry(m_pDevice, pGeometry))
+						return;
+
+					//the vehicle is also cut into clusters for streaming, written to its cluster cache on the pool the first time
+					if (i == 0 && m_IsStreamingMesh)
+					{
+						m_pAssetLoader->Run<StreamedMesh*>(
+							[path, pGeometry] { return StreamedMesh::Create(path, *pGeometry, m_StreamedMeshBudget); },
+							[this](StreamedMesh* pMesh) { m_pStreamedMesh = pMesh; });
+					}
+				});
+			}
+
+			//kept block compressed for both renderers, the normal map only needs x and y
+			LoadVehicleMap("Resources/vehicle_diffuse.png", TexelFormat::BC1, m_pTexture, m_pVirtualTexture);
+			LoadVehicleMap("Resources/vehicle_gloss.png", TexelFormat::BC1, m_pTextureGloss, m_pVirtualTextureGloss);
+			LoadVehicleMap("Resources/vehicle_normal.png", TexelFormat::BC5, m_pTextureNormal, m_pVirtualTextureNormal);
+			LoadVehicleMap("Resources/vehicle_specular.png", TexelFormat::BC1, m_pTextureSpecular, m_pVirtualTextureSpecular);
+			//the software copy is packed from the decoded pngs in its own pass, the compressed maps would lose detail twice
+			if (!m_IsVirtualTexturing)
+			{
+				m_pAssetLoader->Run<MaterialTexture*>(
+					[] { return MaterialTexture::LoadFromFiles("Resources/vehicle_diffuse.png", "Resources/vehicle_gloss.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png"); },
+					[this](MaterialTexture* pMaterial) {
+						m_pMaterialTexture = pMaterial;
+						PrintTextureMemory();
+					});
+			}
+			m_pAssetLoader->LoadTexture("Resources/fireFX_diffuse.png", TexelFormat::BC3, true, [this](const TextureHandle& pLoaded) {
+				if (!pLoaded)
+					return;
+				m_pCombustionTexture = pLoaded;
+				m_Meshes[1]->m_pEffect->SetMaps(m_pCombustionTexture.get());
+			});
 		}
 		else
 		{
@@ -77,18 +125,43 @@ namespace dae {
 	Renderer::~Renderer()
 	{
 		#pragma region clearing normal resources
-		delete m_pTexture;
-		m_pTexture = nullptr;
-		delete m_pTextureGloss;
-		m_pTextureGloss = nullptr;
-		delete m_pTextureNormal;
-		m_pTextureNormal = nullptr;
-		delete m_pTextureSpecular;
-		m_pTextureSpecular = nullptr;
-		delete m_pCombustionTexture;
-		m_pCombustionTexture = nullptr;
-
-		delete[] m_pDepthBuffer;
+		//hands over whatever is still loading, so it gets deleted below like the rest
+		delete m_pAssetLoader;
+		m_pAssetLoader = nullptr;
+
+		//the copies still in flight are frames that were already rendered, then the encoder threads write out every captured frame
+		DeliverFrameResolves(true);
+		delete m_pFrameCapture;
+		m_pFrameCapture = nullptr;
+		delete m_pVideoStream;
+		m_pVideoStream = nullptr;
+		delete[] m_pStreamResolveBuffer;
+		m_pStreamResolveBuffer = nullptr;
+		delete m_pFramePublisher;
+		m_pFramePublisher = nullptr;
+
+		//the last handles, the textures go with them
+		m_pTexture.reset();
+		m_pTextureGloss.reset();
+		m_pTextureNormal.reset();
+		m_pTextureSpecular.reset();
+		m_pCombustionTexture.reset();
+		delete m_pTextureRegistry;
+		m_pTextureRegistry = nullptr;
+		delete m_pMaterialTexture;
+		m_pMaterialTexture = nullptr;
+		delete m_pVirtualTexture;
+		m_pVirtualTexture = nullptr;
+		delete m_pVirtualTextureGloss;
+		m_pVirtualTextureGloss = nullptr;
+		delete m_pVirtualTextureNormal;
+		m_pVirtualTextureNormal = nullptr;
+		delete m_pVirtualTextureSpecular;
+		m_pVirtualTextureSpecular = nullptr;
+		delete m_pStreamedMesh;
+		m_pStreamedMesh = nullptr;
+
+		delete m_pDepthBuffer;
 		delete[] m_pColorBuffer;
 		m_pDepthBuffer = nullptr;
 		m_pColorBuffer = nullptr;
@@ -141,6 +214,13 @@ namespace dae {
 		//m_pDevice = nullptr;
 
 		//works, gives no memory leaks according to VLD
+		for (ID3D11Texture2D*& pStagingBuffer : m_pCaptureStagingBuffers) {
+			if (pStagingBuffer) {
+				pStagingBuffer->Release();
+				pStagingBuffer = nullptr;
+			}
+		}
+
 		m_pDeviceContext->ClearState();
 		m_pDeviceContext->Flush();
 
@@ -163,6 +243,18 @@ namespace dae {
 
 	void Renderer::Update(const Timer* pTimer)
 	{
+		if (m_pAssetLoader)
+			m_pAssetLoader->Update();
+
+		//the last frame's samples were the feedback, read what it missed
+		for (VirtualTexture* pMap : { m_pVirtualTexture, m_pVirtualTextureGloss, m_pVirtualTextureNormal, m_pVirtualTextureSpecular })
+		{
+			if (pMap)
+				pMap->Update();
+		}
+		if (m_pStreamedMesh)
+			m_pStreamedMesh->Update();
+
 		const float screenWidth{ static_cast<float>(m_Width) };
 		const float screenHeight{ static_cast<float>(m_Height) };
 		m_Camera.m_AspectRatio = screenWidth / screenHeight;
@@ -173,7 +265,19 @@ namespace dae {
 			m_SelectedColor = m_UniformColor;
 		}
 
-		if (m_HasRotation) {
+		if (m_pVideoStream->IsOpen()) {
+			//one full turn over the stream, frame by frame rather than by wall clock
+			m_RotationAngle = PI_2 * m_StreamRenderedFrames / m_StreamFrameCount;
+			m_RotationTransform = Matrix::CreateRotationY(m_RotationAngle);
+			for (Mesh* mesh : m_Meshes)
+			{
+				mesh->SetWorldMatrix(m_ScaleTransform * m_RotationTransform * m_TranslationTransform);
+				if (m_IsHardware) {
+					mesh->SetMatrix(m_Camera.m_WorldViewProjectionMatrix, mesh->m_WorldMatrix, m_Camera.m_Origin);
+				}
+			}
+		}
+		else if (m_HasRotation) {
 			m_RotationAngle = pTimer->GetTotal() * (m_RotationSpeed * PI / 180);
 			m_RotationTransform = Matrix::CreateRotationY(m_RotationAngle);
 			for (Mesh* mesh : m_Meshes)
@@ -184,6 +288,21 @@ namespace dae {
 				}
 			}
 		}
+
+		//level of detail from how far off it would look on screen, the same for both backends (m_Fov is tan(fov / 2))
+		const float pixelsPerUnit{ screenHeight / (2.f * m_Camera.m_Fov) };
+		for (Mesh* mesh : m_Meshes)
+			mesh->SelectLod(m_Camera.m_Origin, pixelsPerUnit);
+
+		//meshlets outside the view or facing away are dropped before any of their vertices are touched, by both backends
+		const Matrix viewProjectionMatrix{ m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix };
+		//a streamed vehicle culls its clusters instead, its meshlets are left unread on the software path
+		for (Mesh* mesh : m_Meshes)
+		{
+			if (mesh != m_Meshes[0] || m_IsHardware || !m_IsStreamingMesh)
+				mesh->CullMeshlets(viewProjectionMatrix, m_Camera.m_Origin, m_CullMode);
+		}
+
 		m_Camera.m_WorldViewProjectionMatrix = m_Meshes[0]->m_WorldMatrix * m_Camera.m_ViewMatrix * m_Camera.GetProjectionMatrix();
 	}
 
@@ -204,6 +323,9 @@ namespace dae {
 				m_Meshes[1]->Render(m_pDeviceContext);
 			}
 
+			//the swapchain discards its buffer on present, so copy it out before that
+			OutputRenderedFrame();
+
 			//3. PRESENT BACKBUFFER (SWAP)
 			m_pSwapChain->Present(0, 0);
 
@@ -214,7 +336,7 @@ namespace dae {
 			SDL_LockSurface(m_pBackBuffer);
 
 			const int size{ m_Width * m_Height };
-			std::fill(m_pDepthBuffer, m_pDepthBuffer + size, FLT_MAX);
+			m_pDepthBuffer->Clear();
 			std::fill(m_pColorBuffer, m_pColorBuffer + size, m_SelectedColor);
 
 			SDL_FillRect(m_pBackBuffer, nullptr, m_HasClearColor ? 0x191919 : 0x636363);
@@ -225,19 +347,29 @@ namespace dae {
 			/*for (const Mesh* mesh : m_Meshes)
 			{*/
 				//we only render the first mesh because we don't render the flame in the software version.
-				RenderMeshTriangleList(*m_Meshes[0]);
+				//a streamed vehicle is never drawn from its full geometry, nothing shows until its cluster cache is open
+				if (m_IsStreamingMesh)
+				{
+					if (m_pStreamedMesh)
+						RenderStreamedMesh(*m_pStreamedMesh, m_Meshes[0]->m_WorldMatrix);
+				}
+				else if (m_Meshes[0]->GetTopology() == PrimitiveTopology::TriangleStrip)
+					RenderMeshTriangleStrip(*m_Meshes[0]);
+				else
+					RenderMeshTriangleList(*m_Meshes[0]);
 			//}
 
 			//@END
 			//Update SDL Surface
 			SDL_UnlockSurface(m_pBackBuffer);
+			OutputRenderedFrame();
 			SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 			SDL_UpdateWindowSurface(m_pWindow);
 		}
 	}
 
 	#pragma region software
-	void Renderer::HandleRenderBB(std::vector<Vertex_Out>& verts) const
+	void Renderer::HandleRenderBB(std::vector<Vertex_Out>& verts, const RasterTarget& target) const
 	{
 		ColorRGB finalColor{};
 
@@ -258,92 +390,184 @@ namespace dae {
 		const float minY = std::min(std::min(triangleV0.y, triangleV1.y), std::min(triangleV2.y, triangleV0.y));
 
 		if (
-			((minX >= 0) && (maxX <= (m_Width - 1))) &&
-			((minY >= 0) && (maxY <= (m_Height - 1)))) {
-			//Loop through bounding box pixels and ceil to remove lines between triangles.
-			for (int px{ static_cast<int>(minX) }; px < std::ceil(maxX); ++px)
-			{
-				for (int py{ static_cast<int>(minY) }; py < std::ceil(maxY); ++py)
-				{
-
-					const int currentPixel{ px + (py * m_Width) };
-					if (!(currentPixel > 0 && currentPixel < m_Width * m_Height)) continue;
-					const Vector2 pixel{ static_cast<float>(px) + 0.5f, static_cast<float>(py) + 0.5f };
-
-					//Pixel position to vertices (also the weight)
-					Vector2 pointToSide{ pixel - triangleV1 };
-					const float edgeA{ Vector2::Cross(b, pointToSide) };
-
-					pointToSide = pixel - triangleV2;
-					const float edgeB{ Vector2::Cross(c, pointToSide) };
-
-					pointToSide = pixel - triangleV0;
-					const float edgeC{ Vector2::Cross(a, pointToSide) };
+			((minX >= 0) && (maxX <= (target.width - 1))) &&
+			((minY >= 0) && (maxY <= (target.height - 1)))) {
+			//depth is evaluated from the triangle's plane so the depth buffer can store the plane instead of the floats
+			DepthPlane depthPlane{};
+			const bool hasDepthPlane{ DepthPlane::FromTriangle(verts[0].position, verts[1].position, verts[2].position, static_cast<float>(target.bandBegin), depthPlane) };
+			if (!hasDepthPlane && !m_HasBB)
+				return;
 
-					const float triangleArea{ edgeA + edgeB + edgeC };
-					const float w0{ edgeA / triangleArea };
-					const float w1{ edgeB / triangleArea };
-					const float w2{ edgeC / triangleArea };
+			//no pixel of the triangle is closer than its closest vertex, small margin for the plane's rounding
+			const float triangleMinDepth{ std::min(std::min(verts[0].position.z, verts[1].position.z), verts[2].position.z) * 0.99999f };
 
-					//check if pixel is inside triangle
-					if (w0 > 0.f && w1 > 0.f && w2 > 0.f) {
+			//only the rows of the bounding box that fall inside the target's band, in band local coordinates
+			const int startX{ static_cast<int>(minX) };
+			const int endX{ static_cast<int>(std::ceil(maxX)) };
+			const int startY{ std::max(static_cast<int>(minY), target.bandBegin) - target.bandBegin };
+			const int endY{ std::min(static_cast<int>(std::ceil(maxY)), target.bandEnd) - target.bandBegin };
+			if (startX >= endX || startY >= endY)
+				return;
 
-						switch (m_CullMode)
+			//perspective correct uv anywhere on the triangle's plane, also outside of it for the quad derivatives
+			const auto interpolateUV = [&](const Vector2& pixel) {
+				const float edgeA{ Vector2::Cross(b, pixel - triangleV1) };
+				const float edgeB{ Vector2::Cross(c, pixel - triangleV2) };
+				const float edgeC{ Vector2::Cross(a, pixel - triangleV0) };
+				const float triangleArea{ edgeA + edgeB + edgeC };
+				const float w0{ edgeA / triangleArea };
+				const float w1{ edgeB / triangleArea };
+				const float w2{ edgeC / triangleArea };
+
+				const float interpolatedDepthW{ 1 / ((1 / verts[0].position.w) * w0 + (1 / verts[1].position.w) * w1 + (1 / verts[2].position.w) * w2) };
+				return Vector2{ (((verts[0].uv / verts[0].position.w) * w0) +
+					((verts[1].uv / verts[1].position.w) * w1) +
+					((verts[2].uv / verts[2].position.w) * w2)) * interpolatedDepthW };
+			};
+
+			const int tileSize{ CompressedDepthBuffer::TileSize };
+			for (int tileY{ startY / tileSize }; tileY <= (endY - 1) / tileSize; ++tileY)
+			{
+				for (int tileX{ startX / tileSize }; tileX <= (endX - 1) / tileSize; ++tileX)
+				{
+					//coarse rejection: the whole tile is already closer than anything this triangle can write
+					if (!m_HasBB && triangleMinDepth > target.pDepthBuffer->GetTileMaxDepth(tileX, tileY))
+						continue;
+
+					//walk the tile in 2x2 quads, a quad shares its uv derivatives like on the GPU
+					const int tileEndX{ std::min(endX, (tileX + 1) * tileSize) };
+					const int tileEndY{ std::min(endY, (tileY + 1) * tileSize) };
+					for (int quadX{ std::max(startX, tileX * tileSize) & ~1 }; quadX < tileEndX; quadX += 2)
+					{
+						for (int quadY{ std::max(startY, tileY * tileSize) & ~1 }; quadY < tileEndY; quadY += 2)
 						{
-						case CullMode::Back:
-							if (Vector3::Dot(verts[0].normal, verts[0].viewDirection) < 0)
+							//the quad is shaded as a whole: which of its pixels get shaded first, then one sample for all of them.
+							//lanes: top left, top right, bottom left, bottom right
+							enum class QuadPixel { Unvisited, Outside, Occluded, Shaded };
+							QuadPixel quadPixels[4]{};
+							float pixelWeights[4][3]{};
+							float pixelDepths[4]{};
+							bool hasShadedPixel{ false };
+							bool isCulled{ false };
+
+							//Loop through bounding box pixels and ceil to remove lines between triangles.
+							for (int px{ std::max(startX, quadX) }; px < std::min(tileEndX, quadX + 2) && !isCulled; ++px)
 							{
-								return;
+								for (int py{ std::max(startY, quadY) }; py < std::min(tileEndY, quadY + 2); ++py)
+								{
+									const int lane{ (px - quadX) + (py - quadY) * 2 };
+									const Vector2 pixel{ static_cast<float>(px) + 0.5f, static_cast<float>(py + target.bandBegin) + 0.5f };
+
+									//Pixel position to vertices (also the weight)
+									Vector2 pointToSide{ pixel - triangleV1 };
+									const float edgeA{ Vector2::Cross(b, pointToSide) };
+
+									pointToSide = pixel - triangleV2;
+									const float edgeB{ Vector2::Cross(c, pointToSide) };
+
+									pointToSide = pixel - triangleV0;
+									const float edgeC{ Vector2::Cross(a, pointToSide) };
+
+									const float triangleArea{ edgeA + edgeB + edgeC };
+									const float w0{ edgeA / triangleArea };
+									const float w1{ edgeB / triangleArea };
+									const float w2{ edgeC / triangleArea };
+
+									quadPixels[lane] = QuadPixel::Outside;
+
+									//check if pixel is inside triangle
+									if (w0 > 0.f && w1 > 0.f && w2 > 0.f) {
+
+										switch (m_CullMode)
+										{
+										case CullMode::Back:
+											isCulled = Vector3::Dot(verts[0].normal, verts[0].viewDirection) < 0;
+											break;
+										case CullMode::Front:
+											isCulled = Vector3::Dot(verts[0].normal, verts[0].viewDirection) > 0;
+											break;
+										default:
+											break;
+										}
+										if (isCulled)
+										{
+											quadPixels[lane] = QuadPixel::Unvisited;
+											break;
+										}
+
+										//depth test
+										const float interpolatedDepth{ depthPlane.Evaluate(static_cast<float>(px) + 0.5f, static_cast<float>(py) + 0.5f) };
+										if (!target.pDepthBuffer->TestAndWrite(px, py, depthPlane, interpolatedDepth)) {
+											quadPixels[lane] = QuadPixel::Occluded;
+											continue;
+										}
+
+										quadPixels[lane] = QuadPixel::Shaded;
+										pixelWeights[lane][0] = w0;
+										pixelWeights[lane][1] = w1;
+										pixelWeights[lane][2] = w2;
+										pixelDepths[lane] = interpolatedDepth;
+										hasShadedPixel = true;
+									}
+								}
 							}
-							break;
-						case CullMode::Front:
-							if (Vector3::Dot(verts[0].normal, verts[0].viewDirection) > 0)
+
+							//all 4 pixels are sampled together, the ones off the triangle only help with the derivatives like on the GPU
+							MaterialSample materials[4]{};
+							if (hasShadedPixel && !m_IsShowDepthBuffer)
 							{
-								return;
+								Vector2 uvs[4]{};
+								for (int lane{}; lane < 4; ++lane)
+									uvs[lane] = interpolateUV({ static_cast<float>(quadX + (lane & 1)) + 0.5f, static_cast<float>(quadY + (lane >> 1) + target.bandBegin) + 0.5f });
+								SampleMaterial(uvs, materials);
 							}
-							break;
-						default:
-							break;
-						}
 
-						//depth test
-						const float interpolatedDepth{ 1 / ((1 / verts[0].position.z) * w0 + (1 / verts[1].position.z) * w1 + (1 / verts[2].position.z) * w2) };
-						if (interpolatedDepth > m_pDepthBuffer[currentPixel]) {
-							continue;
-						}
-						m_pDepthBuffer[currentPixel] = interpolatedDepth;
-
-						float gloss{ 0 };
-						ColorRGB specularKS{  };
-						const Vertex_Out pixelVertexPos{ CalculateVertexWithAttributes(verts, w0, w1, w2, gloss, specularKS) };
+							for (int px{ std::max(startX, quadX) }; px < std::min(tileEndX, quadX + 2); ++px)
+							{
+								for (int py{ std::max(startY, quadY) }; py < std::min(tileEndY, quadY + 2); ++py)
+								{
+									const int lane{ (px - quadX) + (py - quadY) * 2 };
+									if (quadPixels[lane] == QuadPixel::Unvisited || quadPixels[lane] == QuadPixel::Occluded)
+										continue;
+
+									const int currentPixel{ px + (py * target.width) };
+									if (quadPixels[lane] == QuadPixel::Shaded) {
+										if (m_IsShowDepthBuffer) {
+											const float linearDepth = (2.0 * m_Camera.nearZ) / (m_Camera.farZ + m_Camera.nearZ - pixelDepths[lane] * (m_Camera.farZ - m_Camera.nearZ));
+											target.pColorBuffer[currentPixel] = ColorRGB{ linearDepth, linearDepth, linearDepth };
+										}
+										else {
+											float gloss{ 0 };
+											ColorRGB specularKS{  };
+											const Vertex_Out pixelVertexPos{ CalculateVertexWithAttributes(verts, pixelWeights[lane][0], pixelWeights[lane][1], pixelWeights[lane][2], materials[lane], gloss, specularKS) };
+											target.pColorBuffer[currentPixel] = PixelShading(pixelVertexPos, gloss, specularKS);
+										}
+									}
+
+									if (m_HasBB) target.pColorBuffer[currentPixel] = colors::White;
+
+									//change color accordingly to triangle
+									finalColor = target.pColorBuffer[currentPixel];
+
+									//Update Color in Buffer
+									finalColor.MaxToOne();
+									target.pPixels[currentPixel] = SDL_MapRGB(target.pFormat,
+										static_cast<uint8_t>(finalColor.r * 255),
+										static_cast<uint8_t>(finalColor.g * 255),
+										static_cast<uint8_t>(finalColor.b * 255));
+								}
+							}
 
-						if (m_IsShowDepthBuffer) {
-							const float linearDepth = (2.0 * m_Camera.nearZ) / (m_Camera.farZ + m_Camera.nearZ - interpolatedDepth * (m_Camera.farZ - m_Camera.nearZ));
-							m_pColorBuffer[currentPixel] = ColorRGB{ linearDepth, linearDepth, linearDepth };
-						}
-						else {
-							m_pColorBuffer[currentPixel] = PixelShading(pixelVertexPos, gloss, specularKS);
+							if (isCulled)
+								return;
 						}
-
 					}
-
-					if (m_HasBB) m_pColorBuffer[currentPixel] = colors::White;
-					
-					//change color accordingly to triangle
-					finalColor = m_pColorBuffer[currentPixel];
-
-					//Update Color in Buffer
-					finalColor.MaxToOne();
-					m_pBackBufferPixels[currentPixel] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
 				}
 			}
 		}
 	}
 
-	Vertex_Out Renderer::CalculateVertexWithAttributes(const std::vector<Vertex_Out>& verts, const float w0, const float w1, const float w2, float& outGloss, ColorRGB& outSpecularKS) const
+	Vertex_Out Renderer::CalculateVertexWithAttributes(const std::vector<Vertex_Out>& verts, const float w0, const float w1, const float w2, const MaterialSample& material, float& outGloss, ColorRGB& outSpecularKS) const
 	{
 		#pragma region calculate interpolated attributes
 		const float interpolatedDepthW{ 1 / (
@@ -378,33 +602,125 @@ namespace dae {
 		#pragma endregion
 
 		//color from diffuse map
-
-		const ColorRGB currentColor{ m_pTexture->Sample(interpolatedUV) };
+		const ColorRGB currentColor{ material.diffuse };
 
 		#pragma region normals
-		const auto [Nr, Ng, Nb] { m_pTextureNormal->Sample(interpolatedUV) };
-		const Vector3 binormal = Vector3::Cross(interpolatedNormal, interpolatedTangent);
+		//a triangle never mixes handednesses, GenerateTangents splits the vertices where they meet
+		const Vector3 binormal = Vector3::Cross(interpolatedNormal, interpolatedTangent) * verts[0].handedness;
 		const Matrix tangentSpaceAxis{ Matrix{ interpolatedTangent,binormal,interpolatedNormal,Vector3::Zero } };
 
-		Vector3 sampledNormal{ Nr,Ng,Nb };
-		sampledNormal = 2.f * sampledNormal - Vector3{ 1.f, 1.f, 1.f };
-		sampledNormal /= 255.f;
-		sampledNormal = tangentSpaceAxis.TransformVector(sampledNormal).Normalized();
+		const Vector3 sampledNormal{ tangentSpaceAxis.TransformVector(material.normal).Normalized() };
 		#pragma endregion
 
 		#pragma region Phong
 		//gloss
-		const auto [Gr, Gg, Gb] { m_pTextureGloss->Sample(interpolatedUV) };
-		outGloss = Gr;
+		outGloss = material.gloss;
 
 		//specular
-		outSpecularKS = m_pTextureSpecular->Sample(interpolatedUV);
+		outSpecularKS = material.specular;
 		#pragma endregion
 
 		return { interpolatedPosition, currentColor, interpolatedUV, m_HasNormalMap ? sampledNormal.Normalized() : interpolatedNormal, interpolatedTangent, viewDirection.Normalized()};
 
 	}
 
+	void Renderer::FinishLoading()
+	{
+		if (m_pAssetLoader)
+			m_pAssetLoader->Flush();
+		for (VirtualTexture* pMap : { m_pVirtualTexture, m_pVirtualTextureGloss, m_pVirtualTextureNormal, m_pVirtualTextureSpecular })
+		{
+			if (pMap)
+				pMap->Flush();
+		}
+		if (m_pStreamedMesh)
+			m_pStreamedMesh->Flush();
+	}
+
+	void Renderer::LoadVehicleMap(const std::string& path, TexelFormat format, TextureHandle& pMap, VirtualTexture*& pVirtualMap)
+	{
+		if (!m_IsVirtualTexturing)
+		{
+			m_pAssetLoader->LoadTexture(path, format, true, [this, &pMap](const TextureHandle& pLoaded) { OnVehicleMapLoaded(pMap, pLoaded); });
+			return;
+		}
+
+		//the cache is there once the virtual map is, so the hardware texture maps it instead of decoding the png a second time
+		m_pAssetLoader->Run<VirtualTexture*>(
+			[path, format] { return VirtualTexture::Create(path, format, m_VirtualTextureBudget); },
+			[this, path, format, &pMap, &pVirtualMap](VirtualTexture* pLoaded) {
+				pVirtualMap = pLoaded;
+				m_pAssetLoader->LoadTexture(path, format, false, [this, &pMap](const TextureHandle& pLoaded) { OnVehicleMapLoaded(pMap, pLoaded); });
+			});
+	}
+
+	void Renderer::OnVehicleMapLoaded(TextureHandle& pMap, const TextureHandle& pLoaded)
+	{
+		//a map that failed to load keeps its placeholder
+		if (pLoaded)
+		{
+			pMap = pLoaded;
+			m_Meshes[0]->m_pEffect->SetMaps(m_pTexture.get(), m_pTextureSpecular.get(), m_pTextureNormal.get(), m_pTextureGloss.get());
+		}
+		if (++m_LoadedVehicleMaps == 4)
+			PrintTextureMemory();
+	}
+
+	void Renderer::PrintTextureMemory() const
+	{
+		//every registered texture counts once, however many meshes share it
+		size_t textureMemory{ m_pTextureRegistry->GetMemorySize() };
+		if (m_pMaterialTexture)
+			textureMemory += m_pMaterialTexture->GetMemorySize();
+		for (const VirtualTexture* pMap : { m_pVirtualTexture, m_pVirtualTextureGloss, m_pVirtualTextureNormal, m_pVirtualTextureSpecular })
+		{
+			if (pMap)
+				textureMemory += pMap->GetMemorySize();
+		}
+		std::cout << "Texture memory: " << textureMemory / 1024 << " KB in " << m_pTextureRegistry->GetTextureCount() << " textures\n";
+	}
+
+	void Renderer::SampleMaterial(const Vector2 (&uvs)[4], MaterialSample (&outMaterials)[4]) const
+	{
+		//all four maps in one pass over the interleaved material texels when they could be packed
+		if (m_IsVirtualTexturing)
+		{
+			//the loaded maps have no software copy, until all four virtual maps are open the vehicle is shaded like the placeholders
+			if (HasVirtualMaps())
+				SampleMaterialMaps(*m_pVirtualTexture, *m_pVirtualTextureGloss, *m_pVirtualTextureNormal, *m_pVirtualTextureSpecular, uvs, outMaterials);
+			else
+				std::fill(std::begin(outMaterials), std::end(outMaterials), MaterialSample{ ColorRGB{ 0.5f, 0.5f, 0.5f }, 0.f, ColorRGB{}, Vector3::UnitZ });
+		}
+		else if (m_pMaterialTexture)
+			m_SoftwareSampler.Sample(*m_pMaterialTexture, uvs, outMaterials);
+		else
+			SampleMaterialMaps(*m_pTexture, *m_pTextureGloss, *m_pTextureNormal, *m_pTextureSpecular, uvs, outMaterials);
+	}
+
+	template<typename Map>
+	void Renderer::SampleMaterialMaps(const Map& diffuse, const Map& gloss, const Map& normalMap, const Map& specular, const Vector2 (&uvs)[4], MaterialSample (&outMaterials)[4]) const
+	{
+		ColorRGB diffuses[4]{};
+		ColorRGB glosses[4]{};
+		ColorRGB normals[4]{};
+		ColorRGB speculars[4]{};
+		m_SoftwareSampler.Sample(diffuse, uvs, diffuses);
+		m_SoftwareSampler.Sample(gloss, uvs, glosses);
+		m_SoftwareSampler.Sample(normalMap, uvs, normals);
+		m_SoftwareSampler.Sample(specular, uvs, speculars);
+
+		for (int i{}; i < 4; ++i)
+		{
+			const auto [Nr, Ng, Nb] { normals[i] };
+			Vector3 normal{ 2.f * Vector3{ Nr, Ng, Nb } - Vector3{ 1.f, 1.f, 1.f } };
+			//BC5 keeps x and y, z is positive in tangent space
+			if (normalMap.GetFormat() == TexelFormat::BC5)
+				normal.z = std::sqrt(std::max(1.f - normal.x * normal.x - normal.y * normal.y, 0.f));
+
+			outMaterials[i] = { diffuses[i], glosses[i].r, speculars[i], normal.Normalized() };
+		}
+	}
+
 	ColorRGB Renderer::PixelShading(const Vertex_Out& v, const float gloss, const ColorRGB specularKS) const
 	{
 		float ObservedArea{ Vector3::Dot(v.normal, -m_LightDirection) };
@@ -447,65 +763,434 @@ namespace dae {
 
 	void Renderer::RenderMeshTriangleList(const Mesh& mesh) const
 	{
+		const RasterTarget target{ m_Width, m_Height, 0, m_Height, m_pDepthBuffer, m_pColorBuffer, m_pBackBufferPixels, m_pBackBuffer->format };
+		const Matrix viewProjectionMatrix{ m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix };
+
+		if (mesh.IsDrawingMeshlets())
+		{
+			RenderMeshlets(mesh, target, viewProjectionMatrix);
+			return;
+		}
+
+		//every vertex once, the triangles sharing it look it up by index
+		std::vector<Vertex_Out> transformedVertices{};
+		VertexTransformationFunction(mesh.vertices, mesh.quantization, transformedVertices, mesh.m_WorldMatrix, viewProjectionMatrix, target.width, target.height);
+
 		//we divide the amount by 3 because we are going to get 3 vertexes of a triangle per loop
-		concurrency::parallel_for(0u, uint32_t((mesh.indices.size()-2) / 3), [&, this](int i) {
+		concurrency::parallel_for(0u, uint32_t(mesh.indices.size() / 3), [&, this](int i) {
 
 			int index = i * 3;
 			//for every 3rd indice, calculate the triangle
-			#pragma region Calculate the triangles from a mesh
-			const int indice1{ static_cast<int>(mesh.indices[index]) };
-			const int indice2{ static_cast<int>(mesh.indices[index + 1]) };
-			const int indice3{ static_cast<int>(mesh.indices[index + 2]) };
-			std::vector triangleVerts{ mesh.vertices[indice1], mesh.vertices[indice2], mesh.vertices[indice3] };
-			#pragma endregion
+			std::vector<Vertex_Out> verts{
+				transformedVertices[mesh.indices[index]],
+				transformedVertices[mesh.indices[index + 1]],
+				transformedVertices[mesh.indices[index + 2]] };
 
-			std::vector<Vertex_Out> verts{ };
+			HandleRenderBB(verts, target);
+		});
+	}
 
-			VertexTransformationFunction(triangleVerts, verts, mesh.m_WorldMatrix);
+	void Renderer::RenderMeshTriangleStrip(const Mesh& mesh) const
+	{
+		const RasterTarget target{ m_Width, m_Height, 0, m_Height, m_pDepthBuffer, m_pColorBuffer, m_pBackBufferPixels, m_pBackBuffer->format };
+		const Matrix worldViewProjectionMatrix{ mesh.m_WorldMatrix * m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix };
+		const std::span<const uint32_t> stripIndices{ mesh.stripIndices };
 
-			HandleRenderBB(verts);
+		//1. where every strip starts, the strips are independent of each other
+		std::vector<size_t> stripStarts{ 0 };
+		for (size_t i{}; i < stripIndices.size(); ++i)
+		{
+			if (stripIndices[i] == StripRestartIndex)
+				stripStarts.push_back(i + 1);
+		}
+
+		//2. one new vertex per triangle, the winding flips every other triangle so each keeps the facing it had in the list
+		concurrency::parallel_for(size_t{ 0 }, stripStarts.size(), [&, this](size_t i) {
+			Vertex_Out window[2]{};
+			size_t stripLength{};
+			for (size_t j{ stripStarts[i] }; j < stripIndices.size() && stripIndices[j] != StripRestartIndex; ++j, ++stripLength)
+			{
+				const Vertex_Out vertex{ TransformVertex(UnpackVertex(mesh.vertices[stripIndices[j]], mesh.quantization),
+					mesh.m_WorldMatrix, worldViewProjectionMatrix, target.width, target.height) };
+				if (stripLength >= 2)
+				{
+					const bool isOdd{ stripLength % 2 == 1 };
+					std::vector<Vertex_Out> verts{ window[isOdd ? 1 : 0], window[isOdd ? 0 : 1], vertex };
+					HandleRenderBB(verts, target);
+				}
+				window[0] = window[1];
+				window[1] = vertex;
+			}
 		});
 	}
 
-	void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex_Out>& vertices_out, const Matrix& worldMatrix) const
+	void Renderer::RenderMeshlets(const Mesh& mesh, const RasterTarget& target, const Matrix& viewProjectionMatrix) const
+	{
+		const Matrix worldViewProjectionMatrix{ mesh.m_WorldMatrix * viewProjectionMatrix };
+		const std::span<const uint32_t> visibleMeshlets{ mesh.GetVisibleMeshlets() };
+		const std::span<const Meshlet> meshlets{ mesh.GetGeometry()->GetMeshlets() };
+		const std::span<const uint32_t> meshletVertices{ mesh.GetGeometry()->GetMeshletVertices() };
+		const std::span<const uint8_t> meshletTriangles{ mesh.GetGeometry()->GetMeshletTriangles() };
+
+		//only what survived CullMeshlets, every meshlet transforms its own vertices and draws its triangles on one thread
+		concurrency::parallel_for(size_t{ 0 }, visibleMeshlets.size(), [&, this](size_t i) {
+			const Meshlet& meshlet{ meshlets[visibleMeshlets[i]] };
+
+			std::vector<Vertex_Out> transformedVertices(meshlet.vertexCount);
+			for (uint32_t j{}; j < meshlet.vertexCount; ++j)
+			{
+				const PackedVertex& vertex{ mesh.vertices[meshletVertices[meshlet.vertexOffset + j]] };
+				transformedVertices[j] = TransformVertex(UnpackVertex(vertex, mesh.quantization), mesh.m_WorldMatrix, worldViewProjectionMatrix, target.width, target.height);
+			}
+
+			const uint8_t* pTriangles{ &meshletTriangles[meshlet.triangleOffset * 3] };
+			for (uint32_t j{}; j < meshlet.triangleCount * 3; j += 3)
+			{
+				std::vector<Vertex_Out> verts{
+					transformedVertices[pTriangles[j]],
+					transformedVertices[pTriangles[j + 1]],
+					transformedVertices[pTriangles[j + 2]] };
+
+				HandleRenderBB(verts, target);
+			}
+		});
+	}
+
+	void Renderer::RenderStreamedMesh(const StreamedMesh& mesh, const Matrix& worldMatrix) const
+	{
+		const RasterTarget target{ m_Width, m_Height, 0, m_Height, m_pDepthBuffer, m_pColorBuffer, m_pBackBufferPixels, m_pBackBuffer->format };
+		const Matrix worldViewProjectionMatrix{ worldMatrix * m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix };
+
+		//asks for every cluster in the frustum, only draws the ones that are already there
+		std::vector<uint32_t> clusters{};
+		mesh.CullClusters(worldViewProjectionMatrix, clusters);
+
+		//a cluster is small enough to transform and draw on one thread, its vertices never leave it
+		concurrency::parallel_for(size_t{ 0 }, clusters.size(), [&, this](size_t i) {
+			const std::span<const PackedVertex> vertices{ mesh.GetVertices(clusters[i]) };
+			const std::span<const uint8_t> indices{ mesh.GetIndices(clusters[i]) };
+
+			std::vector<Vertex_Out> transformedVertices(vertices.size());
+			for (size_t j{}; j < vertices.size(); ++j)
+				transformedVertices[j] = TransformVertex(UnpackVertex(vertices[j], mesh.GetQuantization()), worldMatrix, worldViewProjectionMatrix, target.width, target.height);
+
+			for (size_t j{}; j + 2 < indices.size(); j += 3)
+			{
+				std::vector<Vertex_Out> verts{
+					transformedVertices[indices[j]],
+					transformedVertices[indices[j + 1]],
+					transformedVertices[indices[j + 2]] };
+
+				HandleRenderBB(verts, target);
+			}
+		});
+	}
+
+	void Renderer::VertexTransformationFunction(std::span<const PackedVertex> vertices_in, const PositionQuantization& quantization, std::vector<Vertex_Out>& vertices_out, const Matrix& worldMatrix, const Matrix& viewProjectionMatrix, int width, int height) const
 	{
 		vertices_out.resize(vertices_in.size());
 
 		//Add viewmatrix with camera space matrix
-		const Matrix worldViewProjectionMatrix{ worldMatrix * m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix };
+		const Matrix worldViewProjectionMatrix{ worldMatrix * viewProjectionMatrix };
 
-		for (int i{}; i < vertices_in.size(); i++)
-		{
-			Vector4 point{ vertices_in[i].position, 1 };
+		concurrency::parallel_for(size_t{ 0 }, vertices_in.size(), [&](size_t i) {
+			//unpacked right here, the full Vertex only ever lives on the stack
+			vertices_out[i] = TransformVertex(UnpackVertex(vertices_in[i], quantization), worldMatrix, worldViewProjectionMatrix, width, height);
+		});
+	}
+
+	Vertex_Out Renderer::TransformVertex(const Vertex& vertex, const Matrix& worldMatrix, const Matrix& worldViewProjectionMatrix, int width, int height) const
+	{
+		Vector4 point{ vertex.position, 1 };
+
+		//Transform points to correct space
+		Vector4 transformedVert{ worldViewProjectionMatrix.TransformPoint(point) };
+
+		//Project point to 2d view plane (perspective divide)
+		const float projectedVertexW{ transformedVert.w };
+		float projectedVertexX{ transformedVert.x / transformedVert.w };
+		float projectedVertexY{ transformedVert.y / transformedVert.w };
+		float projectedVertexZ{ transformedVert.z / transformedVert.w };
+		projectedVertexX = ((projectedVertexX + 1) / 2) * width;
+		projectedVertexY = ((1 - projectedVertexY) / 2) * height;
 
-			//Transform points to correct space
-			Vector4 transformedVert{ worldViewProjectionMatrix.TransformPoint(point) };
+		//transform normals to correct space and solve visibility problem
+		const Vector3 normal{ worldMatrix.TransformVector(vertex.normal) };
+		const Vector3 tangent{ worldMatrix.TransformVector(vertex.tangent) };
 
-			//Project point to 2d view plane (perspective divide)
-			const float projectedVertexW{ transformedVert.w };
-			float projectedVertexX{ transformedVert.x / transformedVert.w };
-			float projectedVertexY{ transformedVert.y / transformedVert.w };
-			float projectedVertexZ{ transformedVert.z / transformedVert.w };
-			projectedVertexX = ((projectedVertexX + 1) / 2) * m_Width;
-			projectedVertexY = ((1 - projectedVertexY) / 2) * m_Height;
+		Vector4 pos{ projectedVertexX, projectedVertexY , projectedVertexZ, projectedVertexW };
+		const Vector3 viewDirection{ m_Camera.m_Origin - transformedVert };
 
-			//transform normals to correct space and solve visibility problem
-			const Vector3 normal{ worldMatrix.TransformVector(vertices_in[i].normal) };
-			const Vector3 tangent{ worldMatrix.TransformVector(vertices_in[i].tangent) };
+		return { pos, vertex.color, vertex.uv, normal, tangent, viewDirection, vertex.handedness };
+	}
 
-			Vector4 pos{ projectedVertexX, projectedVertexY , projectedVertexZ, projectedVertexW };
-			const Vector3 viewDirection{ m_Camera.m_Origin - transformedVert };
+	bool Renderer::RenderOffscreen(int width, int height, const std::string& path, int bandHeight) const
+	{
+		if (m_Meshes.empty() || width <= 0 || height <= 0 || bandHeight <= 0)
+			return false;
 
-			if (!(pos.x < -1 && pos.x > 1) && !(pos.y < -1 && pos.y > 1)) {
-				vertices_out[i] = { pos, vertices_in[i].color,  vertices_in[i].uv, normal, tangent, viewDirection };
+		BandedImageWriter writer{};
+		if (!writer.Open(path, width, height)) {
+			std::cout << "Offscreen: could not open " << path << '\n';
+			return false;
+		}
+		std::cout << "-----Rendering " << width << "x" << height << " to " << path << "-----\n";
+
+		//we only render the first mesh, same as the software path
+		const Mesh& mesh{ *m_Meshes[0] };
+		//the image gets the full mesh, the level of detail is picked for the window
+		const std::span<const PackedVertex> vertices{ mesh.GetGeometry()->GetLodVertices(0) };
+		const std::span<const uint32_t> indices{ mesh.GetGeometry()->GetLodIndices(0) };
+
+		//projection with the aspect ratio of the image instead of the window
+		const Matrix projectionMatrix{ Matrix::CreatePerspectiveFovLH(m_Camera.m_Fov, static_cast<float>(width) / height, m_Camera.nearZ, m_Camera.farZ) };
+		const Matrix worldViewProjectionMatrix{ mesh.m_WorldMatrix * m_Camera.m_ViewMatrix * projectionMatrix };
+
+		//1. transform every vertex once, a triangle spanning several bands reuses it
+		std::vector<Vertex_Out> transformedVertices(vertices.size());
+		concurrency::parallel_for(size_t{ 0 }, vertices.size(), [&](size_t i) {
+			transformedVertices[i] = TransformVertex(UnpackVertex(vertices[i], mesh.quantization), mesh.m_WorldMatrix, worldViewProjectionMatrix, width, height);
+		});
+
+		//2. bin the triangles into every band their bounding box touches
+		const int bandCount{ (height + bandHeight - 1) / bandHeight };
+		std::vector<std::vector<uint32_t>> bins(bandCount);
+		for (size_t i{}; i + 2 < indices.size(); i += 3)
+		{
+			const float y0{ transformedVertices[indices[i]].position.y };
+			const float y1{ transformedVertices[indices[i + 1]].position.y };
+			const float y2{ transformedVertices[indices[i + 2]].position.y };
+			const float minY{ std::min(y0, std::min(y1, y2)) };
+			const float maxY{ std::max(y0, std::max(y1, y2)) };
+
+			//HandleRenderBB rejects triangles that leave the image, no need to bin them
+			if (!(minY >= 0) || !(maxY <= height - 1))
+				continue;
+
+			const int firstBand{ static_cast<int>(minY) / bandHeight };
+			const int lastBand{ std::min(static_cast<int>(std::ceil(maxY)) / bandHeight, bandCount - 1) };
+			for (int band{ firstBand }; band <= lastBand; ++band)
+			{
+				bins[band].push_back(static_cast<uint32_t>(i));
 			}
 		}
+
+		//3. rasterize band by band into the same fixed size buffers and stream each band out
+		const size_t bandSize{ static_cast<size_t>(width) * bandHeight };
+		CompressedDepthBuffer depthBuffer{ width, bandHeight };
+		std::vector<ColorRGB> colorBuffer(bandSize);
+		std::vector<uint32_t> pixels(bandSize);
+		SDL_PixelFormat* pFormat{ SDL_AllocFormat(SDL_PIXELFORMAT_RGB888) };
+
+		bool succeeded{ true };
+		for (int band{}; band < bandCount && succeeded; ++band)
+		{
+			const int bandBegin{ band * bandHeight };
+			const int bandEnd{ std::min(bandBegin + bandHeight, height) };
+			const size_t pixelCount{ static_cast<size_t>(width) * (bandEnd - bandBegin) };
+
+			depthBuffer.Clear();
+			std::fill_n(colorBuffer.begin(), pixelCount, m_SelectedColor);
+			std::fill_n(pixels.begin(), pixelCount, m_HasClearColor ? 0x191919u : 0x636363u);
+
+			const RasterTarget target{ width, height, bandBegin, bandEnd, &depthBuffer, colorBuffer.data(), pixels.data(), pFormat };
+			const std::vector<uint32_t>& bin{ bins[band] };
+			concurrency::parallel_for(size_t{ 0 }, bin.size(), [&](size_t i) {
+				const uint32_t index{ bin[i] };
+				std::vector<Vertex_Out> verts{
+					transformedVertices[indices[index]],
+					transformedVertices[indices[index + 1]],
+					transformedVertices[indices[index + 2]] };
+
+				HandleRenderBB(verts, target);
+			});
+
+			succeeded = writer.WriteRows(pixels.data(), bandEnd - bandBegin);
+		}
+
+		SDL_FreeFormat(pFormat);
+		succeeded = writer.Close() && succeeded;
+		std::cout << (succeeded ? "-----Offscreen render done-----\n" : "Offscreen: writing the image failed\n");
+		return succeeded;
 	}
 	#pragma endregion
 
 	bool Renderer::SaveBufferToImage() const
 	{
-		return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+		//picked up by the next Render, encoding happens on the capture threads
+		m_pFrameCapture->RequestScreenshot(CaptureFormat::PNG);
+		std::cout << "-----Screenshot requested-----\n";
+		return true;
+	}
+
+	void Renderer::ToggleCaptureSequence()
+	{
+		//QOI encodes fast enough to keep up with the frame rate, PNG would throttle the render loop
+		//frames rendered while the sequence ran may still be on their way back from the GPU
+		if (m_pFrameCapture->IsSequenceRunning())
+			DeliverFrameResolves(true);
+		m_pFrameCapture->IsSequenceRunning() ?
+			m_pFrameCapture->StopSequence() :
+			m_pFrameCapture->StartSequence(m_CaptureSequenceLength, CaptureFormat::QOI);
+	}
+
+	void Renderer::CaptureFrame(const ResolvedFrame& frame) const
+	{
+		if (!m_pFrameCapture->IsCapturePending())
+			return;
+
+		uint32_t* pPixels{ m_pFrameCapture->AcquireFrame() };
+		if (!ResolveFrame(frame, pPixels)) {
+			std::fill(pPixels, pPixels + m_Width * m_Height, 0u);
+		}
+		m_pFrameCapture->SubmitFrame(pPixels);
+	}
+
+	bool Renderer::StartVideoStream(const std::string& target, VideoStreamFormat format, int frameCount)
+	{
+		if (frameCount <= 0 || !m_pVideoStream->Open(target, format))
+			return false;
+
+		m_StreamFrameCount = frameCount;
+		m_StreamRenderedFrames = 0;
+		if (!m_pStreamResolveBuffer) {
+			m_pStreamResolveBuffer = new uint32_t[m_Width * m_Height];
+		}
+		std::cout << "-----Streaming " << frameCount << " frames to " << target << "-----\n";
+		return true;
+	}
+
+	void Renderer::StreamFrame(const ResolvedFrame& frame) const
+	{
+		if (!m_pVideoStream->IsOpen())
+			return;
+
+		if (frame.isRGBA) {
+			if (ResolveFrame(frame, m_pStreamResolveBuffer)) {
+				m_pVideoStream->SubmitFrame(m_pStreamResolveBuffer, m_Width);
+			}
+		}
+		else if (frame.pPixels) {
+			//converted straight from the back buffer, no intermediate copy
+			m_pVideoStream->SubmitFrame(reinterpret_cast<const uint32_t*>(frame.pPixels), frame.rowPitch / 4);
+		}
+
+		//a frame that can't be read back would leave a gap in the turntable, a failed reader never takes the rest.
+		//Either way the stream ends here instead of waiting for frames that never get counted.
+		if (!frame.pPixels) {
+			std::cout << "Renderer: a frame could not be read back, the video stream stops\n";
+			m_pVideoStream->Close();
+		}
+		else if (m_pVideoStream->HasFailed() || m_pVideoStream->GetSubmittedFrames() >= m_StreamFrameCount) {
+			m_pVideoStream->Close();
+		}
+	}
+
+	bool Renderer::StartSharedMemoryOutput(const std::string& name, int slotCount)
+	{
+		return m_pFramePublisher->Open(name, m_Width, m_Height, slotCount);
+	}
+
+	void Renderer::PublishFrame(const ResolvedFrame& frame) const
+	{
+		if (!m_pFramePublisher->IsOpen() || !frame.pPixels)
+			return;
+
+		//resolves straight into the shared slot, readers map it and never copy
+		uint32_t* pSlotPixels{ m_pFramePublisher->BeginFrame() };
+		if (ResolveFrame(frame, pSlotPixels)) {
+			m_pFramePublisher->EndFrame();
+		}
+	}
+
+	bool Renderer::IsOutputActive() const
+	{
+		return m_pFrameCapture->IsCapturePending() || IsStreamWantingFrames() || m_pFramePublisher->IsOpen();
+	}
+
+	void Renderer::OutputRenderedFrame() const
+	{
+		const bool isStreamFrame{ IsStreamWantingFrames() };
+		if (!m_IsHardware) {
+			//already on the CPU, hardware copies that are still in flight are older and go first
+			DeliverFrameResolves(true);
+			OutputFrame({ reinterpret_cast<const uint8_t*>(m_pBackBufferPixels), m_pBackBuffer->pitch, false });
+		}
+		else if (IsOutputActive()) {
+			//a full ring means the GPU is that many frames behind, only then the oldest copy is waited for
+			if (m_PendingResolves == m_CaptureStagingCount) {
+				DeliverOldestResolve(true);
+			}
+			m_pDeviceContext->CopyResource(m_pCaptureStagingBuffers[(m_OldestResolve + m_PendingResolves) % m_CaptureStagingCount], m_pRenderTargetBuffer);
+			++m_PendingResolves;
+		}
+
+		if (isStreamFrame) {
+			++m_StreamRenderedFrames;
+		}
+
+		//once nothing wants new frames (the stream rendered its last one, the sequence ended) the ring is emptied right away
+		DeliverFrameResolves(!IsOutputActive());
+	}
+
+	bool Renderer::DeliverOldestResolve(bool isWaiting) const
+	{
+		ID3D11Texture2D* pStagingBuffer{ m_pCaptureStagingBuffers[m_OldestResolve] };
+		D3D11_MAPPED_SUBRESOURCE mapped{};
+		const HRESULT result{ m_pDeviceContext->Map(pStagingBuffer, 0, D3D11_MAP_READ, isWaiting ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) };
+		if (result == DXGI_ERROR_WAS_STILL_DRAWING)
+			return false;
+
+		m_OldestResolve = (m_OldestResolve + 1) % m_CaptureStagingCount;
+		--m_PendingResolves;
+		if (FAILED(result)) {
+			OutputFrame({});
+			return true;
+		}
+
+		OutputFrame({ static_cast<const uint8_t*>(mapped.pData), static_cast<int>(mapped.RowPitch), true });
+		m_pDeviceContext->Unmap(pStagingBuffer, 0);
+		return true;
+	}
+
+	void Renderer::DeliverFrameResolves(bool isFlush) const
+	{
+		//in order, a copy that isn't done yet holds back the newer ones
+		while (m_PendingResolves > 0 && DeliverOldestResolve(isFlush)) {}
+	}
+
+	void Renderer::OutputFrame(const ResolvedFrame& frame) const
+	{
+		CaptureFrame(frame);
+		StreamFrame(frame);
+		PublishFrame(frame);
+	}
+
+	bool Renderer::ResolveFrame(const ResolvedFrame& frame, uint32_t* pDestination) const
+	{
+		if (!frame.pPixels)
+			return false;
+
+		if (!frame.isRGBA) {
+			//the back buffer is created with the default 32 bit format, which already is XRGB8888
+			for (int y{}; y < m_Height; ++y)
+			{
+				std::copy_n(reinterpret_cast<const uint32_t*>(frame.pPixels + static_cast<size_t>(y) * frame.rowPitch), m_Width, pDestination + y * m_Width);
+			}
+			return true;
+		}
+
+		//R8G8B8A8 in memory -> XRGB8888
+		concurrency::parallel_for(0, m_Height, [&](int y) {
+			const uint8_t* pRow{ frame.pPixels + static_cast<size_t>(y) * frame.rowPitch };
+			uint32_t* pOut{ pDestination + y * m_Width };
+			for (int x{}; x < m_Width; ++x)
+			{
+				const uint8_t* pTexel{ pRow + x * 4 };
+				pOut[x] = (uint32_t(pTexel[0]) << 16) | (uint32_t(pTexel[1]) << 8) | uint32_t(pTexel[2]);
+			}
+		});
+		return true;
 	}
 
 	HRESULT Renderer::InitializeDirectX()
@@ -595,6 +1280,26 @@ namespace dae {
 		if (FAILED(result))
 			return result;
 
+		//CPU readable copy of the back buffer for frame capture
+		D3D11_TEXTURE2D_DESC stagingDesc{};
+		stagingDesc.Width = m_Width;
+		stagingDesc.Height = m_Height;
+		stagingDesc.MipLevels = 1;
+		stagingDesc.ArraySize = 1;
+		stagingDesc.Format = swapChainDesc.BufferDesc.Format;
+		stagingDesc.SampleDesc.Count = 1;
+		stagingDesc.SampleDesc.Quality = 0;
+		stagingDesc.Usage = D3D11_USAGE_STAGING;
+		stagingDesc.BindFlags = 0;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		stagingDesc.MiscFlags = 0;
+
+		for (ID3D11Texture2D*& pStagingBuffer : m_pCaptureStagingBuffers) {
+			result = m_pDevice->CreateTexture2D(&stagingDesc, nullptr, &pStagingBuffer);
+			if (FAILED(result))
+				return result;
+		}
+
 		//rasterizer state
 		D3D11_RASTERIZER_DESC rasterizer{};
 		rasterizer.FillMode = D3D11_FILL_SOLID; //?
@@ -691,7 +1396,7 @@ namespace dae {
 		anisotropicSampleState.MinLOD = -FLT_MAX;
 		anisotropicSampleState.MaxLOD = FLT_MAX;
 		anisotropicSampleState.MipLODBias = 0.0f;
-		anisotropicSampleState.MaxAnisotropy = 1;
+		anisotropicSampleState.MaxAnisotropy = TextureSampler::MaxAnisotropy;
 		anisotropicSampleState.ComparisonFunc = D3D11_COMPARISON_NEVER;
 		anisotropicSampleState.BorderColor[0] = 1.0f;
 		anisotropicSampleState.BorderColor[1] = 1.0f;
@@ -724,12 +1429,47 @@ namespace dae {
 		return result;
 	}
 
+	void Renderer::PrintDepthBufferStats() const
+	{
+		if (m_IsHardware)
+			return;
+
+		const DepthBufferStats stats{ m_pDepthBuffer->GetStats() };
+		const uint32_t tileCount{ stats.GetCompressedTiles() + stats.rawTiles };
+		std::cout << "Depth tiles: " << stats.GetCompressedTiles() << "/" << tileCount << " compressed ("
+			<< stats.clearTiles << " clear, " << stats.onePlaneTiles << " one plane, " << stats.twoPlaneTiles << " two planes), "
+			<< stats.rawTiles << " uncompressed\n";
+	}
+
+	void Renderer::PrintVirtualTextureStats() const
+	{
+		if (m_IsHardware || !m_IsVirtualTexturing || !HasVirtualMaps())
+			return;
+
+		std::cout << "Virtual pages resident: ";
+		for (const VirtualTexture* pMap : { m_pVirtualTexture, m_pVirtualTextureGloss, m_pVirtualTextureNormal, m_pVirtualTextureSpecular })
+		{
+			std::cout << pMap->GetResidentPageCount() << "/" << pMap->GetPageCapacity() << " (" << pMap->GetMemorySize() / 1024 << " KB) ";
+		}
+		std::cout << '\n';
+	}
+
+	void Renderer::PrintStreamedMeshStats() const
+	{
+		if (m_IsHardware || !m_IsStreamingMesh || !m_pStreamedMesh)
+			return;
+
+		std::cout << "Clusters resident: " << m_pStreamedMesh->GetResidentClusterCount() << "/" << m_pStreamedMesh->GetClusterCapacity()
+			<< " of " << m_pStreamedMesh->GetClusterCount() << " (" << m_pStreamedMesh->GetMemorySize() / 1024 << " KB)\n";
+	}
+
 	#pragma region Cyclers
 	void Renderer::CycleSampler()
 	{
 		m_SampleMode == SampleMode::Anisotropic ?
 			m_SampleMode = SampleMode(0) :
 			m_SampleMode = SampleMode(static_cast<int>(m_SampleMode) + 1);
+		m_SoftwareSampler.SetSampleMode(m_SampleMode);
 
 		switch (m_SampleMode)
 		{
@@ -776,6 +1516,13 @@ namespace dae {
 		}
 	}
 
+	void Renderer::ToggleTriangleStrips() {
+		const bool isStrip{ m_Meshes[0]->GetTopology() == PrimitiveTopology::TriangleList };
+		for (Mesh* mesh : m_Meshes)
+			mesh->SetTopology(isStrip ? PrimitiveTopology::TriangleStrip : PrimitiveTopology::TriangleList);
+		isStrip ? std::cout << "-----Triangle strips on-----\n" : std::cout << "-----Triangle strips off-----\n";
+	}
+
 	void Renderer::CycleCullMode() {
 		m_CullMode == CullMode::Back ?
 			m_CullMode = CullMode(0) :
@@ -1,20 +1,37 @@
 #pragma once
 #include "Texture.h"
+#include "TextureSampler.h"
 #include "Camera.h"
 #include "Mesh.h"
 #include "Datatypes.h"
+#include "FrameCapture.h"
+#include "VideoStream.h"
+#include "SharedFrameBuffer.h"
+#include "CompressedDepthBuffer.h"
+#include "AssetLoader.h"
+#include "StreamedMesh.h"
 #include <wrl/client.h>
 using Microsoft::WRL::ComPtr;
 
 struct SDL_Window;
 struct SDL_Surface;
+struct SDL_PixelFormat;
 
 namespace dae
 {
+	//How the vehicle's assets are held in memory, picked on the command line and fixed for the renderer's lifetime
+	struct AssetOptions
+	{
+		//software path: the vehicle maps are only paged in through fixed size page caches, their full software copies are never made
+		bool isVirtualTexturing{ false };
+		//software path: the vehicle is drawn from the clusters of its cluster cache, its full geometry is only mapped, never loaded
+		bool isStreamingMesh{ false };
+	};
+
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		Renderer(SDL_Window* pWindow, const AssetOptions& assetOptions = {});
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -26,6 +43,31 @@ namespace dae
 		void Render() const;
 
 		bool SaveBufferToImage() const;
+		void ToggleCaptureSequence();
+
+		//Offline turntable: the vehicle does exactly one revolution over frameCount frames, independent of frame time
+		bool StartVideoStream(const std::string& target, VideoStreamFormat format, int frameCount);
+		bool IsVideoStreamFinished() const { return m_StreamFrameCount > 0 && !m_pVideoStream->IsOpen(); };
+
+		/**
+		 * \brief Renders the software path at any resolution into a BMP, band by band.
+		 * Color/depth buffers only ever hold bandHeight rows and triangles are binned per band,
+		 * so memory stays bounded no matter how large the image is.
+		 */
+		bool RenderOffscreen(int width, int height, const std::string& path, int bandHeight = 64) const;
+
+		//Every rendered frame is also published into a named shared memory ring for other local processes
+		bool StartSharedMemoryOutput(const std::string& name, int slotCount);
+
+		//Meshes and textures stream in after the constructor, placeholders are drawn until then. Blocks until all of them arrived.
+		void FinishLoading();
+
+		//How many depth tiles of the last software frame stayed compressed (clear or plane encoded)
+		void PrintDepthBufferStats() const;
+		//Resident pages of the virtual vehicle maps, when the software path samples them
+		void PrintVirtualTextureStats() const;
+		//Resident clusters of the streamed vehicle, when the software path draws it
+		void PrintStreamedMeshStats() const;
 
 		void ToggleRenderer() { 
 			m_IsHardware = !m_IsHardware;
@@ -47,6 +89,9 @@ namespace dae
 			m_HasBB ? std::cout << "-----bounding box on-----\n" : std::cout << "-----bounding box off-----\n";
 		};
 
+		//both backends: the meshes are drawn from their triangle strips instead of their triangle lists
+		void ToggleTriangleStrips();
+
 		void ToggleFire() { m_HasFire = !m_HasFire; };
 		void ToggleDepthBuffer() { m_IsShowDepthBuffer = !m_IsShowDepthBuffer; };
 		void ToggleClearColor() { m_HasClearColor = !m_HasClearColor; };
@@ -56,15 +101,31 @@ namespace dae
 		void CycleSampler();
 
 	private:
+		//Where the software rasterizer writes to: the window buffers, or one band of an offscreen image.
+		//The buffers hold the rows [bandBegin, bandEnd) of a width x height image.
+		struct RasterTarget
+		{
+			int width{};
+			int height{};
+			int bandBegin{};
+			int bandEnd{};
+			CompressedDepthBuffer* pDepthBuffer{};
+			ColorRGB* pColorBuffer{};
+			uint32_t* pPixels{};
+			const SDL_PixelFormat* pFormat{};
+		};
+
 		SDL_Window* m_pWindow{};
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
-		float* m_pDepthBuffer{};
+		CompressedDepthBuffer* m_pDepthBuffer{};
 		ColorRGB* m_pColorBuffer{};
 
 		CullMode m_CullMode{ CullMode::Back };
 		SampleMode m_SampleMode{ SampleMode::Point };
+		//clamps like the D3D sampler states
+		TextureSampler m_SoftwareSampler{ m_SampleMode, AddressMode::Clamp };
 		LightingMode m_LightingMode{ LightingMode::Combined };
 		Vector3 m_LightDirection{ .577f, -.577f, .577f };
 		const static int m_LightIntensity{ 7 };
@@ -82,6 +143,9 @@ namespace dae
 		bool m_IsShowDepthBuffer{ false };
 		bool m_HasBB{ false };
 		bool m_HasClearColor{ false };
+		//see AssetOptions
+		const bool m_IsVirtualTexturing{ false };
+		const bool m_IsStreamingMesh{ false };
 
 		ColorRGB m_UniformColor{ .1f, .1f, .1f };
 		ColorRGB m_HardwareColor{ .39f,.59f, .93f };
@@ -106,14 +170,52 @@ namespace dae
 		ID3D11SamplerState* m_pPointSampler{ nullptr };
 		ID3D11SamplerState* m_pLinearSampler{ nullptr };
 		ID3D11SamplerState* m_pAnisotropicSampler{ nullptr };
+		//CPU readable copies of the back buffer, a ring so a copy is read a few frames later instead of draining the GPU every frame
+		static constexpr int m_CaptureStagingCount{ 3 };
+		ID3D11Texture2D* m_pCaptureStagingBuffers[m_CaptureStagingCount]{};
+		mutable int m_OldestResolve{ 0 };
+		mutable int m_PendingResolves{ 0 };
+
+		FrameCapture* m_pFrameCapture{ nullptr };
+		const static int m_CaptureSequenceLength{ 300 };
+
+		VideoStream* m_pVideoStream{ nullptr };
+		uint32_t* m_pStreamResolveBuffer{ nullptr };
+		int m_StreamFrameCount{ 0 };
+		//frames rendered for the stream so far, ahead of the submitted ones while hardware copies are in flight
+		mutable int m_StreamRenderedFrames{ 0 };
+
+		SharedFramePublisher* m_pFramePublisher{ nullptr };
 
 		float m_test{};
 
-		Texture* m_pTexture{ nullptr };
-		Texture* m_pTextureGloss{ nullptr };
-		Texture* m_pTextureNormal{ nullptr };
-		Texture* m_pTextureSpecular{ nullptr };
-		Texture* m_pCombustionTexture{ nullptr };
+		//one texture per path and format, shared by whoever holds a handle to it
+		TextureRegistry* m_pTextureRegistry{ nullptr };
+		//with virtual texturing the vehicle maps only hold their D3D textures
+		TextureHandle m_pTexture{};
+		TextureHandle m_pTextureGloss{};
+		TextureHandle m_pTextureNormal{};
+		TextureHandle m_pTextureSpecular{};
+		TextureHandle m_pCombustionTexture{};
+		//software copy of the four vehicle maps interleaved, nullptr when they can't be packed together or are virtual
+		MaterialTexture* m_pMaterialTexture{ nullptr };
+
+		//the same four maps paged in from their texture caches, only with virtual texturing and nullptr until the map loaded
+		VirtualTexture* m_pVirtualTexture{ nullptr };
+		VirtualTexture* m_pVirtualTextureGloss{ nullptr };
+		VirtualTexture* m_pVirtualTextureNormal{ nullptr };
+		VirtualTexture* m_pVirtualTextureSpecular{ nullptr };
+		//page pool of every virtual map, half of a 1024x1024 BC1 level 0
+		const static size_t m_VirtualTextureBudget{ 256 * 1024 };
+
+		//the vehicle paged in cluster by cluster from its cluster cache, nullptr until the mesh loaded
+		StreamedMesh* m_pStreamedMesh{ nullptr };
+		//cluster pool, room for about 380 full clusters
+		const static size_t m_StreamedMeshBudget{ 2 * 1024 * 1024 };
+
+		//decodes every mesh and texture concurrently, swaps them in from Update
+		AssetLoader* m_pAssetLoader{ nullptr };
+		int m_LoadedVehicleMaps{ 0 };
 
 		Matrix m_TranslationTransform{};
 		Matrix m_RotationTransform{};
@@ -127,14 +229,58 @@ namespace dae
 		//...
 
 		//Function that transforms the vertices from the mesh from World space to Screen space
-		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex_Out>& vertices_out, const Matrix& worldMatrix) const;
+		void VertexTransformationFunction(std::span<const PackedVertex> vertices_in, const PositionQuantization& quantization, std::vector<Vertex_Out>& vertices_out, const Matrix& worldMatrix, const Matrix& viewProjectionMatrix, int width, int height) const;
+		Vertex_Out TransformVertex(const Vertex& vertex, const Matrix& worldMatrix, const Matrix& worldViewProjectionMatrix, int width, int height) const;
 
-		void HandleRenderBB(std::vector<Vertex_Out>& verts) const;
+		void HandleRenderBB(std::vector<Vertex_Out>& verts, const RasterTarget& target) const;
 
-		Vertex_Out CalculateVertexWithAttributes(const std::vector<Vertex_Out>& verts, float w0, float w1, float w2, float& outGloss, ColorRGB& outSpecularKS) const;
+		//material: what SampleMaterial gave the pixel's lane of its quad
+		Vertex_Out CalculateVertexWithAttributes(const std::vector<Vertex_Out>& verts, float w0, float w1, float w2, const MaterialSample& material, float& outGloss, ColorRGB& outSpecularKS) const;
 		ColorRGB PixelShading(const Vertex_Out& v, const float gloss, const ColorRGB specularKS) const;
+		//Swaps a loaded vehicle map in for its placeholder, packs the material texture once all four are there
+		void OnVehicleMapLoaded(TextureHandle& pMap, const TextureHandle& pLoaded);
+		//With virtual texturing the virtual map is opened first, writing the texture cache if needed, then the D3D texture is uploaded from that cache
+		void LoadVehicleMap(const std::string& path, TexelFormat format, TextureHandle& pMap, VirtualTexture*& pVirtualMap);
+		//software copies, the material texture and the page pools of the virtual maps
+		void PrintTextureMemory() const;
+		bool HasVirtualMaps() const { return m_pVirtualTexture && m_pVirtualTextureGloss && m_pVirtualTextureNormal && m_pVirtualTextureSpecular; };
+		//The vehicle's maps for the 4 pixels of a 2x2 quad, uvs top left, top right, bottom left, bottom right.
+		//The quad's uv differences pick the mip level.
+		void SampleMaterial(const Vector2 (&uvs)[4], MaterialSample (&outMaterials)[4]) const;
+		//four separate quad samples, when there is no material texture or the maps are virtual
+		template<typename Map>
+		void SampleMaterialMaps(const Map& diffuse, const Map& gloss, const Map& normalMap, const Map& specular, const Vector2 (&uvs)[4], MaterialSample (&outMaterials)[4]) const;
+
+		//What the outputs read a frame from: the software back buffer (XRGB8888) or a mapped copy of the swap chain (R8G8B8A8).
+		//pPixels is nullptr when the frame could not be read back.
+		struct ResolvedFrame
+		{
+			const uint8_t* pPixels{};
+			int rowPitch{};
+			bool isRGBA{};
+		};
+
+		bool IsStreamWantingFrames() const { return m_pVideoStream->IsOpen() && m_StreamRenderedFrames < m_StreamFrameCount; };
+		bool IsOutputActive() const;
+		//Hands the frame that was just rendered to the capture, the stream and the shared memory output.
+		//Hardware frames are copied into the next staging texture and only read back once the GPU got to them.
+		void OutputRenderedFrame() const;
+		//isWaiting maps the oldest copy even when the GPU still has to finish it, false when it didn't
+		bool DeliverOldestResolve(bool isWaiting) const;
+		//every copy the GPU finished, oldest first. isFlush waits for all of them.
+		void DeliverFrameResolves(bool isFlush) const;
+		void OutputFrame(const ResolvedFrame& frame) const;
+		//Converts frame into pDestination as XRGB8888, m_Width * m_Height pixels
+		bool ResolveFrame(const ResolvedFrame& frame, uint32_t* pDestination) const;
+		void CaptureFrame(const ResolvedFrame& frame) const;
+		void StreamFrame(const ResolvedFrame& frame) const;
+		void PublishFrame(const ResolvedFrame& frame) const;
 
-		//void RenderMeshTriangleStrip(const Mesh& mesh) const;
+		//the strips of the current level of detail, each strip transforms every vertex once and keeps the last two for the next triangle
+		void RenderMeshTriangleStrip(const Mesh& mesh) const;
 		void RenderMeshTriangleList(const Mesh& mesh) const;
+		//level 0 of a mesh, only the meshlets CullMeshlets left
+		void RenderMeshlets(const Mesh& mesh, const RasterTarget& target, const Matrix& viewProjectionMatrix) const;
+		void RenderStreamedMesh(const StreamedMesh& mesh, const Matrix& worldMatrix) const;
 	};
 }
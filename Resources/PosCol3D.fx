@@ -1,6 +1,9 @@
 float4x4 gWorldViewProj : WorldViewProjection;
 float4x4 gWorldMatrix : World;
 float3 gOnb : ViewInverse;
+//object space position = gPositionOffset + 16 bit unorm value * gPositionScale, see PositionQuantization
+float3 gPositionOffset;
+float3 gPositionScale;
 
 Texture2D gDiffuseMap : DiffuseMap;
 Texture2D gGlossyMap : GlossyMap;
@@ -76,13 +79,13 @@ DepthStencilState gDepthStencilState
 // Input/Output Structs
 //
 
+//PackedVertex, the input assembler already turned the unorm/snorm/half values into floats
 struct VS_INPUT
 {
-    float3 Position : POSITION;
-    float3 Color : COLOR;
+    float4 Position : POSITION;
     float2 Uv : TEXCOORD;
-    float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
+    float2 Normal : NORMAL;
+    float2 Tangent : TANGENT;
 };
 
 struct VS_OUTPUT
@@ -92,6 +95,7 @@ struct VS_OUTPUT
     float2 Uv : TEXCOORD0;
     float3 Normal : NORMAL;
     float3 Tangent : TANGENT;
+    float3 Binormal : BINORMAL;
 };
 
 float3 Phong(float3 ks, float exp, float3 l, float3 v, float3 n)
@@ -106,16 +110,29 @@ float3 Lambert(float3 color)
     return (color * diffuseReflectance) / PI;
 }
 
+//octahedral direction, the same as DecodeOctahedral in PackedVertex.cpp
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 direction = float3(max(encoded, -1.f), 0.f);
+    direction.z = 1.f - abs(direction.x) - abs(direction.y);
+    float fold = max(-direction.z, 0.f);
+    direction.xy += (direction.xy >= 0.f) ? -fold : fold;
+    return normalize(direction);
+}
+
 //
 // Vertex Shader
 //
 VS_OUTPUT VS(VS_INPUT input)
 {
     VS_OUTPUT output = (VS_OUTPUT) 0;
-    output.Position = mul(float4(input.Position, 1.f), gWorldViewProj);
-    output.Color = float4(input.Color, 1.f);
-    output.Normal = mul(normalize(input.Normal), (float3x3) gWorldMatrix);
-    output.Tangent = mul(normalize(input.Tangent), (float3x3) gWorldMatrix);
+    float3 position = gPositionOffset + input.Position.xyz * 65535.f * gPositionScale;
+    output.Position = mul(float4(position, 1.f), gWorldViewProj);
+    output.Color = float4(1.f, 1.f, 1.f, 1.f);
+    output.Normal = mul(DecodeOctahedral(input.Normal), (float3x3) gWorldMatrix);
+    output.Tangent = mul(DecodeOctahedral(input.Tangent), (float3x3) gWorldMatrix);
+    //Position.w holds the handedness, 0 for mirrored uvs
+    output.Binormal = cross(output.Normal, output.Tangent) * (input.Position.w * 2.f - 1.f);
     output.Uv = input.Uv;
     return output;
 }
@@ -128,7 +145,7 @@ float3 CalculatePixelShader(VS_OUTPUT input, float4 gloss, float4 spec, float4 c
     float PI = 3.14;
     
     float3 viewDir = (input.Position.rgb - gOnb);
-    float3 binormal = cross(input.Normal, input.Tangent);
+    float3 binormal = input.Binormal;
     float3x3 tangentSpaceAxis = float3x3(input.Tangent.x, input.Tangent.y, input.Tangent.z, binormal.x, binormal.y, binormal.z, input.Normal.x, input.Normal.y, input.Normal.z);
     float3 computedNormals = normalize(mul(normals.rgb, tangentSpaceAxis) + input.Normal);
       
@@ -156,6 +173,9 @@ float4 PS1(VS_OUTPUT input) : SV_TARGET
     float4 spec = gSpecularMap.Sample(gSampler, input.Uv);
     float4 color = gDiffuseMap.Sample(gSampler, input.Uv);
     float4 normals = gNormalMap.Sample(gSampler, input.Uv);
+    //the normal map is BC5, only x and y are stored
+    float2 normalXY = normals.rg * 2.f - 1.f;
+    normals.b = sqrt(saturate(1.f - dot(normalXY, normalXY))) * 0.5f + 0.5f;
 
     float4 output;
     output.rgb = CalculatePixelShader(input, gloss, spec, color, normals);
@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "SharedFrameBuffer.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr size_t HeaderSize{ (sizeof(SharedFrameHeader) + 63) / 64 * 64 };
+
+		uint8_t* GetSlotBase(const SharedFrameHeader* pHeader, uint64_t sequence)
+		{
+			const uint64_t slotIndex{ (sequence - 1) % pHeader->slotCount };
+			return const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(pHeader)) + HeaderSize + slotIndex * pHeader->slotStride;
+		}
+	}
+
+	#pragma region publisher
+	SharedFramePublisher::~SharedFramePublisher()
+	{
+		Close();
+	}
+
+	bool SharedFramePublisher::Open(const std::string& name, int width, int height, int slotCount)
+	{
+		Close();
+
+		const uint64_t pixelBytes{ static_cast<uint64_t>(width) * height * 4 };
+		const uint64_t slotStride{ (sizeof(SharedFrameSlot) + pixelBytes + 63) / 64 * 64 };
+		const uint64_t totalSize{ HeaderSize + slotStride * slotCount };
+
+		//Pagefile backed named mapping, the Win32 equivalent of shm_open + mmap
+		m_Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(totalSize >> 32), static_cast<DWORD>(totalSize), name.c_str());
+		if (!m_Mapping)
+		{
+			std::cout << "SharedFramePublisher: could not create " << name << '\n';
+			return false;
+		}
+
+		void* pView{ MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(totalSize)) };
+		if (!pView)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+			return false;
+		}
+
+		//Readers check magic last, so write the rest of the header first
+		m_pHeader = new (pView) SharedFrameHeader{};
+		m_pHeader->magic = 0;
+		m_pHeader->width = static_cast<uint32_t>(width);
+		m_pHeader->height = static_cast<uint32_t>(height);
+		m_pHeader->pitch = static_cast<uint32_t>(width * 4);
+		m_pHeader->slotCount = static_cast<uint32_t>(slotCount);
+		m_pHeader->slotStride = slotStride;
+		for (uint64_t sequence{ 1 }; sequence <= static_cast<uint64_t>(slotCount); ++sequence)
+		{
+			new (GetSlotBase(m_pHeader, sequence)) SharedFrameSlot{};
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		m_pHeader->magic = SharedFrameHeader::Magic;
+
+		m_Sequence = 0;
+		std::cout << "-----Publishing frames to " << name << " (" << slotCount << " slots)-----\n";
+		return true;
+	}
+
+	void SharedFramePublisher::Close()
+	{
+		if (m_pHeader)
+		{
+			UnmapViewOfFile(m_pHeader);
+			m_pHeader = nullptr;
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+		m_pWritingSlot = nullptr;
+	}
+
+	uint32_t* SharedFramePublisher::BeginFrame()
+	{
+		if (!m_pHeader)
+			return nullptr;
+
+		++m_Sequence;
+		m_pWritingSlot = GetSlot(m_Sequence);
+
+		//invalidate before touching the pixels, a reader still on the old frame sees the change
+		m_pWritingSlot->sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(m_pWritingSlot) + sizeof(SharedFrameSlot));
+	}
+
+	void SharedFramePublisher::EndFrame()
+	{
+		if (!m_pWritingSlot)
+			return;
+
+		m_pWritingSlot->sequence.store(m_Sequence, std::memory_order_release);
+		m_pHeader->latestSequence.store(m_Sequence, std::memory_order_release);
+		m_pWritingSlot = nullptr;
+	}
+
+	SharedFrameSlot* SharedFramePublisher::GetSlot(uint64_t sequence) const
+	{
+		return reinterpret_cast<SharedFrameSlot*>(GetSlotBase(m_pHeader, sequence));
+	}
+	#pragma endregion
+
+	#pragma region reader
+	SharedFrameReader::~SharedFrameReader()
+	{
+		Detach();
+	}
+
+	bool SharedFrameReader::Attach(const std::string& name)
+	{
+		Detach();
+
+		m_Mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+		if (!m_Mapping)
+			return false;
+
+		//map everything, the size isn't known before the header is read
+		m_pHeader = static_cast<const SharedFrameHeader*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_pHeader || m_pHeader->magic != SharedFrameHeader::Magic || m_pHeader->version != SharedFrameHeader::Version)
+		{
+			Detach();
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+
+	void SharedFrameReader::Detach()
+	{
+		if (m_pHeader)
+		{
+			UnmapViewOfFile(m_pHeader);
+			m_pHeader = nullptr;
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+	}
+
+	const uint32_t* SharedFrameReader::AcquireLatest(uint64_t afterSequence, uint64_t& outSequence) const
+	{
+		if (!m_pHeader)
+			return nullptr;
+
+		const uint64_t latest{ m_pHeader->latestSequence.load(std::memory_order_acquire) };
+		if (latest == 0 || latest <= afterSequence)
+			return nullptr;
+
+		const SharedFrameSlot* pSlot{ GetSlot(latest) };
+		if (pSlot->sequence.load(std::memory_order_acquire) != latest)
+			return nullptr; //already being overwritten, the renderer lapped this reader
+
+		outSequence = latest;
+		return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(pSlot) + sizeof(SharedFrameSlot));
+	}
+
+	bool SharedFrameReader::IsFrameIntact(uint64_t sequence) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return GetSlot(sequence)->sequence.load(std::memory_order_relaxed) == sequence;
+	}
+
+	const SharedFrameSlot* SharedFrameReader::GetSlot(uint64_t sequence) const
+	{
+		return reinterpret_cast<const SharedFrameSlot*>(GetSlotBase(m_pHeader, sequence));
+	}
+	#pragma endregion
+}
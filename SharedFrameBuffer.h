@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Layout of the named shared memory block, readers in other processes map the same struct.
+	//[SharedFrameHeader][slot 0 header][slot 0 pixels]...[slot N-1 header][slot N-1 pixels]
+	struct SharedFrameHeader
+	{
+		static constexpr uint32_t Magic{ 0x46524458 }; //"XDRF"
+		static constexpr uint32_t Version{ 1 };
+
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t pitch{}; //bytes per row
+		uint32_t slotCount{};
+		uint64_t slotStride{}; //bytes from one slot header to the next
+		std::atomic<uint64_t> latestSequence{ 0 }; //sequence of the newest complete frame, 0 = none yet
+	};
+
+	//Per slot seqlock: 0 while the renderer writes into the slot, the frame sequence once it's complete
+	struct alignas(64) SharedFrameSlot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory frame sequences must be lock free");
+
+	//Publishes resolved frames (XRGB8888) into a ring of N slots in named shared memory.
+	//The renderer never waits for readers: it overwrites the oldest slot, readers detect that through the sequence.
+	class SharedFramePublisher final
+	{
+	public:
+		SharedFramePublisher() = default;
+		~SharedFramePublisher();
+
+		SharedFramePublisher(const SharedFramePublisher&) = delete;
+		SharedFramePublisher(SharedFramePublisher&&) noexcept = delete;
+		SharedFramePublisher& operator=(const SharedFramePublisher&) = delete;
+		SharedFramePublisher& operator=(SharedFramePublisher&&) noexcept = delete;
+
+		bool Open(const std::string& name, int width, int height, int slotCount = 3);
+		void Close();
+		bool IsOpen() const { return m_pHeader != nullptr; };
+
+		//Marks the next slot as being written and returns its pixels, pitch is width
+		uint32_t* BeginFrame();
+		void EndFrame();
+
+	private:
+		HANDLE m_Mapping{ nullptr };
+		SharedFrameHeader* m_pHeader{ nullptr };
+		uint64_t m_Sequence{ 0 };
+		SharedFrameSlot* m_pWritingSlot{ nullptr };
+
+		SharedFrameSlot* GetSlot(uint64_t sequence) const;
+	};
+
+	//Consumer side, lives in the compositor/analysis tool. Frames are read in place, no copies.
+	class SharedFrameReader final
+	{
+	public:
+		SharedFrameReader() = default;
+		~SharedFrameReader();
+
+		SharedFrameReader(const SharedFrameReader&) = delete;
+		SharedFrameReader(SharedFrameReader&&) noexcept = delete;
+		SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+		SharedFrameReader& operator=(SharedFrameReader&&) noexcept = delete;
+
+		bool Attach(const std::string& name);
+		void Detach();
+
+		/**
+		 * \brief Newest complete frame, valid to read until the renderer wraps around the ring
+		 * \param outSequence sequence of the returned frame, pass it to IsFrameIntact after reading
+		 * \return pixels of the frame, nullptr when nothing newer than afterSequence was published
+		 */
+		const uint32_t* AcquireLatest(uint64_t afterSequence, uint64_t& outSequence) const;
+		//False when the renderer started overwriting the frame while it was being read
+		bool IsFrameIntact(uint64_t sequence) const;
+
+		const SharedFrameHeader* GetHeader() const { return m_pHeader; };
+
+	private:
+		HANDLE m_Mapping{ nullptr };
+		const SharedFrameHeader* m_pHeader{ nullptr };
+
+		const SharedFrameSlot* GetSlot(uint64_t sequence) const;
+	};
+}
@@ -0,0 +1,241 @@
+#include "pch.h"
+#include "StreamedMesh.h"
+#include "MeshGeometry.h"
+#include "TextureCache.h"
+#include <fstream>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		//clusters read at the same time, what doesn't fit waits for the next frames' feedback
+		constexpr size_t MaxPendingClusters{ 64 };
+
+		//conservative: only false when all eight corners are outside the same clip plane
+		bool IsInsideFrustum(const ClusterInfo& info, const Matrix& worldViewProjectionMatrix)
+		{
+			uint32_t outsideAll{ 0x3F };
+			for (int i{}; i < 8; ++i)
+			{
+				const Vector4 corner{ i & 1 ? info.boundsMax.x : info.boundsMin.x, i & 2 ? info.boundsMax.y : info.boundsMin.y, i & 4 ? info.boundsMax.z : info.boundsMin.z, 1.f };
+				const Vector4 clip{ worldViewProjectionMatrix.TransformPoint(corner) };
+				uint32_t outside{};
+				outside |= clip.x < -clip.w ? 1u : 0u;
+				outside |= clip.x > clip.w ? 2u : 0u;
+				outside |= clip.y < -clip.w ? 4u : 0u;
+				outside |= clip.y > clip.w ? 8u : 0u;
+				outside |= clip.z < 0.f ? 16u : 0u;
+				outside |= clip.z > clip.w ? 32u : 0u;
+				outsideAll &= outside;
+			}
+			return outsideAll == 0;
+		}
+	}
+
+	StreamedMesh* StreamedMesh::Create(const std::string& path, const MeshGeometry& geometry, size_t budget, bool flipAxisAndWinding)
+	{
+		if (StreamedMesh* pMesh{ Open(path, budget, flipAxisAndWinding) })
+			return pMesh;
+
+		//only paid once, later runs open the cache right away
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		if (!GetSourceStamp(path, sourceSize, sourceWriteTime)
+			|| !WriteClusterCache(GetClusterCachePath(path), geometry.GetLodVertices(0), geometry.GetLodIndices(0), geometry.GetBoundsMin(), geometry.GetBoundsMax(),
+				flipAxisAndWinding, sourceSize, sourceWriteTime))
+			return nullptr;
+
+		StreamedMesh* pMesh{ Open(path, budget, flipAxisAndWinding) };
+		if (pMesh)
+			std::cout << "StreamedMesh: " << path << " " << pMesh->GetClusterCount() << " clusters\n";
+		return pMesh;
+	}
+
+	StreamedMesh* StreamedMesh::Open(const std::string& path, size_t budget, bool flipAxisAndWinding)
+	{
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		const std::string cachePath{ GetClusterCachePath(path) };
+		std::ifstream file{ cachePath, std::ios::binary | std::ios::ate };
+		const uint64_t fileSize{ file ? static_cast<uint64_t>(file.tellg()) : 0 };
+
+		ClusterCacheHeader header{};
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		//the table is all that's read up front, its size is checked before it's allocated
+		std::vector<ClusterInfo> infos{};
+		if (file && header.clusterOffset <= fileSize && header.clusterCount <= (fileSize - header.clusterOffset) / sizeof(ClusterInfo))
+		{
+			infos.resize(static_cast<size_t>(header.clusterCount));
+			file.seekg(static_cast<std::streamoff>(header.clusterOffset));
+			file.read(reinterpret_cast<char*>(infos.data()), static_cast<std::streamsize>(infos.size() * sizeof(ClusterInfo)));
+		}
+
+		if (!file || !GetSourceStamp(path, sourceSize, sourceWriteTime) || !IsValidClusterCache(header, infos, fileSize, flipAxisAndWinding, sourceSize, sourceWriteTime))
+			return nullptr;
+
+		return new StreamedMesh{ cachePath, header, std::move(infos), budget };
+	}
+
+	StreamedMesh::StreamedMesh(const std::string& cachePath, const ClusterCacheHeader& header, std::vector<ClusterInfo> infos, size_t budget) :
+		m_CachePath{ cachePath },
+		m_Quantization{ PositionQuantization::FromBounds(header.boundsMin, header.boundsMax) },
+		m_Infos{ std::move(infos) },
+		m_Clusters(m_Infos.size())
+	{
+		//never more slots than clusters, at least one so every cluster can be shown eventually
+		const size_t slotCount{ std::min(std::max(budget / GetMaxClusterSize(), size_t{ 1 }), std::max(m_Infos.size(), size_t{ 1 })) };
+		m_pSlots = new uint8_t[slotCount * GetMaxClusterSize()];
+		m_SlotClusters.assign(slotCount, static_cast<uint32_t>(m_Clusters.size()));
+	}
+
+	StreamedMesh::~StreamedMesh()
+	{
+		//the reads write into the slots
+		for (PendingCluster& pending : m_PendingClusters)
+			pending.load.wait();
+		m_PendingClusters.clear();
+
+		delete[] m_pSlots;
+		m_pSlots = nullptr;
+	}
+
+	void StreamedMesh::Update()
+	{
+		//1. install what finished reading, the renderer only looks at slots that are installed
+		InstallClusters();
+
+		//2. read what the last frame saw and isn't there into the slots of the least recently seen clusters
+		for (uint32_t i{}; i < m_Clusters.size(); ++i)
+		{
+			if (m_PendingClusters.size() >= MaxPendingClusters)
+				break;
+
+			Cluster& cluster{ m_Clusters[i] };
+			if (cluster.slot >= 0 || cluster.isLoading || cluster.isFailed || cluster.requestedFrame.load(std::memory_order_relaxed) != m_Frame)
+				continue;
+
+			const int slot{ TakeSlot() };
+			if (slot < 0)
+				break;
+
+			cluster.isLoading = true;
+			m_SlotClusters[slot] = i;
+			uint8_t* pSlot{ m_pSlots + static_cast<size_t>(slot) * GetMaxClusterSize() };
+			const ClusterInfo& info{ m_Infos[i] };
+			m_PendingClusters.push_back({ concurrency::create_task([this, &info, pSlot] { return ReadCluster(info, pSlot); }), i, slot });
+		}
+
+		++m_Frame;
+	}
+
+	void StreamedMesh::Flush()
+	{
+		for (PendingCluster& pending : m_PendingClusters)
+			pending.load.wait();
+
+		InstallClusters();
+	}
+
+	void StreamedMesh::CullClusters(const Matrix& worldViewProjectionMatrix, std::vector<uint32_t>& outClusters) const
+	{
+		std::vector<uint8_t> isVisible(m_Infos.size());
+		concurrency::parallel_for(size_t{}, m_Infos.size(), [&](size_t i) {
+			if (!IsInsideFrustum(m_Infos[i], worldViewProjectionMatrix))
+				return;
+
+			m_Clusters[i].requestedFrame.store(m_Frame, std::memory_order_relaxed);
+			isVisible[i] = m_Clusters[i].slot >= 0 ? 1 : 0;
+		});
+
+		outClusters.clear();
+		for (uint32_t i{}; i < isVisible.size(); ++i)
+		{
+			if (isVisible[i])
+				outClusters.push_back(i);
+		}
+	}
+
+	std::span<const PackedVertex> StreamedMesh::GetVertices(uint32_t cluster) const
+	{
+		const uint8_t* pSlot{ m_pSlots + static_cast<size_t>(m_Clusters[cluster].slot) * GetMaxClusterSize() };
+		return { reinterpret_cast<const PackedVertex*>(pSlot), m_Infos[cluster].vertexCount };
+	}
+
+	std::span<const uint8_t> StreamedMesh::GetIndices(uint32_t cluster) const
+	{
+		const uint8_t* pSlot{ m_pSlots + static_cast<size_t>(m_Clusters[cluster].slot) * GetMaxClusterSize() };
+		return { pSlot + m_Infos[cluster].vertexCount * sizeof(PackedVertex), m_Infos[cluster].triangleCount * size_t{ 3 } };
+	}
+
+	void StreamedMesh::InstallClusters()
+	{
+		for (size_t i{}; i < m_PendingClusters.size();)
+		{
+			PendingCluster& pending{ m_PendingClusters[i] };
+			if (!pending.load.is_done())
+			{
+				++i;
+				continue;
+			}
+
+			Cluster& cluster{ m_Clusters[pending.cluster] };
+			cluster.isLoading = false;
+			if (pending.load.get())
+			{
+				cluster.slot = pending.slot;
+				++m_ResidentClusterCount;
+			}
+			else
+			{
+				//never asked for again, that part of the mesh stays missing
+				std::cout << "StreamedMesh: could not read a cluster of " << m_CachePath << '\n';
+				cluster.isFailed = true;
+				m_SlotClusters[pending.slot] = static_cast<uint32_t>(m_Clusters.size());
+			}
+			m_PendingClusters.erase(m_PendingClusters.begin() + i);
+		}
+	}
+
+	bool StreamedMesh::ReadCluster(const ClusterInfo& info, uint8_t* pSlot) const
+	{
+		//every reader has its own stream, clusters are read in parallel
+		std::ifstream file{ m_CachePath, std::ios::binary };
+		if (!file)
+			return false;
+
+		file.seekg(static_cast<std::streamoff>(info.dataOffset));
+		file.read(reinterpret_cast<char*>(pSlot), static_cast<std::streamsize>(info.vertexCount * sizeof(PackedVertex) + info.triangleCount * 3));
+		return file.good();
+	}
+
+	int StreamedMesh::TakeSlot()
+	{
+		int oldestSlot{ -1 };
+		uint32_t oldestFrame{ m_Frame };
+		for (size_t i{}; i < m_SlotClusters.size(); ++i)
+		{
+			if (m_SlotClusters[i] == m_Clusters.size())
+				return static_cast<int>(i);
+
+			//clusters the last frame saw stay, so do the ones still being read
+			const Cluster& cluster{ m_Clusters[m_SlotClusters[i]] };
+			const uint32_t frame{ cluster.requestedFrame.load(std::memory_order_relaxed) };
+			if (!cluster.isLoading && frame < oldestFrame)
+			{
+				oldestSlot = static_cast<int>(i);
+				oldestFrame = frame;
+			}
+		}
+
+		if (oldestSlot >= 0)
+		{
+			m_Clusters[m_SlotClusters[oldestSlot]].slot = -1;
+			m_SlotClusters[oldestSlot] = static_cast<uint32_t>(m_Clusters.size());
+			--m_ResidentClusterCount;
+		}
+		return oldestSlot;
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <span>
+#include <string>
+#include <vector>
+#include <ppltasks.h>
+#include "ClusterCache.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	class MeshGeometry;
+
+	/**
+	 * \brief Software only mesh that keeps a fixed budget of clusters in memory, however large the mesh is.
+	 * Only the cluster table (bounds and where each cluster is) is read up front, the clusters are read from the
+	 * cluster cache (see WriteClusterCache) into a fixed pool of slots with their own reads on the thread pool.
+	 * Culling stamps every cluster inside the frustum with the current frame, that's the feedback Update loads from.
+	 * What isn't resident yet is simply not drawn, the mesh fills in over the next frames.
+	 */
+	class StreamedMesh final
+	{
+	public:
+		//Opens the cluster cache of path (path + ".clusters"), writes it out of the full level of detail of geometry first
+		//when there is no valid one. budget is the bytes of the cluster pool. nullptr when the cache can't be written.
+		//The cache is written in bounded chunks, a mapped geometry (MeshGeometry::LoadFromFile) is never read in whole.
+		static StreamedMesh* Create(const std::string& path, const MeshGeometry& geometry, size_t budget, bool flipAxisAndWinding = true);
+		//waits for the clusters still being read
+		~StreamedMesh();
+
+		StreamedMesh(const StreamedMesh&) = delete;
+		StreamedMesh(StreamedMesh&&) noexcept = delete;
+		StreamedMesh& operator=(const StreamedMesh&) = delete;
+		StreamedMesh& operator=(StreamedMesh&&) noexcept = delete;
+
+		//Call between frames: installs the clusters that were read, then starts reading the clusters the last frame saw,
+		//evicting the clusters that went unseen the longest
+		void Update();
+		//Blocks until every cluster being read is installed
+		void Flush();
+
+		/**
+		 * \brief Frustum culls every cluster against its bounds, in parallel, and asks for the visible ones.
+		 * \param outClusters the visible clusters that are resident, the only ones that may be drawn this frame
+		 */
+		void CullClusters(const Matrix& worldViewProjectionMatrix, std::vector<uint32_t>& outClusters) const;
+
+		//vertices and triangles of a resident cluster, the indices are local to the cluster
+		std::span<const PackedVertex> GetVertices(uint32_t cluster) const;
+		std::span<const uint8_t> GetIndices(uint32_t cluster) const;
+		const PositionQuantization& GetQuantization() const { return m_Quantization; };
+
+		size_t GetClusterCount() const { return m_Infos.size(); };
+		//Cluster pool, fixed from the start
+		size_t GetMemorySize() const { return m_SlotClusters.size() * GetMaxClusterSize(); };
+		int GetResidentClusterCount() const { return m_ResidentClusterCount; };
+		int GetClusterCapacity() const { return static_cast<int>(m_SlotClusters.size()); };
+
+	private:
+		struct Cluster
+		{
+			//last frame culling found this cluster inside the frustum, written by the culling threads
+			mutable std::atomic<uint32_t> requestedFrame{};
+			int slot{ -1 }; //only set while resident, changes in Update only
+			bool isLoading{ false };
+			bool isFailed{ false };
+		};
+
+		struct PendingCluster
+		{
+			concurrency::task<bool> load;
+			uint32_t cluster;
+			int slot;
+		};
+
+		//nullptr when path has no valid cluster cache
+		static StreamedMesh* Open(const std::string& path, size_t budget, bool flipAxisAndWinding);
+		StreamedMesh(const std::string& cachePath, const ClusterCacheHeader& header, std::vector<ClusterInfo> infos, size_t budget);
+
+		//hands the slots of the clusters that were read to the renderer
+		void InstallClusters();
+		//reads one cluster out of the cache into its slot, runs on the thread pool
+		bool ReadCluster(const ClusterInfo& info, uint8_t* pSlot) const;
+		//a free slot, or the one whose cluster went unseen the longest. -1 when every cluster was seen by the last frame.
+		int TakeSlot();
+
+		std::string m_CachePath{};
+		PositionQuantization m_Quantization{};
+		std::vector<ClusterInfo> m_Infos{};
+		std::vector<Cluster> m_Clusters;
+
+		//the pool, every slot holds one cluster laid out like in the cache
+		uint8_t* m_pSlots{ nullptr };
+		std::vector<uint32_t> m_SlotClusters{}; //cluster in each slot, m_Clusters.size() when free
+		int m_ResidentClusterCount{};
+
+		std::vector<PendingCluster> m_PendingClusters{};
+		uint32_t m_Frame{ 1 };
+	};
+}
@@ -1,24 +1,206 @@
 #include "pch.h"
 #include "Texture.h"
 #include "Vector2.h"
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include "TextureCache.h"
 #include <SDL_image.h>
 #include <iostream>
 #include <d3d11.h>
+#include <ppl.h>
+#include <fstream>
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels },
-		m_pDevice{ pDevice }
+	namespace
 	{
-		DXGI_FORMAT format{ DXGI_FORMAT_R8G8B8A8_UNORM };
+		//block compressed textures upload their blocks as is, the others upload RGBA8
+		DXGI_FORMAT GetDXGIFormat(TexelFormat format)
+		{
+			switch (format)
+			{
+			case TexelFormat::BC1:
+				return DXGI_FORMAT_BC1_UNORM;
+			case TexelFormat::BC3:
+				return DXGI_FORMAT_BC3_UNORM;
+			case TexelFormat::BC5:
+				return DXGI_FORMAT_BC5_UNORM;
+			default:
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			}
+		}
+
+		//Encodes a linear RGBA8 level into block rows, rows of blocks are compressed in parallel
+		template<typename Block>
+		void CompressLevel(const uint32_t* pSource, int width, int height, uint8_t* pDestination)
+		{
+			const int blocksPerRow{ (width + TexelBlockSize - 1) / TexelBlockSize };
+			const int blocksPerColumn{ (height + TexelBlockSize - 1) / TexelBlockSize };
+
+			concurrency::parallel_for(0, blocksPerColumn, [&](int blockY) {
+				uint32_t texels[BlockTexelCount];
+				for (int blockX{}; blockX < blocksPerRow; ++blockX)
+				{
+					//levels smaller than a block repeat their edge texels
+					for (int i{}; i < BlockTexelCount; ++i)
+					{
+						const int x{ std::min(blockX * TexelBlockSize + i % TexelBlockSize, width - 1) };
+						const int y{ std::min(blockY * TexelBlockSize + i / TexelBlockSize, height - 1) };
+						texels[i] = pSource[x + static_cast<size_t>(y) * width];
+					}
+					Block::Encode(texels, pDestination + (static_cast<size_t>(blockY) * blocksPerRow + blockX) * Block::Size);
+				}
+			});
+		}
+
+		ColorRGB UnpackColor(uint32_t texel)
+		{
+			ColorRGB color{ static_cast<float>(texel & 0xFF), static_cast<float>((texel >> 8) & 0xFF), static_cast<float>((texel >> 16) & 0xFF) };
+			return color / 255;
+		}
+
+		template<typename Block>
+		uint32_t FetchBlockTexel(const uint8_t* pLevel, int x, int y, int width)
+		{
+			const Block& block{ GetDecodedBlock<Block>(pLevel + GetBlockOffset(x, y, width, Block::Size)) };
+			return block.texels[(y % TexelBlockSize) * TexelBlockSize + x % TexelBlockSize];
+		}
+
+		//D3D only accepts block compressed textures made of whole blocks
+		TexelFormat GetStoredFormat(TexelFormat format, int width, int height)
+		{
+			if (IsBlockCompressed(format) && (width % TexelBlockSize != 0 || height % TexelBlockSize != 0))
+			{
+				std::cout << "Texture: " << width << "x" << height << " isn't a multiple of 4, keeping it uncompressed\n";
+				return TexelFormat::RGBA8;
+			}
+			return format;
+		}
+
+		//One linear RGBA8 level into the software copy's layout: BCn blocks, or RGBA reordered into 4x4 blocks.
+		//Float maps get converted once so sampling never scales bytes
+		void ConvertLevel(const uint32_t* pSource, int width, int height, TexelFormat format, uint8_t* pDestination)
+		{
+			switch (format)
+			{
+			case TexelFormat::BC1:
+				CompressLevel<BC1Block>(pSource, width, height, pDestination);
+				return;
+			case TexelFormat::BC3:
+				CompressLevel<BC3Block>(pSource, width, height, pDestination);
+				return;
+			case TexelFormat::BC5:
+				CompressLevel<BC5Block>(pSource, width, height, pDestination);
+				return;
+			default:
+				break;
+			}
+
+			concurrency::parallel_for(0, height, [&](int y) {
+				for (int x{}; x < width; ++x)
+				{
+					const uint32_t texel{ pSource[x + static_cast<size_t>(y) * width] };
+					const size_t index{ GetTiledIndex(x, y, width) };
+					if (format == TexelFormat::RGBA8)
+					{
+						reinterpret_cast<uint32_t*>(pDestination)[index] = texel;
+						continue;
+					}
+
+					float* pTexel{ reinterpret_cast<float*>(pDestination) + index * 4 };
+					for (int channel{}; channel < 4; ++channel)
+					{
+						pTexel[channel] = ((texel >> (channel * 8)) & 0xFF) / 255.f;
+					}
+				}
+			});
+		}
+
+		TextureCacheHeader CreateCacheHeader(TexelFormat requestedFormat, TexelFormat format, int width, int height, size_t dataSize, uint64_t sourceSize, int64_t sourceWriteTime)
+		{
+			TextureCacheHeader header{};
+			header.requestedFormat = static_cast<uint32_t>(requestedFormat);
+			header.format = static_cast<uint32_t>(format);
+			header.width = width;
+			header.height = height;
+			header.sourceSize = sourceSize;
+			header.sourceWriteTime = sourceWriteTime;
+			header.dataOffset = CacheDataOffset;
+			header.dataSize = dataSize;
+			return header;
+		}
+
+		void WriteCacheHeader(std::ofstream& file, const TextureCacheHeader& header)
+		{
+			const char padding[CacheDataOffset]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(padding, CacheDataOffset - sizeof(header));
+		}
+
+	}
+
+	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice, TexelFormat format) :
+		m_pDevice{ pDevice },
+		m_Format{ format }
+	{
+		//released again in the destructor, textures can outlive whoever created them
+		m_pDevice->AddRef();
+
+		//decode once into linear RGBA8, the surface isn't needed after this
+		std::vector<MipLevel> levels{};
+		uint8_t* pRGBA{ AllocateTexels(LayoutMipChain(pSurface->w, pSurface->h, GetTexelBlockSize(TexelFormat::RGBA8), levels)) };
+		for (int y{}; y < pSurface->h; ++y)
+		{
+			memcpy(pRGBA + static_cast<size_t>(y) * pSurface->w * 4, static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch, static_cast<size_t>(pSurface->w) * 4);
+		}
+		SDL_FreeSurface(pSurface);
+
+		//full mip chain, both the software sampler and the D3D texture use it
+		for (size_t i{ 1 }; i < levels.size(); ++i)
+		{
+			CreateNextMipLevel(pRGBA + levels[i - 1].offset, levels[i - 1].width, levels[i - 1].height,
+				pRGBA + levels[i].offset, levels[i].width, levels[i].height);
+		}
+
+		//software copy in the layout the sampler reads
+		m_Format = GetStoredFormat(m_Format, levels[0].width, levels[0].height);
+		m_MemorySize = LayoutMipChain(levels[0].width, levels[0].height, GetTexelBlockSize(m_Format), m_MipLevels);
+		m_pOwnedTexels = AllocateTexels(m_MemorySize);
+		m_pTexels = m_pOwnedTexels;
+		for (size_t i{}; i < levels.size(); ++i)
+		{
+			ConvertLevel(reinterpret_cast<const uint32_t*>(pRGBA + levels[i].offset), levels[i].width, levels[i].height, m_Format, m_pOwnedTexels + m_MipLevels[i].offset);
+		}
+
+		FreeTexels(pRGBA);
+
+		CreateResource();
+	}
+
+	Texture::Texture(MappedFile* pCacheFile, ID3D11Device* pDevice) :
+		m_pDevice{ pDevice },
+		m_pCacheFile{ pCacheFile }
+	{
+		m_pDevice->AddRef();
+
+		//the cache was validated before, its texels are used in place
+		const TextureCacheHeader& header{ *reinterpret_cast<const TextureCacheHeader*>(m_pCacheFile->GetData()) };
+		m_Format = static_cast<TexelFormat>(header.format);
+		m_MemorySize = LayoutMipChain(header.width, header.height, GetTexelBlockSize(m_Format), m_MipLevels);
+		m_pTexels = m_pCacheFile->GetData() + header.dataOffset;
+
+		CreateResource();
+	}
+
+	void Texture::CreateResource()
+	{
+		const DXGI_FORMAT dxgiFormat{ GetDXGIFormat(m_Format) };
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = m_pSurface->w;
-		desc.Height = m_pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = GetWidth(0);
+		desc.Height = GetHeight(0);
+		desc.MipLevels = static_cast<UINT>(m_MipLevels.size());
 		desc.ArraySize = 1;
-		desc.Format = format;
+		desc.Format = dxgiFormat;
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
 		desc.Usage = D3D11_USAGE_DEFAULT;
@@ -26,35 +208,97 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = m_pSurfacePixels;
-		initData.SysMemPitch = static_cast<UINT>(m_pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(m_pSurface->h * m_pSurface->pitch);
+		//compressed textures upload the very blocks the software sampler decodes, the others get untiled back into RGBA8 rows
+		std::vector<uint32_t> linearTexels{};
+		if (!IsBlockCompressed(m_Format))
+			linearTexels.resize(m_MemorySize / GetTexelBlockSize(m_Format) * BlockTexelCount);
+
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(m_MipLevels.size());
+		size_t linearOffset{};
+		for (size_t i{}; i < m_MipLevels.size(); ++i)
+		{
+			const int level{ static_cast<int>(i) };
+			const int width{ GetWidth(level) };
+			if (IsBlockCompressed(m_Format))
+			{
+				const size_t blocksPerRow{ static_cast<size_t>(width + TexelBlockSize - 1) / TexelBlockSize };
+				const size_t blocksPerColumn{ static_cast<size_t>(GetHeight(level) + TexelBlockSize - 1) / TexelBlockSize };
+				initData[i].pSysMem = GetLevelData(level);
+				initData[i].SysMemPitch = static_cast<UINT>(blocksPerRow * GetTexelBlockSize(m_Format));
+				initData[i].SysMemSlicePitch = static_cast<UINT>(blocksPerRow * blocksPerColumn * GetTexelBlockSize(m_Format));
+				continue;
+			}
+
+			uint32_t* pLinear{ linearTexels.data() + linearOffset };
+			concurrency::parallel_for(0, GetHeight(level), [&](int y) {
+				for (int x{}; x < width; ++x)
+				{
+					const size_t index{ GetTiledIndex(x, y, width) };
+					uint32_t& texel{ pLinear[x + static_cast<size_t>(y) * width] };
+					if (m_Format == TexelFormat::RGBA8)
+					{
+						texel = reinterpret_cast<const uint32_t*>(GetLevelData(level))[index];
+						continue;
+					}
 
-		HRESULT hr{ pDevice->CreateTexture2D(&desc, &initData, &m_pResource) };
+					const float* pTexel{ reinterpret_cast<const float*>(GetLevelData(level)) + index * 4 };
+					texel = 0;
+					for (int channel{}; channel < 4; ++channel)
+					{
+						texel |= static_cast<uint32_t>(pTexel[channel] * 255.f + 0.5f) << (channel * 8);
+					}
+				}
+			});
+			initData[i].pSysMem = pLinear;
+			initData[i].SysMemPitch = static_cast<UINT>(width * 4);
+			initData[i].SysMemSlicePitch = static_cast<UINT>(width * GetHeight(level) * 4);
+			linearOffset += static_cast<size_t>(width) * GetHeight(level);
+		}
+
+		HRESULT hr{ m_pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource) };
 		if (SUCCEEDED(hr)) {
 
 			D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
-			SRVDesc.Format = format;
+			SRVDesc.Format = dxgiFormat;
 			SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			SRVDesc.Texture2D.MipLevels = 1;
+			SRVDesc.Texture2D.MipLevels = desc.MipLevels;
 
 			hr = m_pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
-			//if (SUCCEEDED(hr)) {
-			//	SDL_FreeSurface(m_pSurface);
-			//	m_pSurface = nullptr;
-			//}
 		}
 	}
 
-	Texture::~Texture()
+	SDL_Surface* LoadRGBASurface(const std::string& path)
 	{
-		if (m_pSurface)
+		//Load SDL_Surface using IMG_LOAD
+		SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+		if (!loadedSurface)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			std::cout << "Texture: could not load " << path << '\n';
+			return nullptr;
 		}
 
+		//the D3D texture and the mip filter expect RGBA bytes, whatever the png was stored as
+		if (loadedSurface->format->format != SDL_PIXELFORMAT_RGBA32)
+		{
+			SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+			SDL_FreeSurface(loadedSurface);
+			loadedSurface = pConverted;
+		}
+		return loadedSurface;
+	}
+
+	Texture::~Texture()
+	{
+		//decoded blocks of this texture may still sit in the samplers' caches
+		if (IsBlockCompressed(m_Format))
+			InvalidateDecodedBlocks();
+		FreeTexels(m_pOwnedTexels);
+		m_pOwnedTexels = nullptr;
+		delete m_pCacheFile;
+		m_pCacheFile = nullptr;
+		m_pTexels = nullptr;
+		m_MipLevels.clear();
+
 		m_pSRV->Release();
 		m_pResource->Release();
 		m_pDevice->Release();
@@ -63,29 +307,163 @@ namespace dae
 		m_pDevice = nullptr;
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice)
+	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice, TexelFormat format, bool isSoftwareCopyKept)
 	{
-		//Load SDL_Surface using IMG_LOAD
-		SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		const bool hasSourceStamp{ GetSourceStamp(path, sourceSize, sourceWriteTime) };
+
+		//a cache from an earlier run is mapped and sampled in place, nothing gets decoded
+		if (hasSourceStamp)
+		{
+			MappedFile* pCacheFile{ new MappedFile{} };
+			if (pCacheFile->Open(GetTextureCachePath(path)) && pCacheFile->GetSize() >= sizeof(TextureCacheHeader)
+				&& IsValidTextureCache(*reinterpret_cast<const TextureCacheHeader*>(pCacheFile->GetData()), pCacheFile->GetSize(), format, sourceSize, sourceWriteTime))
+			{
+				Texture* pTexture{ new Texture{ pCacheFile, pDevice } };
+				if (!isSoftwareCopyKept)
+					pTexture->ReleaseSoftwareCopy();
+				return pTexture;
+			}
+			delete pCacheFile;
+		}
+
+		SDL_Surface* loadedSurface{ LoadRGBASurface(path) };
+		if (!loadedSurface)
+			return nullptr;
 
 		//Create & Return a new Texture Object (using SDL_Surface)
-		return new Texture{ loadedSurface, pDevice };
+		Texture* pTexture{ new Texture{ loadedSurface, pDevice, format } };
+		if (hasSourceStamp)
+			pTexture->WriteCache(GetTextureCachePath(path), format, sourceSize, sourceWriteTime);
+		if (!isSoftwareCopyKept)
+			pTexture->ReleaseSoftwareCopy();
+		return pTexture;
 	}
 
-	ColorRGB Texture::Sample(const Vector2& uv) const
+	bool Texture::WriteCacheFile(const std::string& path, TexelFormat format)
+	{
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		if (!GetSourceStamp(path, sourceSize, sourceWriteTime))
+		{
+			std::cout << "Texture: could not load " << path << '\n';
+			return false;
+		}
+
+		SDL_Surface* pSurface{ LoadRGBASurface(path) };
+		if (!pSurface)
+			return false;
+
+		const int width{ pSurface->w };
+		const int height{ pSurface->h };
+		const TexelFormat storedFormat{ GetStoredFormat(format, width, height) };
+		std::vector<MipLevel> levels{};
+		const size_t dataSize{ LayoutMipChain(width, height, GetTexelBlockSize(storedFormat), levels) };
+
+		//only the level being written and the next one are ever decoded at the same time
+		std::vector<uint32_t> level(static_cast<size_t>(width) * height);
+		for (int y{}; y < height; ++y)
+		{
+			memcpy(level.data() + static_cast<size_t>(y) * width, static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch, static_cast<size_t>(width) * 4);
+		}
+		SDL_FreeSurface(pSurface);
+
+		const std::string cachePath{ GetTextureCachePath(path) };
+		bool isWritten{};
+		{
+			std::ofstream file{ GetTemporaryCachePath(cachePath), std::ios::binary };
+			WriteCacheHeader(file, CreateCacheHeader(format, storedFormat, width, height, dataSize, sourceSize, sourceWriteTime));
+
+			std::vector<uint32_t> nextLevel{};
+			std::vector<uint8_t> levelTexels{};
+			for (size_t i{}; i < levels.size() && file; ++i)
+			{
+				//up to the next level's offset, the padding in between is written as zeros
+				levelTexels.assign((i + 1 < levels.size() ? levels[i + 1].offset : dataSize) - levels[i].offset, 0);
+				ConvertLevel(level.data(), levels[i].width, levels[i].height, storedFormat, levelTexels.data());
+				file.write(reinterpret_cast<const char*>(levelTexels.data()), static_cast<std::streamsize>(levelTexels.size()));
+
+				if (i + 1 == levels.size())
+					break;
+				nextLevel.resize(static_cast<size_t>(levels[i + 1].width) * levels[i + 1].height);
+				CreateNextMipLevel(reinterpret_cast<const uint8_t*>(level.data()), levels[i].width, levels[i].height,
+					reinterpret_cast<uint8_t*>(nextLevel.data()), levels[i + 1].width, levels[i + 1].height);
+				level.swap(nextLevel);
+			}
+			isWritten = file.good();
+		}
+		return CommitCacheFile(cachePath, isWritten);
+	}
+
+	void Texture::ReleaseSoftwareCopy()
+	{
+		if (IsBlockCompressed(m_Format))
+			InvalidateDecodedBlocks();
+		FreeTexels(m_pOwnedTexels);
+		m_pOwnedTexels = nullptr;
+		delete m_pCacheFile;
+		m_pCacheFile = nullptr;
+		m_pTexels = nullptr;
+		m_MemorySize = 0;
+	}
+
+	void Texture::WriteCache(const std::string& cachePath, TexelFormat requestedFormat, uint64_t sourceSize, int64_t sourceWriteTime) const
+	{
+		bool isWritten{};
+		{
+			std::ofstream file{ GetTemporaryCachePath(cachePath), std::ios::binary };
+			WriteCacheHeader(file, CreateCacheHeader(requestedFormat, m_Format, GetWidth(0), GetHeight(0), m_MemorySize, sourceSize, sourceWriteTime));
+			file.write(reinterpret_cast<const char*>(m_pTexels), static_cast<std::streamsize>(m_MemorySize));
+			isWritten = file.good();
+		}
+		CommitCacheFile(cachePath, isWritten);
+	}
+
+	Texture* Texture::CreateSolid(const ColorRGB& color, float alpha, ID3D11Device* pDevice)
 	{
-		SDL_Color rgb{};
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormat(0, TexelBlockSize, TexelBlockSize, 32, SDL_PIXELFORMAT_RGBA32) };
+		if (!pSurface)
+			return nullptr;
 
-		//convert from 0,1 to 0,width;
-		const int x{ static_cast<int>(uv.x * m_pSurface->w) };
-		const int y{ static_cast<int>(uv.y * m_pSurface->h) };
+		const auto toByte = [](float value) { return static_cast<uint32_t>(Clamp(value, 0.f, 1.f) * 255.f + 0.5f); };
+		const uint32_t texel{ toByte(color.r) | toByte(color.g) << 8 | toByte(color.b) << 16 | toByte(alpha) << 24 };
+		for (int y{}; y < pSurface->h; ++y)
+		{
+			uint32_t* pRow{ reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pSurface->pixels) + y * pSurface->pitch) };
+			std::fill(pRow, pRow + pSurface->w, texel);
+		}
+		return new Texture{ pSurface, pDevice, TexelFormat::RGBA8 };
+	}
 
-		//Sample the correct data for the given uv
-		const Uint32 p = m_pSurfacePixels[x + y * m_pSurface->w];
-		SDL_GetRGB(p, m_pSurface->format, &rgb.r, &rgb.g, &rgb.b);
+	ColorRGB Texture::Sample(const Vector2& uv) const
+	{
+		//convert from 0,1 to 0,width; and keep uv = 1 on the last texel
+		const int x{ Clamp(static_cast<int>(uv.x * GetWidth(0)), 0, GetWidth(0) - 1) };
+		const int y{ Clamp(static_cast<int>(uv.y * GetHeight(0)), 0, GetHeight(0) - 1) };
 
-		//change color from range 0,255 to 0,1
-		ColorRGB rgb2{ rgb.r, rgb.g, rgb.b };
-		return rgb2 / 255;
+		return FetchTexel(0, x, y);
+	}
+
+	ColorRGB Texture::FetchTexel(int level, int x, int y) const
+	{
+		const uint8_t* pLevel{ GetLevelData(level) };
+		const int width{ GetWidth(level) };
+		switch (m_Format)
+		{
+		case TexelFormat::BC1:
+			return UnpackColor(FetchBlockTexel<BC1Block>(pLevel, x, y, width));
+		case TexelFormat::BC3:
+			return UnpackColor(FetchBlockTexel<BC3Block>(pLevel, x, y, width));
+		case TexelFormat::BC5:
+			return UnpackColor(FetchBlockTexel<BC5Block>(pLevel, x, y, width));
+		case TexelFormat::RGBA32F: {
+			const float* pTexel{ reinterpret_cast<const float*>(pLevel) + GetTiledIndex(x, y, width) * 4 };
+			return { pTexel[0], pTexel[1], pTexel[2] };
+		}
+		case TexelFormat::RGBA8:
+		default:
+			return UnpackColor(reinterpret_cast<const uint32_t*>(pLevel)[GetTiledIndex(x, y, width)]);
+		}
 	}
-}
\ No newline at end of file
+}
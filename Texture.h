@@ -1,28 +1,83 @@
 #pragma once
 #include <SDL_surface.h>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "MipChain.h"
 
 namespace dae
 {
 	struct Vector2;
+	class MappedFile;
+
+	//How the software copy of a texture is stored, picked per map at load
+	enum class TexelFormat {
+		RGBA8, //4 bytes per texel, r g b a
+		RGBA32F, //4 floats in [0, 1] per texel, 16 byte aligned so one SSE load fetches a texel
+		BC1, //rgb, half a byte per texel
+		BC3, //rgba, 1 byte per texel
+		BC5 //rg only, 1 byte per texel. Meant for tangent space normals, z is rebuilt from x and y
+	};
+
+	inline bool IsBlockCompressed(TexelFormat format)
+	{
+		return format == TexelFormat::BC1 || format == TexelFormat::BC3 || format == TexelFormat::BC5;
+	}
+
+	//The png as RGBA8 bytes row by row, nullptr when it can't be loaded. Freed with SDL_FreeSurface.
+	SDL_Surface* LoadRGBASurface(const std::string& path);
 
 	class Texture
 	{
 	public:
 		~Texture();
 
-		static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice);
+		//The decoded mip chain is cached next to the file (path + ".texcache") and validated against its size and write time.
+		//Later loads map that cache and sample it in place instead of decoding the png again.
+		//Without isSoftwareCopyKept only the D3D texture stays, the texture can't be sampled in software then.
+		static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice, TexelFormat format = TexelFormat::RGBA8, bool isSoftwareCopyKept = true);
+		//Writes the cache of path without making a Texture: the levels are filtered, converted and written one after the other,
+		//so the whole software copy is never in memory. That's the cache VirtualTexture pages from.
+		static bool WriteCacheFile(const std::string& path, TexelFormat format);
+		//4x4 texels of one color, stands in for a texture that is still loading
+		static Texture* CreateSolid(const ColorRGB& color, float alpha, ID3D11Device* pDevice);
 		ID3D11ShaderResourceView* GetSRV() { return m_pSRV; };
+		//Nearest texel of level 0, uv clamped to [0, 1]. Filtered sampling goes through TextureSampler.
 		ColorRGB Sample(const Vector2& uv) const;
 
+		TexelFormat GetFormat() const { return m_Format; };
+		int GetMipCount() const { return static_cast<int>(m_MipLevels.size()); };
+		int GetWidth(int level) const { return m_MipLevels[level].width; };
+		int GetHeight(int level) const { return m_MipLevels[level].height; };
+		//Texels of a level in 4x4 blocks, see GetTiledIndex, or the level's BCn blocks row by row
+		const uint8_t* GetLevelData(int level) const { return m_pTexels + m_MipLevels[level].offset; };
+		//Bytes of the software copy, all mip levels included, mapped or allocated
+		size_t GetMemorySize() const { return m_MemorySize; };
+		//x and y must already be inside the level, the sampler applies the address mode
+		ColorRGB FetchTexel(int level, int x, int y) const;
+
 	private:
-		Texture(SDL_Surface* pSurface, ID3D11Device* pDevice);
+		Texture(SDL_Surface* pSurface, ID3D11Device* pDevice, TexelFormat format);
+		//takes ownership of an already validated cache file
+		Texture(MappedFile* pCacheFile, ID3D11Device* pDevice);
+
+		//D3D texture + view from the software copy
+		void CreateResource();
+		void WriteCache(const std::string& cachePath, TexelFormat requestedFormat, uint64_t sourceSize, int64_t sourceWriteTime) const;
+		//the D3D texture has its own copy, the mip levels stay for the sizes
+		void ReleaseSoftwareCopy();
 
 		ID3D11ShaderResourceView* m_pSRV{ nullptr };
 		ID3D11Texture2D* m_pResource{ nullptr };
 		ID3D11Device* m_pDevice{ nullptr };
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+
+		TexelFormat m_Format{ TexelFormat::RGBA8 };
+		//every level halves the size down to 1x1, all of them live in m_pTexels
+		std::vector<MipLevel> m_MipLevels{};
+		//points into either m_pOwnedTexels or the mapped cache file
+		const uint8_t* m_pTexels{ nullptr };
+		uint8_t* m_pOwnedTexels{ nullptr };
+		MappedFile* m_pCacheFile{ nullptr };
+		size_t m_MemorySize{};
 	};
-}
\ No newline at end of file
+}
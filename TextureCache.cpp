@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include "BlockCompression.h"
+#include "MaterialTexture.h"
+#include <filesystem>
+
+namespace dae
+{
+	std::string GetTextureCachePath(const std::string& path)
+	{
+		return path + ".texcache";
+	}
+
+	std::string GetMaterialCachePath(const std::string& diffusePath)
+	{
+		return diffusePath + ".material";
+	}
+
+	bool GetSourceStamp(const std::string& path, uint64_t& outSize, int64_t& outWriteTime)
+	{
+		std::error_code error{};
+		outSize = std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+		outWriteTime = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+	std::string GetTemporaryCachePath(const std::string& cachePath)
+	{
+		return cachePath + ".tmp";
+	}
+
+	bool CommitCacheFile(const std::string& cachePath, bool isWritten)
+	{
+		const std::string temporaryPath{ GetTemporaryCachePath(cachePath) };
+		std::error_code error{};
+		if (isWritten)
+			std::filesystem::rename(temporaryPath, cachePath, error);
+		if (!isWritten || error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			std::cout << "Cache: could not write " << cachePath << '\n';
+			return false;
+		}
+		return true;
+	}
+
+	bool IsValidTextureCache(const TextureCacheHeader& header, uint64_t fileSize, TexelFormat requestedFormat, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		if (header.magic != TextureCacheHeader::Magic || header.version != TextureCacheHeader::Version
+			|| header.requestedFormat != static_cast<uint32_t>(requestedFormat)
+			|| header.sourceSize != sourceSize || header.sourceWriteTime != sourceWriteTime)
+			return false;
+
+		if (header.format > static_cast<uint32_t>(TexelFormat::BC5) || header.width <= 0 || header.height <= 0 || header.dataOffset % CacheDataOffset != 0)
+			return false;
+
+		std::vector<MipLevel> levels{};
+		const uint64_t dataSize{ LayoutMipChain(header.width, header.height, GetTexelBlockSize(static_cast<TexelFormat>(header.format)), levels) };
+		return header.dataSize == dataSize && header.dataOffset + dataSize <= fileSize;
+	}
+
+	bool IsValidMaterialCache(const MaterialCacheHeader& header, uint64_t fileSize, const uint64_t (&sourceSizes)[4], const int64_t (&sourceWriteTimes)[4])
+	{
+		if (header.magic != MaterialCacheHeader::Magic || header.version != MaterialCacheHeader::Version)
+			return false;
+		for (int i{}; i < 4; ++i)
+		{
+			if (header.sourceSizes[i] != sourceSizes[i] || header.sourceWriteTimes[i] != sourceWriteTimes[i])
+				return false;
+		}
+
+		if (header.width <= 0 || header.height <= 0 || header.dataOffset % CacheDataOffset != 0 || header.dataOffset < sizeof(MaterialCacheHeader))
+			return false;
+
+		std::vector<MipLevel> levels{};
+		const uint64_t dataSize{ LayoutMipChain(header.width, header.height, MaterialTexture::BlockSize, levels) };
+		return header.dataSize == dataSize && header.dataOffset <= fileSize && dataSize <= fileSize - header.dataOffset;
+	}
+
+	size_t GetTexelBlockSize(TexelFormat format)
+	{
+		switch (format)
+		{
+		case TexelFormat::RGBA32F:
+			return BlockTexelCount * 16;
+		case TexelFormat::BC1:
+			return BC1Block::Size;
+		case TexelFormat::BC3:
+			return BC3Block::Size;
+		case TexelFormat::BC5:
+			return BC5Block::Size;
+		case TexelFormat::RGBA8:
+		default:
+			return BlockTexelCount * 4;
+		}
+	}
+}
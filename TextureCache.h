@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Texture.h"
+
+namespace dae
+{
+	//[TextureCacheHeader][zeros up to dataOffset][the mip chain exactly as LayoutMipChain places it]
+	//Written by Texture::LoadFromFile next to the source, read back by Texture and paged in by VirtualTexture.
+	struct TextureCacheHeader
+	{
+		static constexpr uint32_t Magic{ 0x43584554 }; //"TEXC"
+		static constexpr uint32_t Version{ 1 };
+
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		uint32_t requestedFormat{}; //what the cache was loaded as
+		uint32_t format{}; //what the texels are stored as, RGBA8 when BCn wasn't possible
+		int32_t width{};
+		int32_t height{};
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		uint64_t dataOffset{};
+		uint64_t dataSize{};
+	};
+
+	//the texels start on a cache line, a mapped view itself is page aligned
+	constexpr uint64_t CacheDataOffset{ 64 };
+	static_assert(sizeof(TextureCacheHeader) <= CacheDataOffset, "the cache header must fit before the texels");
+
+	//[MaterialCacheHeader][zeros up to dataOffset][the material mip chain exactly as LayoutMipChain places it]
+	//Written by MaterialTexture::LoadFromFiles next to the diffuse map, only valid while none of the four maps changed.
+	struct MaterialCacheHeader
+	{
+		static constexpr uint32_t Magic{ 0x4C54414D }; //"MATL"
+		static constexpr uint32_t Version{ 1 };
+
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		int32_t width{};
+		int32_t height{};
+		//diffuse, gloss, normal, specular
+		uint64_t sourceSizes[4]{};
+		int64_t sourceWriteTimes[4]{};
+		uint64_t dataOffset{};
+		uint64_t dataSize{};
+	};
+
+	std::string GetTextureCachePath(const std::string& path);
+	std::string GetMaterialCachePath(const std::string& diffusePath);
+	//a cache is only valid for the exact source file it was made from
+	bool GetSourceStamp(const std::string& path, uint64_t& outSize, int64_t& outWriteTime);
+	//Every cache is written under this name first and only renamed to cachePath by CommitCacheFile once it's complete,
+	//a half written cache must never look valid
+	std::string GetTemporaryCachePath(const std::string& cachePath);
+	//Renames the temporary file to cachePath, or removes it when it wasn't written completely
+	bool CommitCacheFile(const std::string& cachePath, bool isWritten);
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+	//fileSize is the size of the whole cache file, the header must already have been read from it
+	bool IsValidTextureCache(const TextureCacheHeader& header, uint64_t fileSize, TexelFormat requestedFormat, uint64_t sourceSize, int64_t sourceWriteTime);
+	bool IsValidMaterialCache(const MaterialCacheHeader& header, uint64_t fileSize, const uint64_t (&sourceSizes)[4], const int64_t (&sourceWriteTimes)[4]);
+
+	//bytes of one 4x4 block of the software copy
+	size_t GetTexelBlockSize(TexelFormat format);
+}
@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "TextureRegistry.h"
+#include <filesystem>
+
+namespace dae
+{
+	TextureRegistry::TextureRegistry(ID3D11Device* pDevice) :
+		m_pDevice{ pDevice }
+	{
+	}
+
+	TextureRegistry::~TextureRegistry()
+	{
+		//the loads write their entry when they finish, wait outside the lock
+		std::vector<concurrency::task<TextureHandle>> loads{};
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			for (const auto& [key, entry] : m_Entries)
+			{
+				if (entry.isLoading)
+					loads.push_back(entry.load);
+			}
+		}
+		for (const concurrency::task<TextureHandle>& load : loads)
+			load.wait();
+	}
+
+	concurrency::task<TextureHandle> TextureRegistry::LoadAsync(const std::string& path, TexelFormat format, bool isSoftwareCopyKept)
+	{
+		const std::string key{ GetKey(path, format, isSoftwareCopyKept) };
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		Entry& entry{ m_Entries[key] };
+		if (entry.isLoading)
+			return entry.load;
+		if (TextureHandle pTexture{ entry.texture.lock() })
+			return concurrency::task_from_result(pTexture);
+
+		//the first request for this key loads it, the entry's node stays put however the map grows
+		ID3D11Device* pDevice{ m_pDevice };
+		entry.isLoading = true;
+		entry.load = concurrency::create_task([this, &entry, path, format, isSoftwareCopyKept, pDevice] {
+			const TextureHandle pTexture{ Texture::LoadFromFile(path, pDevice, format, isSoftwareCopyKept) };
+
+			//a failed load leaves the entry empty, the next request tries again
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			entry.texture = pTexture;
+			entry.load = {};
+			entry.isLoading = false;
+			return pTexture;
+		});
+		return entry.load;
+	}
+
+	TextureHandle TextureRegistry::Load(const std::string& path, TexelFormat format, bool isSoftwareCopyKept)
+	{
+		return LoadAsync(path, format, isSoftwareCopyKept).get();
+	}
+
+	size_t TextureRegistry::GetTextureCount() const
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		size_t count{};
+		for (const auto& [key, entry] : m_Entries)
+		{
+			if (!entry.texture.expired())
+				++count;
+		}
+		return count;
+	}
+
+	size_t TextureRegistry::GetMemorySize() const
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		size_t size{};
+		for (const auto& [key, entry] : m_Entries)
+		{
+			if (const TextureHandle pTexture{ entry.texture.lock() })
+				size += pTexture->GetMemorySize();
+		}
+		return size;
+	}
+
+	std::string TextureRegistry::GetKey(const std::string& path, TexelFormat format, bool isSoftwareCopyKept)
+	{
+		//"Resources/a.png", "./Resources/a.png" and "resources\\A.PNG" are the same file on Windows
+		std::error_code error{};
+		const std::filesystem::path absolutePath{ std::filesystem::absolute(path, error) };
+		std::filesystem::path canonicalPath{ std::filesystem::weakly_canonical(absolutePath, error) };
+		if (error)
+			canonicalPath = absolutePath.lexically_normal();
+
+		std::string key{ canonicalPath.generic_string() };
+		std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return key + '|' + std::to_string(static_cast<int>(format)) + (isSoftwareCopyKept ? "" : "|gpu");
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <ppltasks.h>
+#include "Texture.h"
+
+namespace dae
+{
+	//Shared ownership of a texture, it's freed together with its last handle
+	using TextureHandle = std::shared_ptr<Texture>;
+
+	//Hands out one texture per canonical path and format, however many meshes or materials ask for it.
+	//A texture is decoded and uploaded once: later requests share the loaded texture, requests made while it's still
+	//loading share that load. The registry only keeps weak references, the texture goes away with its last handle.
+	class TextureRegistry final
+	{
+	public:
+		explicit TextureRegistry(ID3D11Device* pDevice);
+		//waits for the loads that are still running
+		~TextureRegistry();
+
+		TextureRegistry(const TextureRegistry&) = delete;
+		TextureRegistry(TextureRegistry&&) noexcept = delete;
+		TextureRegistry& operator=(const TextureRegistry&) = delete;
+		TextureRegistry& operator=(TextureRegistry&&) noexcept = delete;
+
+		//Starts the load on the thread pool unless it's already loaded or loading. The handle is nullptr when the file can't be loaded.
+		//A texture loaded without its software copy is a different entry than the same file loaded with it.
+		concurrency::task<TextureHandle> LoadAsync(const std::string& path, TexelFormat format = TexelFormat::RGBA8, bool isSoftwareCopyKept = true);
+		//Same, blocks until the texture is there
+		TextureHandle Load(const std::string& path, TexelFormat format = TexelFormat::RGBA8, bool isSoftwareCopyKept = true);
+
+		//Textures that are alive, and the bytes of their software copies
+		size_t GetTextureCount() const;
+		size_t GetMemorySize() const;
+
+	private:
+		struct Entry
+		{
+			std::weak_ptr<Texture> texture{};
+			//only set while loading, a finished task would keep its texture alive
+			concurrency::task<TextureHandle> load{};
+			bool isLoading{ false };
+		};
+
+		//the canonical path plus everything that changes what gets loaded
+		static std::string GetKey(const std::string& path, TexelFormat format, bool isSoftwareCopyKept);
+
+		ID3D11Device* m_pDevice{ nullptr };
+		mutable std::mutex m_Mutex{};
+		std::unordered_map<std::string, Entry> m_Entries{};
+	};
+}
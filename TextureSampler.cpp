@@ -0,0 +1,649 @@
+#include "pch.h"
+#include "TextureSampler.h"
+#include "BlockCompression.h"
+
+namespace dae
+{
+	namespace
+	{
+		//SSE2 has no floor, truncate and step down where that rounded up.
+		//From 2^23 on every float is integral already, past 2^31 the truncation would give INT_MIN, those stay as they are.
+		__m128 Floor(__m128 values)
+		{
+			const __m128 truncated{ _mm_cvtepi32_ps(_mm_cvttps_epi32(values)) };
+			const __m128 floored{ _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, values), _mm_set1_ps(1.f))) };
+			const __m128 magnitude{ _mm_andnot_ps(_mm_set1_ps(-0.f), values) };
+			const __m128 isIntegral{ _mm_cmpge_ps(magnitude, _mm_set1_ps(8388608.f)) };
+			return _mm_or_ps(_mm_and_ps(isIntegral, values), _mm_andnot_ps(isIntegral, floored));
+		}
+
+		//r, g, b, a of a packed RGBA8 texel, scaled to [0, 1]
+		__m128 UnpackRGBA8(uint32_t packed)
+		{
+			const __m128i zero{ _mm_setzero_si128() };
+			const __m128i channels{ _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed)), zero), zero) };
+			return _mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(1.f / 255.f));
+		}
+
+		//a filtered value for the 4 pixels of a quad, channel by channel: lane i of every channel is pixel i
+		template<int RegisterCount>
+		struct QuadChannels
+		{
+			__m128 channels[RegisterCount * 4];
+		};
+
+		template<int RegisterCount>
+		QuadChannels<RegisterCount> QuadMulAdd(const QuadChannels<RegisterCount>& sum, const QuadChannels<RegisterCount>& value, __m128 weights)
+		{
+			QuadChannels<RegisterCount> result{};
+			for (int i{}; i < RegisterCount * 4; ++i)
+				result.channels[i] = _mm_add_ps(sum.channels[i], _mm_mul_ps(value.channels[i], weights));
+			return result;
+		}
+
+		//one register of each pixel in, its channels across the pixels out
+		void TransposeInto(__m128 pixel0, __m128 pixel1, __m128 pixel2, __m128 pixel3, __m128* pChannels)
+		{
+			_MM_TRANSPOSE4_PS(pixel0, pixel1, pixel2, pixel3);
+			pChannels[0] = pixel0;
+			pChannels[1] = pixel1;
+			pChannels[2] = pixel2;
+			pChannels[3] = pixel3;
+		}
+
+		template<typename Block>
+		const Block& GetBlock(const uint8_t* pTexels, int width, int x, int y)
+		{
+			return GetDecodedBlock<Block>(pTexels + GetBlockOffset(x, y, width, Block::Size));
+		}
+
+		int GetBlockTexelIndex(int x, int y)
+		{
+			return (y % TexelBlockSize) * TexelBlockSize + x % TexelBlockSize;
+		}
+
+		//r, g, b, a in [0, 1], every layout addresses its texels through GetTiledIndex
+		struct RGBA8Texels
+		{
+			using Source = Texture;
+			using Value = __m128;
+
+			static Value Load(const uint8_t* pTexels, int width, int x, int y)
+			{
+				return UnpackRGBA8(reinterpret_cast<const uint32_t*>(pTexels)[GetTiledIndex(x, y, width)]);
+			}
+			static Value Zero() { return _mm_setzero_ps(); }
+			static Value MulAdd(Value sum, Value value, __m128 weight) { return _mm_add_ps(sum, _mm_mul_ps(value, weight)); }
+
+			//r, g, b, a across the pixels
+			using Quad = QuadChannels<1>;
+			static Quad Transpose(Value pixel0, Value pixel1, Value pixel2, Value pixel3)
+			{
+				Quad quad{};
+				TransposeInto(pixel0, pixel1, pixel2, pixel3, quad.channels);
+				return quad;
+			}
+		};
+
+		//already floats, one aligned load per texel
+		struct RGBA32FTexels : RGBA8Texels
+		{
+			static Value Load(const uint8_t* pTexels, int width, int x, int y)
+			{
+				return _mm_load_ps(reinterpret_cast<const float*>(pTexels) + GetTiledIndex(x, y, width) * 4);
+			}
+		};
+
+		//BCn: the texel's block is decoded once into this thread's block cache, the other taps in it are plain loads
+		template<typename Block>
+		struct BlockTexels : RGBA8Texels
+		{
+			static Value Load(const uint8_t* pTexels, int width, int x, int y)
+			{
+				return UnpackRGBA8(GetBlock<Block>(pTexels, width, x, y).texels[GetBlockTexelIndex(x, y)]);
+			}
+		};
+
+		//the three blocks of a material block, decoded together
+		struct MaterialBlock
+		{
+			static constexpr size_t Size{ MaterialTexture::BlockSize };
+			BC3Block diffuseGloss;
+			BC5Block normal;
+			BC1Block specular;
+
+			static void Decode(const uint8_t* pBlock, MaterialBlock& outBlock)
+			{
+				BC3Block::Decode(pBlock + MaterialTexture::DiffuseGlossOffset, outBlock.diffuseGloss);
+				BC5Block::Decode(pBlock + MaterialTexture::NormalOffset, outBlock.normal);
+				BC1Block::Decode(pBlock + MaterialTexture::SpecularOffset, outBlock.specular);
+			}
+		};
+
+		//a material texel decoded into three registers so they filter like any color
+		struct MaterialTexels
+		{
+			using Source = MaterialTexture;
+			struct Value
+			{
+				__m128 diffuseGloss;
+				__m128 specular;
+				__m128 normal; //x, y, 0, 0
+			};
+
+			static Value Load(const uint8_t* pTexels, int width, int x, int y)
+			{
+				const MaterialBlock& block{ GetBlock<MaterialBlock>(pTexels, width, x, y) };
+				const int index{ GetBlockTexelIndex(x, y) };
+
+				//normal x and y are stored as v * 0.5 + 0.5
+				const __m128 normal{ _mm_mul_ps(UnpackRGBA8(block.normal.texels[index]), _mm_setr_ps(2.f, 2.f, 0.f, 0.f)) };
+				return {
+					UnpackRGBA8(block.diffuseGloss.texels[index]),
+					UnpackRGBA8(block.specular.texels[index]),
+					_mm_sub_ps(normal, _mm_setr_ps(1.f, 1.f, 0.f, 0.f))
+				};
+			}
+			static Value Zero() { return { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() }; }
+			static Value MulAdd(const Value& sum, const Value& value, __m128 weight)
+			{
+				return {
+					_mm_add_ps(sum.diffuseGloss, _mm_mul_ps(value.diffuseGloss, weight)),
+					_mm_add_ps(sum.specular, _mm_mul_ps(value.specular, weight)),
+					_mm_add_ps(sum.normal, _mm_mul_ps(value.normal, weight))
+				};
+			}
+
+			//diffuse r, g, b, gloss, specular r, g, b, -, normal x, y, -, - across the pixels
+			using Quad = QuadChannels<3>;
+			static Quad Transpose(const Value& pixel0, const Value& pixel1, const Value& pixel2, const Value& pixel3)
+			{
+				Quad quad{};
+				TransposeInto(pixel0.diffuseGloss, pixel1.diffuseGloss, pixel2.diffuseGloss, pixel3.diffuseGloss, quad.channels);
+				TransposeInto(pixel0.specular, pixel1.specular, pixel2.specular, pixel3.specular, quad.channels + 4);
+				TransposeInto(pixel0.normal, pixel1.normal, pixel2.normal, pixel3.normal, quad.channels + 8);
+				return quad;
+			}
+		};
+
+		//Any of the layouts above, paged: the texel is looked up in the page it's in, or in a coarser resident level
+		template<typename Texels>
+		struct VirtualTexels : Texels
+		{
+			using Source = VirtualTexture;
+
+			static typename Texels::Value Load(const VirtualTexture::LevelData& level, int, int x, int y)
+			{
+				int width{};
+				const uint8_t* pTexels{ level.pTexture->Resolve(level.level, x, y, width) };
+				return Texels::Load(pTexels, width, x, y);
+			}
+		};
+
+		//squared footprint lengths of ddx and ddy, in level 0 texels
+		template<typename Source>
+		void GetFootprint(const Source& texture, const Vector2& ddx, const Vector2& ddy, float& outLengthX, float& outLengthY)
+		{
+			const float width{ static_cast<float>(texture.GetWidth(0)) };
+			const float height{ static_cast<float>(texture.GetHeight(0)) };
+			outLengthX = Square(ddx.x * width) + Square(ddx.y * height);
+			outLengthY = Square(ddy.x * width) + Square(ddy.y * height);
+		}
+
+		void StoreColors(const QuadChannels<1>& quad, ColorRGB (&outColors)[4])
+		{
+			alignas(16) float r[4];
+			alignas(16) float g[4];
+			alignas(16) float b[4];
+			_mm_store_ps(r, quad.channels[0]);
+			_mm_store_ps(g, quad.channels[1]);
+			_mm_store_ps(b, quad.channels[2]);
+			for (int i{}; i < 4; ++i)
+				outColors[i] = { r[i], g[i], b[i] };
+		}
+	}
+
+	TextureSampler::TextureSampler(SampleMode sampleMode, AddressMode addressMode, int maxAnisotropy) :
+		m_SampleMode{ sampleMode },
+		m_AddressMode{ addressMode },
+		m_MaxAnisotropy{ Clamp(maxAnisotropy, 1, MaxAnisotropy) }
+	{
+	}
+
+	ColorRGB TextureSampler::Sample(const Texture& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		__m128 color{};
+		switch (texture.GetFormat())
+		{
+		case TexelFormat::RGBA32F:
+			color = SampleFiltered<RGBA32FTexels>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC1:
+			color = SampleFiltered<BlockTexels<BC1Block>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC3:
+			color = SampleFiltered<BlockTexels<BC3Block>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC5:
+			color = SampleFiltered<BlockTexels<BC5Block>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::RGBA8:
+		default:
+			color = SampleFiltered<RGBA8Texels>(texture, uv, ddx, ddy);
+			break;
+		}
+
+		alignas(16) float rgba[4];
+		_mm_store_ps(rgba, color);
+		return { rgba[0], rgba[1], rgba[2] };
+	}
+
+	ColorRGB TextureSampler::Sample(const VirtualTexture& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		__m128 color{};
+		switch (texture.GetFormat())
+		{
+		case TexelFormat::RGBA32F:
+			color = SampleFiltered<VirtualTexels<RGBA32FTexels>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC1:
+			color = SampleFiltered<VirtualTexels<BlockTexels<BC1Block>>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC3:
+			color = SampleFiltered<VirtualTexels<BlockTexels<BC3Block>>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::BC5:
+			color = SampleFiltered<VirtualTexels<BlockTexels<BC5Block>>>(texture, uv, ddx, ddy);
+			break;
+		case TexelFormat::RGBA8:
+		default:
+			color = SampleFiltered<VirtualTexels<RGBA8Texels>>(texture, uv, ddx, ddy);
+			break;
+		}
+
+		alignas(16) float rgba[4];
+		_mm_store_ps(rgba, color);
+		return { rgba[0], rgba[1], rgba[2] };
+	}
+
+	MaterialSample TextureSampler::Sample(const MaterialTexture& material, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		const MaterialTexels::Value value{ SampleFiltered<MaterialTexels>(material, uv, ddx, ddy) };
+
+		alignas(16) float diffuseGloss[4];
+		alignas(16) float specular[4];
+		alignas(16) float normal[4];
+		_mm_store_ps(diffuseGloss, value.diffuseGloss);
+		_mm_store_ps(specular, value.specular);
+		_mm_store_ps(normal, value.normal);
+
+		//z is positive in tangent space, rebuild it after filtering
+		const float normalZ{ std::sqrt(std::max(1.f - normal[0] * normal[0] - normal[1] * normal[1], 0.f)) };
+		const Vector3 tangentNormal{ normal[0], normal[1], normalZ };
+
+		return {
+			{ diffuseGloss[0], diffuseGloss[1], diffuseGloss[2] },
+			diffuseGloss[3],
+			{ specular[0], specular[1], specular[2] },
+			tangentNormal.SqrMagnitude() > 0.f ? tangentNormal.Normalized() : Vector3{ 0.f, 0.f, 1.f }
+		};
+	}
+
+	void TextureSampler::Sample(const Texture& texture, const Vector2 (&uvs)[4], ColorRGB (&outColors)[4]) const
+	{
+		QuadChannels<1> color{};
+		switch (texture.GetFormat())
+		{
+		case TexelFormat::RGBA32F:
+			color = SampleQuadFiltered<RGBA32FTexels>(texture, uvs);
+			break;
+		case TexelFormat::BC1:
+			color = SampleQuadFiltered<BlockTexels<BC1Block>>(texture, uvs);
+			break;
+		case TexelFormat::BC3:
+			color = SampleQuadFiltered<BlockTexels<BC3Block>>(texture, uvs);
+			break;
+		case TexelFormat::BC5:
+			color = SampleQuadFiltered<BlockTexels<BC5Block>>(texture, uvs);
+			break;
+		case TexelFormat::RGBA8:
+		default:
+			color = SampleQuadFiltered<RGBA8Texels>(texture, uvs);
+			break;
+		}
+		StoreColors(color, outColors);
+	}
+
+	void TextureSampler::Sample(const VirtualTexture& texture, const Vector2 (&uvs)[4], ColorRGB (&outColors)[4]) const
+	{
+		QuadChannels<1> color{};
+		switch (texture.GetFormat())
+		{
+		case TexelFormat::RGBA32F:
+			color = SampleQuadFiltered<VirtualTexels<RGBA32FTexels>>(texture, uvs);
+			break;
+		case TexelFormat::BC1:
+			color = SampleQuadFiltered<VirtualTexels<BlockTexels<BC1Block>>>(texture, uvs);
+			break;
+		case TexelFormat::BC3:
+			color = SampleQuadFiltered<VirtualTexels<BlockTexels<BC3Block>>>(texture, uvs);
+			break;
+		case TexelFormat::BC5:
+			color = SampleQuadFiltered<VirtualTexels<BlockTexels<BC5Block>>>(texture, uvs);
+			break;
+		case TexelFormat::RGBA8:
+		default:
+			color = SampleQuadFiltered<VirtualTexels<RGBA8Texels>>(texture, uvs);
+			break;
+		}
+		StoreColors(color, outColors);
+	}
+
+	void TextureSampler::Sample(const MaterialTexture& material, const Vector2 (&uvs)[4], MaterialSample (&outSamples)[4]) const
+	{
+		const MaterialTexels::Quad quad{ SampleQuadFiltered<MaterialTexels>(material, uvs) };
+
+		//z is positive in tangent space, rebuilt after filtering for all 4 pixels at once
+		const __m128 normalX{ quad.channels[8] };
+		const __m128 normalY{ quad.channels[9] };
+		const __m128 normalZ{ _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY))), _mm_setzero_ps())) };
+
+		//diffuse r, g, b, gloss, specular r, g, b, normal x, y, z
+		alignas(16) float channels[10][4];
+		for (int i{}; i < 7; ++i)
+			_mm_store_ps(channels[i], quad.channels[i]);
+		_mm_store_ps(channels[7], normalX);
+		_mm_store_ps(channels[8], normalY);
+		_mm_store_ps(channels[9], normalZ);
+
+		for (int i{}; i < 4; ++i)
+		{
+			const Vector3 tangentNormal{ channels[7][i], channels[8][i], channels[9][i] };
+			outSamples[i] = {
+				{ channels[0][i], channels[1][i], channels[2][i] },
+				channels[3][i],
+				{ channels[4][i], channels[5][i], channels[6][i] },
+				tangentNormal.SqrMagnitude() > 0.f ? tangentNormal.Normalized() : Vector3{ 0.f, 0.f, 1.f }
+			};
+		}
+	}
+
+	template<typename Texels>
+	typename Texels::Value TextureSampler::SampleFiltered(const typename Texels::Source& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		//NaN or infinite coordinates (degenerate triangles) address nowhere, they read the first texel instead
+		if (!std::isfinite(uv.x + uv.y + ddx.x + ddx.y + ddy.x + ddy.y))
+			return SamplePoint<Texels>(texture, 0, 0.f, 0.f);
+
+		if (m_SampleMode == SampleMode::Anisotropic)
+			return SampleAnisotropic<Texels>(texture, uv, ddx, ddy);
+
+		float lengthX{}, lengthY{};
+		GetFootprint(texture, ddx, ddy, lengthX, lengthY);
+
+		//log2 of the longest axis, the squared lengths halve the log
+		const float maxLevel{ static_cast<float>(texture.GetMipCount() - 1) };
+		const float lod{ Clamp(0.5f * std::log2(std::max(std::max(lengthX, lengthY), 1e-12f)), 0.f, maxLevel) };
+
+		return m_SampleMode == SampleMode::Point ?
+			SamplePoint<Texels>(texture, static_cast<int>(lod + 0.5f), uv.x, uv.y) :
+			SampleTrilinear<Texels>(texture, lod, uv.x, uv.y);
+	}
+
+	template<typename Texels>
+	typename Texels::Value TextureSampler::SamplePoint(const typename Texels::Source& texture, int level, float u, float v) const
+	{
+		const int width{ texture.GetWidth(level) };
+		const int height{ texture.GetHeight(level) };
+
+		const __m128 x{ Address(Floor(_mm_set1_ps(u * width)), width) };
+		const __m128 y{ Address(Floor(_mm_set1_ps(v * height)), height) };
+		return Texels::Load(texture.GetLevelData(level), width, _mm_cvtsi128_si32(_mm_cvttps_epi32(x)), _mm_cvtsi128_si32(_mm_cvttps_epi32(y)));
+	}
+
+	template<typename Texels>
+	typename Texels::Value TextureSampler::SampleBilinear(const typename Texels::Source& texture, int level, float u, float v) const
+	{
+		const int width{ texture.GetWidth(level) };
+		const int height{ texture.GetHeight(level) };
+
+		//texel centers sit at half coordinates
+		const __m128 position{ _mm_setr_ps(u * width - 0.5f, v * height - 0.5f, 0.f, 0.f) };
+		const __m128 base{ Floor(position) };
+		alignas(16) float fraction[4];
+		alignas(16) float origin[4];
+		_mm_store_ps(fraction, _mm_sub_ps(position, base));
+		_mm_store_ps(origin, base);
+
+		//lanes are the 4 corners: top left, top right, bottom left, bottom right
+		const __m128 cornerX{ _mm_add_ps(_mm_set1_ps(origin[0]), _mm_setr_ps(0.f, 1.f, 0.f, 1.f)) };
+		const __m128 cornerY{ _mm_add_ps(_mm_set1_ps(origin[1]), _mm_setr_ps(0.f, 0.f, 1.f, 1.f)) };
+		alignas(16) int x[4];
+		alignas(16) int y[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x), _mm_cvttps_epi32(Address(cornerX, width)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y), _mm_cvttps_epi32(Address(cornerY, height)));
+
+		const float fx{ fraction[0] };
+		const float fy{ fraction[1] };
+		const __m128 weights{ _mm_mul_ps(
+			_mm_setr_ps(1.f - fx, fx, 1.f - fx, fx),
+			_mm_setr_ps(1.f - fy, 1.f - fy, fy, fy)) };
+
+		//the raw texels of a level, or what a virtual texture resolves them through
+		const auto levelData{ texture.GetLevelData(level) };
+		typename Texels::Value value{ Texels::MulAdd(Texels::Zero(), Texels::Load(levelData, width, x[0], y[0]), _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0))) };
+		value = Texels::MulAdd(value, Texels::Load(levelData, width, x[1], y[1]), _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)));
+		value = Texels::MulAdd(value, Texels::Load(levelData, width, x[2], y[2]), _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)));
+		value = Texels::MulAdd(value, Texels::Load(levelData, width, x[3], y[3]), _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)));
+		return value;
+	}
+
+	template<typename Texels>
+	typename Texels::Value TextureSampler::SampleTrilinear(const typename Texels::Source& texture, float lod, float u, float v) const
+	{
+		const int level{ static_cast<int>(lod) };
+		const float blend{ lod - level };
+		const typename Texels::Value value{ SampleBilinear<Texels>(texture, level, u, v) };
+		if (blend <= 0.f || level + 1 >= texture.GetMipCount())
+			return value;
+
+		//value * (1 - blend) + next * blend
+		const typename Texels::Value next{ SampleBilinear<Texels>(texture, level + 1, u, v) };
+		return Texels::MulAdd(Texels::MulAdd(Texels::Zero(), value, _mm_set1_ps(1.f - blend)), next, _mm_set1_ps(blend));
+	}
+
+	template<typename Texels>
+	typename Texels::Value TextureSampler::SampleAnisotropic(const typename Texels::Source& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		float lengthX{}, lengthY{};
+		GetFootprint(texture, ddx, ddy, lengthX, lengthY);
+
+		const float major{ std::sqrt(std::max(lengthX, lengthY)) };
+		const float minor{ std::max(std::sqrt(std::min(lengthX, lengthY)), 1e-6f) };
+
+		//one tap per minor axis length along the major axis, the mip follows the shorter axis
+		const int tapCount{ Clamp(static_cast<int>(std::ceil(major / minor)), 1, m_MaxAnisotropy) };
+		const float maxLevel{ static_cast<float>(texture.GetMipCount() - 1) };
+		const float lod{ Clamp(std::log2(std::max(major / tapCount, 1e-6f)), 0.f, maxLevel) };
+		if (tapCount == 1)
+			return SampleTrilinear<Texels>(texture, lod, uv.x, uv.y);
+
+		const Vector2 axis{ lengthX >= lengthY ? ddx : ddy };
+		const __m128 tapWeight{ _mm_set1_ps(1.f / tapCount) };
+		typename Texels::Value value{ Texels::Zero() };
+		for (int i{}; i < tapCount; ++i)
+		{
+			const float offset{ (i + 0.5f) / tapCount - 0.5f };
+			value = Texels::MulAdd(value, SampleTrilinear<Texels>(texture, lod, uv.x + axis.x * offset, uv.y + axis.y * offset), tapWeight);
+		}
+		return value;
+	}
+
+	template<typename Texels>
+	typename Texels::Quad TextureSampler::SampleQuadFiltered(const typename Texels::Source& texture, const Vector2 (&uvs)[4]) const
+	{
+		//the quad's own differences, like the GPU takes them
+		const Vector2 ddx{ uvs[1] - uvs[0] };
+		const Vector2 ddy{ uvs[2] - uvs[0] };
+
+		//a NaN or infinite lane would poison its weights, those quads go through the single samples that handle them
+		if (!std::isfinite(uvs[0].x + uvs[0].y + uvs[1].x + uvs[1].y + uvs[2].x + uvs[2].y + uvs[3].x + uvs[3].y + ddx.x + ddx.y + ddy.x + ddy.y))
+		{
+			return Texels::Transpose(
+				SampleFiltered<Texels>(texture, uvs[0], ddx, ddy), SampleFiltered<Texels>(texture, uvs[1], ddx, ddy),
+				SampleFiltered<Texels>(texture, uvs[2], ddx, ddy), SampleFiltered<Texels>(texture, uvs[3], ddx, ddy));
+		}
+
+		const __m128 u{ _mm_setr_ps(uvs[0].x, uvs[1].x, uvs[2].x, uvs[3].x) };
+		const __m128 v{ _mm_setr_ps(uvs[0].y, uvs[1].y, uvs[2].y, uvs[3].y) };
+		if (m_SampleMode == SampleMode::Anisotropic)
+			return SampleQuadAnisotropic<Texels>(texture, u, v, ddx, ddy);
+
+		float lengthX{}, lengthY{};
+		GetFootprint(texture, ddx, ddy, lengthX, lengthY);
+
+		const float maxLevel{ static_cast<float>(texture.GetMipCount() - 1) };
+		const float lod{ Clamp(0.5f * std::log2(std::max(std::max(lengthX, lengthY), 1e-12f)), 0.f, maxLevel) };
+
+		return m_SampleMode == SampleMode::Point ?
+			SampleQuadPoint<Texels>(texture, static_cast<int>(lod + 0.5f), u, v) :
+			SampleQuadTrilinear<Texels>(texture, lod, u, v);
+	}
+
+	template<typename Texels>
+	typename Texels::Quad TextureSampler::SampleQuadPoint(const typename Texels::Source& texture, int level, __m128 u, __m128 v) const
+	{
+		const int width{ texture.GetWidth(level) };
+		const int height{ texture.GetHeight(level) };
+
+		alignas(16) int x[4];
+		alignas(16) int y[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x), _mm_cvttps_epi32(Address(Floor(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(width)))), width)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y), _mm_cvttps_epi32(Address(Floor(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(height)))), height)));
+
+		const auto levelData{ texture.GetLevelData(level) };
+		return Texels::Transpose(
+			Texels::Load(levelData, width, x[0], y[0]), Texels::Load(levelData, width, x[1], y[1]),
+			Texels::Load(levelData, width, x[2], y[2]), Texels::Load(levelData, width, x[3], y[3]));
+	}
+
+	template<typename Texels>
+	typename Texels::Quad TextureSampler::SampleQuadBilinear(const typename Texels::Source& texture, int level, __m128 u, __m128 v) const
+	{
+		const int width{ texture.GetWidth(level) };
+		const int height{ texture.GetHeight(level) };
+
+		//texel centers sit at half coordinates
+		const __m128 half{ _mm_set1_ps(0.5f) };
+		const __m128 positionX{ _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(width))), half) };
+		const __m128 positionY{ _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(height))), half) };
+		const __m128 baseX{ Floor(positionX) };
+		const __m128 baseY{ Floor(positionY) };
+		const __m128 fractionX{ _mm_sub_ps(positionX, baseX) };
+		const __m128 fractionY{ _mm_sub_ps(positionY, baseY) };
+
+		//[0] the left or top texel of every pixel's footprint, [1] the right or bottom one
+		const __m128 one{ _mm_set1_ps(1.f) };
+		alignas(16) int x[2][4];
+		alignas(16) int y[2][4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x[0]), _mm_cvttps_epi32(Address(baseX, width)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(x[1]), _mm_cvttps_epi32(Address(_mm_add_ps(baseX, one), width)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y[0]), _mm_cvttps_epi32(Address(baseY, height)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y[1]), _mm_cvttps_epi32(Address(_mm_add_ps(baseY, one), height)));
+
+		//corners: top left, top right, bottom left, bottom right, each weight holds the 4 pixels
+		const __m128 inverseX{ _mm_sub_ps(one, fractionX) };
+		const __m128 inverseY{ _mm_sub_ps(one, fractionY) };
+		const __m128 weights[4]{
+			_mm_mul_ps(inverseX, inverseY),
+			_mm_mul_ps(fractionX, inverseY),
+			_mm_mul_ps(inverseX, fractionY),
+			_mm_mul_ps(fractionX, fractionY)
+		};
+
+		const auto levelData{ texture.GetLevelData(level) };
+		typename Texels::Quad value{};
+		for (int corner{}; corner < 4; ++corner)
+		{
+			const int* pX{ x[corner & 1] };
+			const int* pY{ y[corner >> 1] };
+			value = QuadMulAdd(value, Texels::Transpose(
+				Texels::Load(levelData, width, pX[0], pY[0]), Texels::Load(levelData, width, pX[1], pY[1]),
+				Texels::Load(levelData, width, pX[2], pY[2]), Texels::Load(levelData, width, pX[3], pY[3])), weights[corner]);
+		}
+		return value;
+	}
+
+	template<typename Texels>
+	typename Texels::Quad TextureSampler::SampleQuadTrilinear(const typename Texels::Source& texture, float lod, __m128 u, __m128 v) const
+	{
+		const int level{ static_cast<int>(lod) };
+		const float blend{ lod - level };
+		const typename Texels::Quad value{ SampleQuadBilinear<Texels>(texture, level, u, v) };
+		if (blend <= 0.f || level + 1 >= texture.GetMipCount())
+			return value;
+
+		const typename Texels::Quad next{ SampleQuadBilinear<Texels>(texture, level + 1, u, v) };
+		return QuadMulAdd(QuadMulAdd(typename Texels::Quad{}, value, _mm_set1_ps(1.f - blend)), next, _mm_set1_ps(blend));
+	}
+
+	template<typename Texels>
+	typename Texels::Quad TextureSampler::SampleQuadAnisotropic(const typename Texels::Source& texture, __m128 u, __m128 v, const Vector2& ddx, const Vector2& ddy) const
+	{
+		float lengthX{}, lengthY{};
+		GetFootprint(texture, ddx, ddy, lengthX, lengthY);
+
+		const float major{ std::sqrt(std::max(lengthX, lengthY)) };
+		const float minor{ std::max(std::sqrt(std::min(lengthX, lengthY)), 1e-6f) };
+
+		//the quad shares its derivatives, so every pixel takes the same taps along the same axis
+		const int tapCount{ Clamp(static_cast<int>(std::ceil(major / minor)), 1, m_MaxAnisotropy) };
+		const float maxLevel{ static_cast<float>(texture.GetMipCount() - 1) };
+		const float lod{ Clamp(std::log2(std::max(major / tapCount, 1e-6f)), 0.f, maxLevel) };
+		if (tapCount == 1)
+			return SampleQuadTrilinear<Texels>(texture, lod, u, v);
+
+		const Vector2 axis{ lengthX >= lengthY ? ddx : ddy };
+		const __m128 tapWeight{ _mm_set1_ps(1.f / tapCount) };
+		typename Texels::Quad value{};
+		for (int i{}; i < tapCount; ++i)
+		{
+			const float offset{ (i + 0.5f) / tapCount - 0.5f };
+			const __m128 tapU{ _mm_add_ps(u, _mm_set1_ps(axis.x * offset)) };
+			const __m128 tapV{ _mm_add_ps(v, _mm_set1_ps(axis.y * offset)) };
+			value = QuadMulAdd(value, SampleQuadTrilinear<Texels>(texture, lod, tapU, tapV), tapWeight);
+		}
+		return value;
+	}
+
+	__m128 TextureSampler::Address(__m128 coordinates, int size) const
+	{
+		const __m128 sizeFloat{ _mm_set1_ps(static_cast<float>(size)) };
+		__m128 addressed{ coordinates };
+		switch (m_AddressMode)
+		{
+		case AddressMode::Wrap: {
+			//coordinate - size * floor(coordinate / size)
+			const __m128 periods{ Floor(_mm_div_ps(coordinates, sizeFloat)) };
+			addressed = _mm_sub_ps(coordinates, _mm_mul_ps(periods, sizeFloat));
+			break;
+		}
+		case AddressMode::Mirror: {
+			//wrap over two sizes, then flip the second half
+			const __m128 period{ _mm_add_ps(sizeFloat, sizeFloat) };
+			const __m128 wrapped{ _mm_sub_ps(coordinates, _mm_mul_ps(Floor(_mm_div_ps(coordinates, period)), period)) };
+			const __m128 mirrored{ _mm_sub_ps(_mm_sub_ps(period, _mm_set1_ps(1.f)), wrapped) };
+			const __m128 isSecondHalf{ _mm_cmpge_ps(wrapped, sizeFloat) };
+			addressed = _mm_or_ps(_mm_and_ps(isSecondHalf, mirrored), _mm_andnot_ps(isSecondHalf, wrapped));
+			break;
+		}
+		case AddressMode::Clamp:
+		default:
+			break;
+		}
+
+		//Wrap and Mirror are inexact for huge coordinates on sizes that aren't a power of two, the index still never leaves the level.
+		//max takes its second operand for NaN, so those land on 0.
+		return _mm_min_ps(_mm_max_ps(addressed, _mm_setzero_ps()), _mm_sub_ps(sizeFloat, _mm_set1_ps(1.f)));
+	}
+}
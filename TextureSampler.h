@@ -0,0 +1,81 @@
+#pragma once
+#include <emmintrin.h>
+#include "ColorRGB.h"
+#include "Datatypes.h"
+#include "Texture.h"
+#include "MaterialTexture.h"
+#include "VirtualTexture.h"
+
+namespace dae
+{
+	//Software counterpart of the D3D sampler states: filter + address mode, shared by every texture it samples.
+	//A single sample addresses, weights and sums the 4 texels of its bilinear footprint together in SSE registers.
+	//A quad sample puts the 4 pixels of a 2x2 quad in the lanes instead, every lane filters its own footprint.
+	//The filters are instantiated per texel layout, the layout is looked at once per Sample call, not per texel.
+	//Block compressed layouts decode whole blocks into a per thread cache, see GetDecodedBlock.
+	class TextureSampler final
+	{
+	public:
+		static constexpr int MaxAnisotropy{ 16 };
+
+		TextureSampler(SampleMode sampleMode = SampleMode::Point, AddressMode addressMode = AddressMode::Clamp, int maxAnisotropy = MaxAnisotropy);
+
+		void SetSampleMode(SampleMode sampleMode) { m_SampleMode = sampleMode; };
+		void SetAddressMode(AddressMode addressMode) { m_AddressMode = addressMode; };
+		SampleMode GetSampleMode() const { return m_SampleMode; };
+		AddressMode GetAddressMode() const { return m_AddressMode; };
+
+		/**
+		 * \brief Filtered sample, the mip level (and anisotropic axis) follows from the uv derivatives
+		 * \param ddx uv change to the next pixel in x, over the pixel's 2x2 quad
+		 * \param ddy uv change to the next pixel in y
+		 */
+		ColorRGB Sample(const Texture& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+		//Same filtering through the page table, missing pages fall back to the closest coarser resident level.
+		//Every page it touches is recorded as the virtual texture's feedback for this frame.
+		ColorRGB Sample(const VirtualTexture& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+		//All four material maps in one pass over the interleaved texels, same filtering as above
+		MaterialSample Sample(const MaterialTexture& material, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+
+		/**
+		 * \brief The 4 pixels of a 2x2 quad at once, same filtering as a Sample per pixel
+		 * \param uvs top left, top right, bottom left, bottom right. Their differences are the quad's derivatives,
+		 * so the mip level and the anisotropic taps are picked once for all 4 pixels.
+		 */
+		void Sample(const Texture& texture, const Vector2 (&uvs)[4], ColorRGB (&outColors)[4]) const;
+		void Sample(const VirtualTexture& texture, const Vector2 (&uvs)[4], ColorRGB (&outColors)[4]) const;
+		void Sample(const MaterialTexture& material, const Vector2 (&uvs)[4], MaterialSample (&outSamples)[4]) const;
+
+	private:
+		SampleMode m_SampleMode{ SampleMode::Point };
+		AddressMode m_AddressMode{ AddressMode::Clamp };
+		int m_MaxAnisotropy{ MaxAnisotropy };
+
+		//Texels describes a texel layout: its Source type, the filtered Value and how to Load, Zero and MulAdd it
+		template<typename Texels>
+		typename Texels::Value SampleFiltered(const typename Texels::Source& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+		template<typename Texels>
+		typename Texels::Value SamplePoint(const typename Texels::Source& texture, int level, float u, float v) const;
+		template<typename Texels>
+		typename Texels::Value SampleBilinear(const typename Texels::Source& texture, int level, float u, float v) const;
+		template<typename Texels>
+		typename Texels::Value SampleTrilinear(const typename Texels::Source& texture, float lod, float u, float v) const;
+		template<typename Texels>
+		typename Texels::Value SampleAnisotropic(const typename Texels::Source& texture, const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+
+		//the same filters for a quad, lane i of u and v is pixel i, Texels::Quad holds the filtered channels the same way
+		template<typename Texels>
+		typename Texels::Quad SampleQuadFiltered(const typename Texels::Source& texture, const Vector2 (&uvs)[4]) const;
+		template<typename Texels>
+		typename Texels::Quad SampleQuadPoint(const typename Texels::Source& texture, int level, __m128 u, __m128 v) const;
+		template<typename Texels>
+		typename Texels::Quad SampleQuadBilinear(const typename Texels::Source& texture, int level, __m128 u, __m128 v) const;
+		template<typename Texels>
+		typename Texels::Quad SampleQuadTrilinear(const typename Texels::Source& texture, float lod, __m128 u, __m128 v) const;
+		template<typename Texels>
+		typename Texels::Quad SampleQuadAnisotropic(const typename Texels::Source& texture, __m128 u, __m128 v, const Vector2& ddx, const Vector2& ddy) const;
+
+		//applies the address mode to 4 integral texel coordinates of an axis with size texels
+		__m128 Address(__m128 coordinates, int size) const;
+	};
+}
@@ -0,0 +1,339 @@
+#include "pch.h"
+#include "VideoStream.h"
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace dae
+{
+	VideoStream::VideoStream(int width, int height, int framesPerSecond) :
+		m_Width{ width },
+		m_Height{ height },
+		m_FramesPerSecond{ framesPerSecond }
+	{
+	}
+
+	VideoStream::~VideoStream()
+	{
+		Close();
+	}
+
+	bool VideoStream::Open(const std::string& target, VideoStreamFormat format)
+	{
+		if (m_IsOpen)
+			Close();
+
+		m_Format = format;
+		m_IsStdOut = target == "-";
+		m_IsPipe = target.rfind("\\\\.\\pipe\\", 0) == 0;
+
+		if (m_IsStdOut)
+		{
+			//Written through the raw handle so the CRT never translates line endings in the frame data,
+			//console output of the renderer moves to stderr so it doesn't end up in the stream
+			m_Output = GetStdHandle(STD_OUTPUT_HANDLE);
+			std::cout.flush();
+			m_pConsoleBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+		}
+		else if (m_IsPipe)
+		{
+			m_Output = CreateNamedPipeA(target.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1, 1 << 20, 0, 0, nullptr);
+			if (m_Output != INVALID_HANDLE_VALUE)
+			{
+				std::cout << "VideoStream: waiting for a reader on " << target << '\n';
+				if (!ConnectNamedPipe(m_Output, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+				{
+					CloseHandle(m_Output);
+					m_Output = INVALID_HANDLE_VALUE;
+				}
+			}
+		}
+		else
+		{
+			m_Output = CreateFileA(target.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		}
+
+		if (m_Output == INVALID_HANDLE_VALUE || m_Output == nullptr)
+		{
+			std::cout << "VideoStream: could not open " << target << '\n';
+			if (m_pConsoleBuffer)
+			{
+				std::cout.rdbuf(m_pConsoleBuffer);
+				m_pConsoleBuffer = nullptr;
+			}
+			return false;
+		}
+
+		//4:2:0 keeps a full resolution luma plane and two quarter resolution chroma planes
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		const size_t chromaCount{ static_cast<size_t>((m_Width + 1) / 2) * ((m_Height + 1) / 2) };
+		const size_t frameSize{ format == VideoStreamFormat::Y4M ? pixelCount + 2 * chromaCount : pixelCount * 3 };
+		for (FrameSlot& slot : m_Slots)
+		{
+			slot.bytes.resize(frameSize);
+			slot.isQueued = false;
+		}
+		m_CurrentSlot = 0;
+		m_SubmittedFrames = 0;
+		m_HasFailed = false;
+		m_IsStopping = false;
+
+		if (format == VideoStreamFormat::Y4M)
+		{
+			std::stringstream header{};
+			header << "YUV4MPEG2 W" << m_Width << " H" << m_Height << " F" << m_FramesPerSecond << ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n";
+			const std::string headerString{ header.str() };
+			m_HasFailed = !Write(headerString.data(), headerString.size());
+		}
+
+		m_Writer = std::thread{ &VideoStream::WriterLoop, this };
+		m_IsOpen = true;
+		return true;
+	}
+
+	void VideoStream::Close()
+	{
+		if (!m_IsOpen)
+			return;
+
+		//The writer drains whatever is still queued before it exits
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_SlotQueued.notify_all();
+		m_Writer.join();
+
+		FlushFileBuffers(m_Output);
+		if (m_IsPipe)
+		{
+			DisconnectNamedPipe(m_Output);
+		}
+		if (!m_IsStdOut)
+		{
+			CloseHandle(m_Output);
+		}
+		m_Output = INVALID_HANDLE_VALUE;
+
+		if (m_pConsoleBuffer)
+		{
+			std::cout.rdbuf(m_pConsoleBuffer);
+			m_pConsoleBuffer = nullptr;
+		}
+
+		m_IsOpen = false;
+		m_HasFailed ?
+			std::cout << "VideoStream: the reader went away, closed after " << m_SubmittedFrames << " frames\n" :
+			std::cout << "-----Video stream closed after " << m_SubmittedFrames << " frames-----\n";
+	}
+
+	void VideoStream::SubmitFrame(const uint32_t* pPixels, int pitch)
+	{
+		if (!m_IsOpen || m_HasFailed)
+			return;
+
+		FrameSlot& slot{ m_Slots[m_CurrentSlot] };
+		{
+			//Only waits when the reader is slower than the renderer, the other slot is being written meanwhile
+			std::unique_lock lock{ m_Mutex };
+			m_SlotWritten.wait(lock, [&slot]() { return !slot.isQueued; });
+		}
+
+		if (m_Format == VideoStreamFormat::Y4M)
+		{
+			ConvertToYUV420(pPixels, pitch, slot.bytes.data());
+		}
+		else
+		{
+			ConvertToRGB24(pPixels, pitch, slot.bytes.data());
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			slot.isQueued = true;
+		}
+		m_SlotQueued.notify_one();
+
+		m_CurrentSlot ^= 1;
+		++m_SubmittedFrames;
+	}
+
+	void VideoStream::WriterLoop()
+	{
+		int slotIndex{ 0 };
+		while (true)
+		{
+			FrameSlot& slot{ m_Slots[slotIndex] };
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_SlotQueued.wait(lock, [&]() { return slot.isQueued || m_IsStopping; });
+				if (!slot.isQueued)
+					return;
+			}
+
+			const bool isFrameHeaderWritten{ m_Format != VideoStreamFormat::Y4M || Write("FRAME\n", 6) };
+			if (!isFrameHeaderWritten || !Write(slot.bytes.data(), slot.bytes.size()))
+			{
+				//reader went away, stop converting frames nobody will read
+				m_HasFailed = true;
+			}
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				slot.isQueued = false;
+			}
+			m_SlotWritten.notify_one();
+			slotIndex ^= 1;
+		}
+	}
+
+	bool VideoStream::Write(const void* pData, size_t size)
+	{
+		const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+		while (size > 0)
+		{
+			const DWORD chunk{ static_cast<DWORD>(std::min<size_t>(size, 1 << 24)) };
+			DWORD written{};
+			if (!WriteFile(m_Output, pBytes, chunk, &written, nullptr) || written == 0)
+				return false;
+
+			pBytes += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	void VideoStream::ConvertToYUV420(const uint32_t* pPixels, int pitch, uint8_t* pOut) const
+	{
+		//Full range BT.601 in 8.8 fixed point, matches the C420jpeg colour space in the header
+		//Y =  77R + 150G +  29B
+		//U = -43R -  85G + 128B (+128)
+		//V = 128R - 107G -  21B (+128)
+		const int chromaWidth{ (m_Width + 1) / 2 };
+		const int chromaHeight{ (m_Height + 1) / 2 };
+		uint8_t* pPlaneY{ pOut };
+		uint8_t* pPlaneU{ pPlaneY + static_cast<size_t>(m_Width) * m_Height };
+		uint8_t* pPlaneV{ pPlaneU + static_cast<size_t>(chromaWidth) * chromaHeight };
+
+		//Every task converts two luma rows and the chroma row they share
+		concurrency::parallel_for(0, chromaHeight, [&](int chromaY) {
+			const int y0{ chromaY * 2 };
+			const int y1{ std::min(y0 + 1, m_Height - 1) };
+			const uint32_t* pRow0{ pPixels + static_cast<size_t>(y0) * pitch };
+			const uint32_t* pRow1{ pPixels + static_cast<size_t>(y1) * pitch };
+			uint8_t* pOutY0{ pPlaneY + static_cast<size_t>(y0) * m_Width };
+			uint8_t* pOutY1{ pPlaneY + static_cast<size_t>(y1) * m_Width };
+			uint8_t* pOutU{ pPlaneU + static_cast<size_t>(chromaY) * chromaWidth };
+			uint8_t* pOutV{ pPlaneV + static_cast<size_t>(chromaY) * chromaWidth };
+
+			const __m128i byteMask{ _mm_set1_epi32(0xff) };
+			const __m128i lumaR{ _mm_set1_epi16(77) };
+			const __m128i lumaG{ _mm_set1_epi16(150) };
+			const __m128i lumaB{ _mm_set1_epi16(29) };
+			const __m128i half{ _mm_set1_epi16(128) };
+			const __m128i ones{ _mm_set1_epi16(1) };
+			const __m128i coefficientsU{ _mm_setr_epi16(-43, -85, -43, -85, -43, -85, -43, -85) };
+			const __m128i coefficientsV{ _mm_setr_epi16(128, -107, 128, -107, 128, -107, 128, -107) };
+			const __m128i blueU{ _mm_setr_epi16(128, 0, 128, 0, 128, 0, 128, 0) };
+			const __m128i blueV{ _mm_setr_epi16(-21, 0, -21, 0, -21, 0, -21, 0) };
+			//rounding plus the +128 chroma bias, applied before the shift
+			const __m128i offset{ _mm_set1_epi32(128 * 256 + 128) };
+
+			//splits 8 XRGB pixels into 16 bit R, G and B lanes
+			const auto unpack = [&](const uint32_t* pSource, __m128i& r, __m128i& g, __m128i& b)
+			{
+				const __m128i low{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource)) };
+				const __m128i high{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + 4)) };
+				r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), byteMask), _mm_and_si128(_mm_srli_epi32(high, 16), byteMask));
+				g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), byteMask), _mm_and_si128(_mm_srli_epi32(high, 8), byteMask));
+				b = _mm_packs_epi32(_mm_and_si128(low, byteMask), _mm_and_si128(high, byteMask));
+			};
+
+			//unsigned 16 bit math, the largest sum is 256 * 255 + 128 which still fits
+			const auto luma = [&](const __m128i& r, const __m128i& g, const __m128i& b)
+			{
+				__m128i y{ _mm_add_epi16(_mm_mullo_epi16(r, lumaR), _mm_mullo_epi16(g, lumaG)) };
+				y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, lumaB), half));
+				return _mm_srli_epi16(y, 8);
+			};
+
+			int x{ 0 };
+			for (; x + 8 <= m_Width; x += 8)
+			{
+				__m128i r0, g0, b0, r1, g1, b1;
+				unpack(pRow0 + x, r0, g0, b0);
+				unpack(pRow1 + x, r1, g1, b1);
+
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(pOutY0 + x), _mm_packus_epi16(luma(r0, g0, b0), _mm_setzero_si128()));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(pOutY1 + x), _mm_packus_epi16(luma(r1, g1, b1), _mm_setzero_si128()));
+
+				//average every 2x2 block: add the rows, then add horizontal neighbours into 32 bit lanes
+				const __m128i two{ _mm_set1_epi32(2) };
+				__m128i r{ _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(r0, r1), ones), two), 2) };
+				__m128i g{ _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(g0, g1), ones), two), 2) };
+				__m128i b{ _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(b0, b1), ones), two), 2) };
+				r = _mm_packs_epi32(r, r);
+				g = _mm_packs_epi32(g, g);
+				b = _mm_packs_epi32(b, b);
+
+				//interleaved pairs so madd gives exact 32 bit dot products
+				const __m128i rg{ _mm_unpacklo_epi16(r, g) };
+				const __m128i bZero{ _mm_unpacklo_epi16(b, _mm_setzero_si128()) };
+
+				__m128i u{ _mm_add_epi32(_mm_madd_epi16(rg, coefficientsU), _mm_madd_epi16(bZero, blueU)) };
+				__m128i v{ _mm_add_epi32(_mm_madd_epi16(rg, coefficientsV), _mm_madd_epi16(bZero, blueV)) };
+				u = _mm_srai_epi32(_mm_add_epi32(u, offset), 8);
+				v = _mm_srai_epi32(_mm_add_epi32(v, offset), 8);
+
+				const __m128i packedU{ _mm_packus_epi16(_mm_packs_epi32(u, u), _mm_setzero_si128()) };
+				const __m128i packedV{ _mm_packus_epi16(_mm_packs_epi32(v, v), _mm_setzero_si128()) };
+				const int storedU{ _mm_cvtsi128_si32(packedU) };
+				const int storedV{ _mm_cvtsi128_si32(packedV) };
+				memcpy(pOutU + x / 2, &storedU, 4);
+				memcpy(pOutV + x / 2, &storedV, 4);
+			}
+
+			//scalar tail for widths that aren't a multiple of 8
+			for (; x < m_Width; x += 2)
+			{
+				const int x1{ std::min(x + 1, m_Width - 1) };
+				const uint32_t block[4]{ pRow0[x], pRow0[x1], pRow1[x], pRow1[x1] };
+
+				int sumR{}, sumG{}, sumB{};
+				for (int i{}; i < 4; ++i)
+				{
+					sumR += (block[i] >> 16) & 0xff;
+					sumG += (block[i] >> 8) & 0xff;
+					sumB += block[i] & 0xff;
+				}
+
+				const auto scalarLuma = [](uint32_t p) {
+					return static_cast<uint8_t>((77 * ((p >> 16) & 0xff) + 150 * ((p >> 8) & 0xff) + 29 * (p & 0xff) + 128) >> 8);
+				};
+				pOutY0[x] = scalarLuma(block[0]);
+				pOutY0[x1] = scalarLuma(block[1]);
+				pOutY1[x] = scalarLuma(block[2]);
+				pOutY1[x1] = scalarLuma(block[3]);
+
+				const int r{ (sumR + 2) / 4 };
+				const int g{ (sumG + 2) / 4 };
+				const int b{ (sumB + 2) / 4 };
+				pOutU[x / 2] = static_cast<uint8_t>(Clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255));
+				pOutV[x / 2] = static_cast<uint8_t>(Clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255));
+			}
+		});
+	}
+
+	void VideoStream::ConvertToRGB24(const uint32_t* pPixels, int pitch, uint8_t* pOut) const
+	{
+		concurrency::parallel_for(0, m_Height, [&](int y) {
+			const uint32_t* pRow{ pPixels + static_cast<size_t>(y) * pitch };
+			uint8_t* pOutRow{ pOut + static_cast<size_t>(y) * m_Width * 3 };
+			for (int x{}; x < m_Width; ++x)
+			{
+				pOutRow[x * 3] = static_cast<uint8_t>(pRow[x] >> 16);
+				pOutRow[x * 3 + 1] = static_cast<uint8_t>(pRow[x] >> 8);
+				pOutRow[x * 3 + 2] = static_cast<uint8_t>(pRow[x]);
+			}
+		});
+	}
+}
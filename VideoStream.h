@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class VideoStreamFormat
+	{
+		Y4M,
+		RawRGB
+	};
+
+	//Streams uncompressed frames to stdout, a named pipe or a file for an external encoder to consume.
+	//Frames are converted straight from the resolved back buffer into one of two slots while the
+	//writer thread pushes the other one out, so the pipe never blocks the conversion of the next frame.
+	class VideoStream final
+	{
+	public:
+		VideoStream(int width, int height, int framesPerSecond = 30);
+		~VideoStream();
+
+		VideoStream(const VideoStream&) = delete;
+		VideoStream(VideoStream&&) noexcept = delete;
+		VideoStream& operator=(const VideoStream&) = delete;
+		VideoStream& operator=(VideoStream&&) noexcept = delete;
+
+		/**
+		 * \param target "-" for stdout, "\\.\pipe\<name>" to create a named pipe and wait for a reader, anything else is a file
+		 * \param format Y4M (4:2:0, full range BT.601) or headerless packed RGB24
+		 */
+		bool Open(const std::string& target, VideoStreamFormat format);
+		void Close();
+		bool IsOpen() const { return m_IsOpen; };
+
+		//pitch in pixels, pPixels is XRGB8888 like the software back buffer
+		void SubmitFrame(const uint32_t* pPixels, int pitch);
+		int GetSubmittedFrames() const { return m_SubmittedFrames; };
+		//the reader went away, SubmitFrame drops every frame from then on
+		bool HasFailed() const { return m_HasFailed; };
+
+	private:
+		struct FrameSlot
+		{
+			std::vector<uint8_t> bytes{};
+			bool isQueued{ false };
+		};
+
+		void WriterLoop();
+		bool Write(const void* pData, size_t size);
+
+		void ConvertToYUV420(const uint32_t* pPixels, int pitch, uint8_t* pOut) const;
+		void ConvertToRGB24(const uint32_t* pPixels, int pitch, uint8_t* pOut) const;
+
+		int m_Width{};
+		int m_Height{};
+		int m_FramesPerSecond{};
+		VideoStreamFormat m_Format{ VideoStreamFormat::Y4M };
+
+		HANDLE m_Output{ INVALID_HANDLE_VALUE };
+		bool m_IsPipe{ false };
+		bool m_IsStdOut{ false };
+		std::streambuf* m_pConsoleBuffer{ nullptr };
+		bool m_IsOpen{ false };
+		std::atomic<bool> m_HasFailed{ false };
+
+		FrameSlot m_Slots[2]{};
+		int m_CurrentSlot{ 0 };
+		int m_SubmittedFrames{ 0 };
+
+		std::thread m_Writer{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_SlotQueued{};
+		std::condition_variable m_SlotWritten{};
+		bool m_IsStopping{ false };
+	};
+}
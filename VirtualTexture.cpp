@@ -0,0 +1,252 @@
+#include "pch.h"
+#include "VirtualTexture.h"
+#include "TextureCache.h"
+#include "BlockCompression.h"
+#include <fstream>
+
+namespace dae
+{
+	namespace
+	{
+		//pages read at the same time, what doesn't fit waits for the next frames' feedback
+		constexpr size_t MaxPendingPages{ 16 };
+	}
+
+	VirtualTexture* VirtualTexture::Create(const std::string& path, TexelFormat format, size_t budget)
+	{
+		//the full texture is never decoded into memory, only its cache gets written
+		if (VirtualTexture* pTexture{ Open(path, format, budget) })
+			return pTexture;
+		if (!Texture::WriteCacheFile(path, format))
+			return nullptr;
+		return Open(path, format, budget);
+	}
+
+	VirtualTexture* VirtualTexture::Open(const std::string& path, TexelFormat format, size_t budget)
+	{
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		const std::string cachePath{ GetTextureCachePath(path) };
+		std::ifstream file{ cachePath, std::ios::binary | std::ios::ate };
+		const uint64_t fileSize{ file ? static_cast<uint64_t>(file.tellg()) : 0 };
+
+		TextureCacheHeader header{};
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || !GetSourceStamp(path, sourceSize, sourceWriteTime) || !IsValidTextureCache(header, fileSize, format, sourceSize, sourceWriteTime))
+			return nullptr;
+
+		//the mip tail is read right away, the first level of it fits in one page
+		std::vector<MipLevel> levels{};
+		LayoutMipChain(header.width, header.height, GetTexelBlockSize(static_cast<TexelFormat>(header.format)), levels);
+		size_t firstTailLevel{};
+		while (levels[firstTailLevel].width > PageSize || levels[firstTailLevel].height > PageSize)
+			++firstTailLevel;
+
+		const size_t tailSize{ header.dataSize - levels[firstTailLevel].offset };
+		uint8_t* pTailTexels{ AllocateTexels(tailSize) };
+		file.seekg(static_cast<std::streamoff>(header.dataOffset + levels[firstTailLevel].offset));
+		file.read(reinterpret_cast<char*>(pTailTexels), static_cast<std::streamsize>(tailSize));
+		if (!file)
+		{
+			std::cout << "VirtualTexture: could not read " << cachePath << '\n';
+			FreeTexels(pTailTexels);
+			return nullptr;
+		}
+
+		return new VirtualTexture{ cachePath, header, pTailTexels, budget };
+	}
+
+	VirtualTexture::VirtualTexture(const std::string& cachePath, const TextureCacheHeader& header, uint8_t* pTailTexels, size_t budget) :
+		m_CachePath{ cachePath },
+		m_DataOffset{ header.dataOffset },
+		m_Format{ static_cast<TexelFormat>(header.format) },
+		m_BlockSize{ GetTexelBlockSize(m_Format) },
+		m_pTailTexels{ pTailTexels }
+	{
+		const size_t blocksPerPage{ PageSize / TexelBlockSize };
+		m_PageBytes = blocksPerPage * blocksPerPage * m_BlockSize;
+
+		const size_t dataSize{ LayoutMipChain(header.width, header.height, m_BlockSize, m_MipLevels) };
+		size_t pageCount{};
+		for (const MipLevel& level : m_MipLevels)
+		{
+			if (level.width <= PageSize && level.height <= PageSize)
+				break;
+
+			const int columns{ (level.width + PageSize - 1) / PageSize };
+			const int rows{ (level.height + PageSize - 1) / PageSize };
+			m_PageLevels.push_back({ pageCount, columns, rows });
+			pageCount += static_cast<size_t>(columns) * rows;
+		}
+		m_FirstTailLevel = static_cast<int>(m_PageLevels.size());
+		m_TailSize = dataSize - m_MipLevels[m_FirstTailLevel].offset;
+		m_Pages = std::vector<Page>(pageCount);
+
+		//never more slots than pages, at least one so every page can be shown eventually
+		const size_t slotCount{ std::min(std::max(budget / m_PageBytes, size_t{ 1 }), std::max(pageCount, size_t{ 1 })) };
+		m_pSlots = AllocateTexels(slotCount * m_PageBytes);
+		m_SlotPages.assign(slotCount, pageCount);
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		//the reads write into the slots
+		for (PendingPage& pending : m_PendingPages)
+			pending.load.wait();
+		m_PendingPages.clear();
+
+		//decoded blocks of the slots may still sit in the samplers' caches
+		if (IsBlockCompressed(m_Format))
+			InvalidateDecodedBlocks();
+		FreeTexels(m_pSlots);
+		m_pSlots = nullptr;
+		FreeTexels(m_pTailTexels);
+		m_pTailTexels = nullptr;
+	}
+
+	void VirtualTexture::Update()
+	{
+		//1. install what finished reading, the sampler only looks at slots that are installed
+		InstallPages();
+
+		//2. what the last frame asked for and isn't there. Coarse pages first, they cover the most and stand in for the finer ones.
+		std::vector<size_t> requests{};
+		for (int level{ m_FirstTailLevel - 1 }; level >= 0; --level)
+		{
+			const PageLevel& pageLevel{ m_PageLevels[level] };
+			const size_t pageEnd{ pageLevel.firstPage + static_cast<size_t>(pageLevel.columns) * pageLevel.rows };
+			for (size_t i{ pageLevel.firstPage }; i < pageEnd; ++i)
+			{
+				const Page& page{ m_Pages[i] };
+				if (page.slot < 0 && !page.isLoading && !page.isFailed && page.requestedFrame.load(std::memory_order_relaxed) == m_Frame)
+					requests.push_back(i);
+			}
+		}
+
+		//3. read them on the pool into the slots of the least recently used pages
+		for (const size_t request : requests)
+		{
+			if (m_PendingPages.size() >= MaxPendingPages)
+				break;
+
+			const int slot{ TakeSlot() };
+			if (slot < 0)
+				break;
+
+			int level{};
+			while (level + 1 < m_FirstTailLevel && m_PageLevels[level + 1].firstPage <= request)
+				++level;
+			const PageLevel& pageLevel{ m_PageLevels[level] };
+			const int column{ static_cast<int>((request - pageLevel.firstPage) % pageLevel.columns) };
+			const int row{ static_cast<int>((request - pageLevel.firstPage) / pageLevel.columns) };
+
+			m_Pages[request].isLoading = true;
+			m_SlotPages[slot] = request;
+			uint8_t* pSlot{ m_pSlots + static_cast<size_t>(slot) * m_PageBytes };
+			m_PendingPages.push_back({ concurrency::create_task([this, level, column, row, pSlot] { return ReadPage(level, column, row, pSlot); }), request, slot });
+		}
+
+		++m_Frame;
+	}
+
+	void VirtualTexture::Flush()
+	{
+		for (PendingPage& pending : m_PendingPages)
+			pending.load.wait();
+
+		InstallPages();
+	}
+
+	void VirtualTexture::InstallPages()
+	{
+		bool hasNewPages{ false };
+		for (size_t i{}; i < m_PendingPages.size();)
+		{
+			PendingPage& pending{ m_PendingPages[i] };
+			if (!pending.load.is_done())
+			{
+				++i;
+				continue;
+			}
+
+			Page& page{ m_Pages[pending.page] };
+			page.isLoading = false;
+			if (pending.load.get())
+			{
+				page.slot = pending.slot;
+				++m_ResidentPageCount;
+				hasNewPages = true;
+			}
+			else
+			{
+				//never asked for again, the coarser levels keep standing in for it
+				std::cout << "VirtualTexture: could not read a page of " << m_CachePath << '\n';
+				page.isFailed = true;
+				m_SlotPages[pending.slot] = m_Pages.size();
+			}
+			m_PendingPages.erase(m_PendingPages.begin() + i);
+		}
+		//a slot that was reused may still be cached decoded under its old contents
+		if (hasNewPages && IsBlockCompressed(m_Format))
+			InvalidateDecodedBlocks();
+	}
+
+	size_t VirtualTexture::GetMemorySize() const
+	{
+		return m_SlotPages.size() * m_PageBytes + m_TailSize;
+	}
+
+	bool VirtualTexture::ReadPage(int level, int column, int row, uint8_t* pSlot) const
+	{
+		//every reader has its own stream, pages are read in parallel
+		std::ifstream file{ m_CachePath, std::ios::binary };
+		if (!file)
+			return false;
+
+		//a page is blocksPerPage rows of blocksPerPage blocks out of the level's block rows, edge pages are partly empty
+		const int blocksPerPage{ PageSize / TexelBlockSize };
+		const int blocksPerRow{ (m_MipLevels[level].width + TexelBlockSize - 1) / TexelBlockSize };
+		const int blocksPerColumn{ (m_MipLevels[level].height + TexelBlockSize - 1) / TexelBlockSize };
+		const int firstBlockX{ column * blocksPerPage };
+		const int firstBlockY{ row * blocksPerPage };
+		const int blockCount{ std::min(blocksPerPage, blocksPerRow - firstBlockX) };
+		const int rowCount{ std::min(blocksPerPage, blocksPerColumn - firstBlockY) };
+
+		for (int y{}; y < rowCount; ++y)
+		{
+			const uint64_t offset{ m_DataOffset + m_MipLevels[level].offset + (static_cast<uint64_t>(firstBlockY + y) * blocksPerRow + firstBlockX) * m_BlockSize };
+			file.seekg(static_cast<std::streamoff>(offset));
+			file.read(reinterpret_cast<char*>(pSlot + static_cast<size_t>(y) * blocksPerPage * m_BlockSize), static_cast<std::streamsize>(blockCount * m_BlockSize));
+		}
+		return file.good();
+	}
+
+	int VirtualTexture::TakeSlot()
+	{
+		int oldestSlot{ -1 };
+		uint32_t oldestFrame{ m_Frame };
+		for (size_t i{}; i < m_SlotPages.size(); ++i)
+		{
+			if (m_SlotPages[i] == m_Pages.size())
+				return static_cast<int>(i);
+
+			//pages the last frame used stay, so do the ones still being read
+			const Page& page{ m_Pages[m_SlotPages[i]] };
+			const uint32_t frame{ page.requestedFrame.load(std::memory_order_relaxed) };
+			if (!page.isLoading && frame < oldestFrame)
+			{
+				oldestSlot = static_cast<int>(i);
+				oldestFrame = frame;
+			}
+		}
+
+		if (oldestSlot >= 0)
+		{
+			m_Pages[m_SlotPages[oldestSlot]].slot = -1;
+			m_SlotPages[oldestSlot] = m_Pages.size();
+			--m_ResidentPageCount;
+		}
+		return oldestSlot;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <ppltasks.h>
+#include "Texture.h"
+
+namespace dae
+{
+	struct TextureCacheHeader;
+
+	/**
+	 * \brief Software only texture that keeps a fixed budget of 128x128 pages in memory, however large the texture is.
+	 * Pages are read from the texture cache (see Texture::WriteCacheFile) into a fixed pool of slots.
+	 * Sampling stamps every page it asks for with the current frame, that's the feedback Update loads from.
+	 * A page that isn't resident is stood in for by the same spot of the closest coarser level that is.
+	 * The levels that fit in a single page (the mip tail) are always resident, so there is always something to fall back to.
+	 */
+	class VirtualTexture final
+	{
+	public:
+		static constexpr int PageSize{ 128 };
+
+		//What GetLevelData hands the sampler, texels are resolved through the page table with Resolve
+		struct LevelData
+		{
+			const VirtualTexture* pTexture;
+			int level;
+		};
+
+		//Opens the texture cache of path, writes it level by level first when there is no valid one for format.
+		//budget is the bytes of the page pool, the mip tail comes on top of it. nullptr when the cache can't be written or read.
+		static VirtualTexture* Create(const std::string& path, TexelFormat format, size_t budget);
+		//waits for the pages still being read
+		~VirtualTexture();
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture(VirtualTexture&&) noexcept = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(VirtualTexture&&) noexcept = delete;
+
+		//Call between frames: installs the pages that were read, then starts reading the pages the last frame asked for,
+		//coarsest first, evicting the pages that went unused the longest
+		void Update();
+		//Blocks until every page being read is installed
+		void Flush();
+
+		TexelFormat GetFormat() const { return m_Format; };
+		int GetMipCount() const { return static_cast<int>(m_MipLevels.size()); };
+		int GetWidth(int level) const { return m_MipLevels[level].width; };
+		int GetHeight(int level) const { return m_MipLevels[level].height; };
+		LevelData GetLevelData(int level) const { return { this, level }; };
+		//Page pool + mip tail, fixed from the start
+		size_t GetMemorySize() const;
+		int GetResidentPageCount() const { return m_ResidentPageCount; };
+		int GetPageCapacity() const { return static_cast<int>(m_SlotPages.size()); };
+
+		/**
+		 * \brief Texels of the page holding x, y of level, or of the closest coarser resident level.
+		 * \param x, y in: a texel of level, out: the same texel inside the returned texels
+		 * \param outWidth width to address the returned texels with, they are laid out like a texture level of that width
+		 */
+		const uint8_t* Resolve(int level, int& x, int& y, int& outWidth) const;
+
+	private:
+		struct Page
+		{
+			//last frame a sample asked for this page, written by the sampling threads
+			mutable std::atomic<uint32_t> requestedFrame{};
+			int slot{ -1 }; //only set while resident, changes in Update only
+			bool isLoading{ false };
+			bool isFailed{ false };
+		};
+
+		struct PageLevel
+		{
+			size_t firstPage{};
+			int columns{};
+			int rows{};
+		};
+
+		struct PendingPage
+		{
+			concurrency::task<bool> load;
+			size_t page;
+			int slot;
+		};
+
+		//nullptr when path has no valid texture cache for format
+		static VirtualTexture* Open(const std::string& path, TexelFormat format, size_t budget);
+
+		VirtualTexture(const std::string& cachePath, const TextureCacheHeader& header, uint8_t* pTailTexels, size_t budget);
+
+		//hands the slots of the pages that were read to the sampler
+		void InstallPages();
+		//reads the blocks of one page out of the cache into its slot, runs on the thread pool
+		bool ReadPage(int level, int column, int row, uint8_t* pSlot) const;
+		//a free slot, or the one whose page went unused the longest. -1 when every page was used by the last frame.
+		int TakeSlot();
+
+		std::string m_CachePath{};
+		uint64_t m_DataOffset{};
+		TexelFormat m_Format{ TexelFormat::RGBA8 };
+		size_t m_BlockSize{};
+		size_t m_PageBytes{};
+		std::vector<MipLevel> m_MipLevels{};
+
+		//levels from m_FirstTailLevel on are read once and stay, in m_pTailTexels
+		int m_FirstTailLevel{};
+		uint8_t* m_pTailTexels{ nullptr };
+		size_t m_TailSize{};
+
+		//page table: PageLevels index into Pages, row by row. Levels of the tail have no pages.
+		std::vector<PageLevel> m_PageLevels{};
+		std::vector<Page> m_Pages;
+		//the pool, every slot holds one page laid out like a PageSize wide level
+		uint8_t* m_pSlots{ nullptr };
+		std::vector<size_t> m_SlotPages{}; //page in each slot, m_Pages.size() when free
+		int m_ResidentPageCount{};
+
+		std::vector<PendingPage> m_PendingPages{};
+		uint32_t m_Frame{ 1 };
+	};
+
+	inline const uint8_t* VirtualTexture::Resolve(int level, int& x, int& y, int& outWidth) const
+	{
+		for (; level < m_FirstTailLevel; ++level, x /= 2, y /= 2)
+		{
+			const PageLevel& pageLevel{ m_PageLevels[level] };
+			const Page& page{ m_Pages[pageLevel.firstPage + static_cast<size_t>(y / PageSize) * pageLevel.columns + x / PageSize] };
+
+			//only written once per page and frame, the taps of every thread mostly read the same few pages
+			if (page.requestedFrame.load(std::memory_order_relaxed) != m_Frame)
+				page.requestedFrame.store(m_Frame, std::memory_order_relaxed);
+
+			if (page.slot >= 0)
+			{
+				x %= PageSize;
+				y %= PageSize;
+				outWidth = PageSize;
+				return m_pSlots + static_cast<size_t>(page.slot) * m_PageBytes;
+			}
+		}
+
+		outWidth = m_MipLevels[level].width;
+		return m_pTailTexels + (m_MipLevels[level].offset - m_MipLevels[m_FirstTailLevel].offset);
+	}
+}
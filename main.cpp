@@ -6,6 +6,7 @@
 
 #undef main
 #include "Renderer.h"
+#include <charconv>
 
 using namespace dae;
 
@@ -15,11 +16,81 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+//the whole text has to be a number above zero, anything else is a typo on the command line
+bool ParsePositive(const char* pText, int& outValue)
+{
+	const char* pEnd{ pText + strlen(pText) };
+	int value{};
+	const auto [pLast, error] { std::from_chars(pText, pEnd, value) };
+	if (error != std::errc{} || pLast != pEnd || value <= 0)
+		return false;
+
+	outValue = value;
+	return true;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage:\n"
+		<< "  --stream <- | \\\\.\\pipe\\name | file> [--frames N] [--raw]\n"
+		<< "  --shared-memory <name> [--slots N]\n"
+		<< "  --offscreen <width> <height> <file.bmp> [--band N]\n"
+		<< "  --virtual-textures\n"
+		<< "  --stream-mesh\n"
+		<< "N, width and height are whole numbers above zero\n";
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Offline rendering: --stream <- | \\.\pipe\name | file> [--frames N] [--raw]
+	//Shared memory output: --shared-memory <name> [--slots N]
+	//Large offscreen image: --offscreen <width> <height> <file.bmp> [--band N]
+	//Vehicle maps paged in through fixed size caches on the software path: --virtual-textures
+	//Vehicle drawn from its streamed clusters on the software path: --stream-mesh
+	std::string streamTarget{};
+	std::string sharedMemoryName{};
+	int sharedMemorySlots{ 3 };
+	std::string offscreenPath{};
+	int offscreenWidth{};
+	int offscreenHeight{};
+	int offscreenBand{ 64 };
+	int streamFrames{ 360 };
+	VideoStreamFormat streamFormat{ VideoStreamFormat::Y4M };
+	AssetOptions assetOptions{};
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		bool isValid{ true };
+		if (argument == "--stream" && i + 1 < argc)
+			streamTarget = args[++i];
+		else if (argument == "--frames" && i + 1 < argc)
+			isValid = ParsePositive(args[++i], streamFrames);
+		else if (argument == "--raw")
+			streamFormat = VideoStreamFormat::RawRGB;
+		else if (argument == "--shared-memory" && i + 1 < argc)
+			sharedMemoryName = args[++i];
+		else if (argument == "--slots" && i + 1 < argc) {
+			isValid = ParsePositive(args[++i], sharedMemorySlots);
+			sharedMemorySlots = std::max(2, sharedMemorySlots);
+		}
+		else if (argument == "--offscreen" && i + 3 < argc) {
+			isValid = ParsePositive(args[i + 1], offscreenWidth) && ParsePositive(args[i + 2], offscreenHeight);
+			offscreenPath = args[i + 3];
+			i += 3;
+		}
+		else if (argument == "--band" && i + 1 < argc)
+			isValid = ParsePositive(args[++i], offscreenBand);
+		else if (argument == "--virtual-textures")
+			assetOptions.isVirtualTexturing = true;
+		else if (argument == "--stream-mesh")
+			assetOptions.isStreamingMesh = true;
+
+		if (!isValid) {
+			std::cout << "Invalid value after " << argument << '\n';
+			PrintUsage();
+			return 1;
+		}
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -38,12 +109,28 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(pWindow, assetOptions);
+
+	if (!sharedMemoryName.empty())
+		pRenderer->StartSharedMemoryOutput(sharedMemoryName, sharedMemorySlots);
+
+	//the interactive window can show placeholders while assets stream in, recorded output waits for them
+	if (!streamTarget.empty() || !offscreenPath.empty())
+		pRenderer->FinishLoading();
+
+	const bool isStreaming{ !streamTarget.empty() && pRenderer->StartVideoStream(streamTarget, streamFormat, streamFrames) };
 
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
 	bool isLooping = true;
+
+	if (!offscreenPath.empty()) {
+		//one update so the camera matrices exist, then render the image and quit
+		pRenderer->Update(pTimer);
+		pRenderer->RenderOffscreen(offscreenWidth, offscreenHeight, offscreenPath, offscreenBand);
+		isLooping = false;
+	}
 	bool canPrint{ true };
 	while (isLooping)
 	{
@@ -87,6 +174,15 @@ int main(int argc, char* args[])
 				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
 					pRenderer->ToggleClearColor();
 
+				if (e.key.keysym.scancode == SDL_SCANCODE_T)
+					pRenderer->ToggleTriangleStrips();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_X)
+					pRenderer->SaveBufferToImage();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_C)
+					pRenderer->ToggleCaptureSequence();
+
 				if (e.key.keysym.scancode == SDL_SCANCODE_F11) {
 					canPrint = !canPrint;
 					canPrint ? std::cout << "-----FPS print on-----\n" : std::cout << "-----FPS print off-----\n";
@@ -103,6 +199,9 @@ int main(int argc, char* args[])
 		//--------- Render ---------
 		pRenderer->Render();
 
+		if (isStreaming && pRenderer->IsVideoStreamFinished())
+			isLooping = false;
+
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
@@ -110,6 +209,9 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			pRenderer->PrintDepthBufferStats();
+			pRenderer->PrintVirtualTextureStats();
+			pRenderer->PrintStreamedMeshStats();
 		}
 	}
 	pTimer->Stop();